@@ -12,7 +12,11 @@ enum tls_tag {
 	CA_CERTIFICATE_TAG = 1,
 	CLIENT_CERTIFICATE_TAG,		//in tls_credential.h defined as TLS_CREDENTIAL_SERVER_CERTIFICATE
 	CLIENT_KEY_TAG,
-	PSK_TAG
+	PSK_TAG,
+	/* Registered at boot, see tmo_tls_creds.c */
+	ENTRUST_G2_CA_TAG,
+	DIGICERT_CA_TAG,
+	DEV_CERT_CA_TAG
 };
 
 #define TLS_PEER_HOSTNAME ""
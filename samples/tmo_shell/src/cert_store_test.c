@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fs.h>
+#include <zephyr/shell/shell.h>
+
+#include "tmo_cert_store.h"
+
+/* Scratch store next to the real one, on the mounted littlefs */
+#define TEST_STORE "/tmo/cstest"
+
+#define CHECK(cond, ...)                                                                           \
+	do {                                                                                       \
+		if (!(cond)) {                                                                     \
+			shell_error(shell, __VA_ARGS__);                                           \
+			rc = -1;                                                                   \
+		}                                                                                  \
+	} while (0)
+
+/* Dummy DERs that do not parse, "big" is past what the metadata parser takes */
+static const struct {
+	const char *cn;
+	uint16_t size;
+} certs[] = {
+	{ "alpha", 100 },
+	{ "bravo", 200 },
+	{ "charlie", 150 },
+	{ "big", 2100 },
+};
+
+#define BIG 3
+
+/* Clear of the DER the index rebuild reads into the front of the buffer */
+extern uint8_t mxfer_buf[];
+static uint8_t *der_buf = &mxfer_buf[2600];
+
+static void make_der(int cert, uint8_t *der)
+{
+	for (int i = 0; i < certs[cert].size; i++) {
+		der[i] = (i * 7 + cert) & 0xff;
+	}
+	/* Not a SEQUENCE, so never X.509 */
+	der[0] = 0;
+}
+
+/* Checks that the certs listed in order are entries 0.. with their DER and name */
+static int check_store(const struct shell *shell, struct tmo_cert_store *st, const char *step,
+		       const int *expect, int n)
+{
+	struct tmo_cert_entry ent;
+	struct tmo_cert_meta meta;
+	uint8_t der[256];
+	char cn[TMO_CERT_CN_LEN + 1];
+	int rc = 0;
+	int ret;
+
+	CHECK(st->hdr.live == n, "%s: %u live entries, expected %d", step, st->hdr.live, n);
+	for (int i = 0; i < n; i++) {
+		int c = expect[i];
+
+		ret = tmo_cert_store_find(st, certs[c].cn, &ent);
+		if (ret != i) {
+			shell_error(shell, "%s: %s found at %d, expected %d", step, certs[c].cn, ret,
+				    i);
+			rc = -1;
+			continue;
+		}
+		CHECK(ent.size == certs[c].size, "%s: %s is %u bytes", step, certs[c].cn,
+		      ent.size);
+		if (c != BIG) {
+			make_der(c, der_buf);
+			ret = tmo_cert_store_read(st, &ent, cn, der, sizeof(der));
+			CHECK(ret == 0 && !strcmp(cn, certs[c].cn) &&
+				      !memcmp(der, der_buf, certs[c].size),
+			      "%s: %s reads back wrong, %d", step, certs[c].cn, ret);
+		}
+		/* Unparsed entries are listed under their stored CN */
+		ret = tmo_cert_store_meta(st, i, &meta);
+		CHECK(ret == 0 && meta.version == 0 && meta.size == certs[c].size &&
+			      !strcmp(meta.subject, certs[c].cn),
+		      "%s: entry %d metadata '%s' %u bytes, expected %s", step, i, meta.subject,
+		      meta.size, certs[c].cn);
+	}
+	return rc;
+}
+
+int cert_store_test(const struct shell *shell, size_t argc, char **argv)
+{
+	static const int all[] = { 0, 1, 2, BIG };
+	static const int compacted[] = { 0, 2, BIG };
+	static struct tmo_cert_store st;
+	struct tmo_cert_entry ent;
+	struct fs_dirent dirent;
+	uint32_t bravo_off = 0, data_len;
+	int rc = 0;
+	int ret;
+
+	tmo_cert_store_remove(TEST_STORE);
+	ret = tmo_cert_store_open(&st, TEST_STORE, true);
+	if (ret) {
+		shell_error(shell, "cert store: cannot create %s, err = %d", TEST_STORE, ret);
+		return ret;
+	}
+	for (int i = 0; i < ARRAY_SIZE(certs); i++) {
+		make_der(i, der_buf);
+		ret = tmo_cert_store_add(&st, certs[i].cn, der_buf, certs[i].size);
+		CHECK(ret == i, "add: %s returned %d", certs[i].cn, ret);
+	}
+	make_der(0, der_buf);
+	ret = tmo_cert_store_add(&st, NULL, der_buf, certs[0].size);
+	CHECK(ret == -EINVAL, "add: unnamed unparsable DER returned %d", ret);
+	rc |= check_store(shell, &st, "add", all, ARRAY_SIZE(all));
+	tmo_cert_store_close(&st);
+
+	/* A missing index is rebuilt from the data file, metadata included */
+	fs_unlink(TEST_STORE ".idx");
+	ret = tmo_cert_store_open(&st, TEST_STORE, false);
+	CHECK(ret == 0, "rebuild: open returned %d", ret);
+	if (ret == 0) {
+		rc |= check_store(shell, &st, "rebuild", all, ARRAY_SIZE(all));
+		bravo_off = tmo_cert_store_find(&st, "bravo", &ent) == 1 ? ent.offset : 0;
+		ret = tmo_cert_store_delete(&st, 1);
+		CHECK(ret == 0, "delete: returned %d", ret);
+		ret = tmo_cert_store_get(&st, 1, &ent);
+		CHECK(ret == -ENOENT, "delete: get returned %d", ret);
+		tmo_cert_store_close(&st);
+	}
+
+	ret = tmo_cert_store_open(&st, TEST_STORE, false);
+	CHECK(ret == 0, "reopen: returned %d", ret);
+	if (ret == 0) {
+		ret = tmo_cert_store_find(&st, "bravo", &ent);
+		CHECK(ret == -ENOENT, "delete: deleted cert found at %d after reopen", ret);
+		CHECK(tmo_cert_store_count(&st) == ARRAY_SIZE(certs),
+		      "delete: %d entries, the tombstone must stay until compaction",
+		      tmo_cert_store_count(&st));
+
+		ret = tmo_cert_store_compact(&st);
+		CHECK(ret == 0, "compact: returned %d", ret);
+		CHECK(tmo_cert_store_count(&st) == ARRAY_SIZE(compacted), "compact: %d entries",
+		      tmo_cert_store_count(&st));
+		CHECK(fs_stat(TEST_STORE ".tmp", &dirent) == -ENOENT,
+		      "compact: temporary file left behind");
+		/* The metadata slid down with the data */
+		rc |= check_store(shell, &st, "compact", compacted, ARRAY_SIZE(compacted));
+		ret = tmo_cert_store_find(&st, "charlie", &ent);
+		CHECK(ret == 1 && ent.offset == bravo_off, "compact: charlie at %u, expected %u",
+		      ent.offset, bravo_off);
+		data_len = st.hdr.data_len;
+		tmo_cert_store_close(&st);
+
+		ret = tmo_cert_store_open(&st, TEST_STORE, false);
+		CHECK(ret == 0 && st.hdr.data_len == data_len,
+		      "compact: reopen returned %d, %u bytes, expected %u", ret, st.hdr.data_len,
+		      data_len);
+		if (ret == 0) {
+			rc |= check_store(shell, &st, "compact reopen", compacted,
+					  ARRAY_SIZE(compacted));
+			tmo_cert_store_close(&st);
+		}
+	}
+
+	tmo_cert_store_remove(TEST_STORE);
+	shell_print(shell, "cert store: %s", rc ? "FAILED" : "passed");
+	return rc;
+}
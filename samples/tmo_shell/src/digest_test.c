@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/util.h>
+
+#include "tmo_digest.h"
+
+#define CHECK(cond, ...)                                                                           \
+	do {                                                                                       \
+		if (!(cond)) {                                                                     \
+			shell_error(shell, __VA_ARGS__);                                           \
+			rc = -1;                                                                   \
+		}                                                                                  \
+	} while (0)
+
+#define ALL_DIGESTS (TMO_DIGEST_SHA1 | TMO_DIGEST_SHA256 | TMO_DIGEST_CRC32 | TMO_DIGEST_MCRC32)
+
+/* FIPS 180 examples plus the CRC catalogue check string, MCRC32 is POSIX cksum */
+static const struct {
+	const char *msg;
+	const char *sha1;
+	const char *sha256;
+	uint32_t crc32;
+	uint32_t mcrc32;
+} vectors[] = {
+	{ "123456789", "f7c3bc1d808e04732adf679965ccc34ca7ae3441",
+	  "15e2b0d3c33891ebb0f1ef609ec419420c20e320ce94c65fbc8c3312448eb225", 0xcbf43926,
+	  0x377a6011 },
+	{ "abc", "a9993e364706816aba3e25717850c26c9cd0d89d",
+	  "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", 0x352441c2,
+	  0x48aa78a2 },
+	{ "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+	  "84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+	  "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1", 0x171a3f5f,
+	  0x97d32c84 },
+};
+
+/* Odd sized pieces so updates straddle word boundaries */
+#define CHUNK 5
+
+static int test_crc32(const struct shell *shell)
+{
+	const char *msg = vectors[2].msg;
+	size_t len = strlen(msg);
+	/* Leading slack to start the data at every alignment */
+	uint8_t aligned[3 + 64] __aligned(4);
+	uint32_t crc;
+	int rc = 0;
+
+	crc = tmo_digest_crc32(0, (const uint8_t *)"123456789", 9);
+	CHECK(crc == 0xcbf43926, "crc32: check value %08x, expected cbf43926", crc);
+
+	for (int off = 0; off < 4; off++) {
+		memcpy(aligned + off, msg, len);
+		for (int split = 0; split <= len; split++) {
+			crc = tmo_digest_crc32(0, aligned + off, split);
+			crc = tmo_digest_crc32(crc, aligned + off + split, len - split);
+			CHECK(crc == vectors[2].crc32, "crc32: offset %d split %d gave %08x", off,
+			      split, crc);
+		}
+	}
+	return rc;
+}
+
+static int test_vectors(const struct shell *shell)
+{
+	static struct tmo_digest d;
+	char hex[TMO_DIGEST_SHA256_LEN * 2 + 1];
+	int rc = 0;
+	int ret;
+
+	for (int i = 0; i < ARRAY_SIZE(vectors); i++) {
+		const char *msg = vectors[i].msg;
+		size_t len = strlen(msg);
+
+		d.mcrc_skip = 0;
+		ret = tmo_digest_start(&d, ALL_DIGESTS);
+		for (size_t n = 0; ret == 0 && n < len; n += CHUNK) {
+			ret = tmo_digest_update(&d, (const uint8_t *)msg + n, MIN(CHUNK, len - n));
+		}
+		if (ret == 0) {
+			ret = tmo_digest_finish(&d);
+		}
+		if (ret) {
+			shell_error(shell, "vector %d: %s backend returned %d", i,
+				    tmo_digest_backend_name(), ret);
+			rc = -1;
+			continue;
+		}
+		bin2hex(d.sha1, sizeof(d.sha1), hex, sizeof(hex));
+		CHECK(!strcmp(hex, vectors[i].sha1), "vector %d: sha1 %s", i, hex);
+		bin2hex(d.sha256, sizeof(d.sha256), hex, sizeof(hex));
+		CHECK(!strcmp(hex, vectors[i].sha256), "vector %d: sha256 %s", i, hex);
+		CHECK(d.crc32 == vectors[i].crc32, "vector %d: crc32 %08x", i, d.crc32);
+		CHECK(d.mcrc32 == vectors[i].mcrc32, "vector %d: mcrc32 %08x", i, d.mcrc32);
+		CHECK(d.len == len, "vector %d: length %u", i, d.len);
+	}
+	return rc;
+}
+
+static int test_mcrc_skip(const struct shell *shell)
+{
+	static struct tmo_digest d;
+	static const uint8_t msg[] = "HEADER123456789";
+	int rc = 0;
+
+	/* The skipped header ends in the middle of the first update */
+	d.mcrc_skip = 6;
+	tmo_digest_start(&d, TMO_DIGEST_CRC32 | TMO_DIGEST_MCRC32);
+	tmo_digest_update(&d, msg, 4);
+	tmo_digest_update(&d, msg + 4, sizeof(msg) - 1 - 4);
+	tmo_digest_finish(&d);
+	CHECK(d.mcrc32 == vectors[0].mcrc32, "mcrc skip: %08x, expected %08x", d.mcrc32,
+	      vectors[0].mcrc32);
+	CHECK(d.crc32 == tmo_digest_crc32(0, msg, sizeof(msg) - 1),
+	      "mcrc skip: crc32 must cover the header");
+	return rc;
+}
+
+int digest_test(const struct shell *shell, size_t argc, char **argv)
+{
+	static const struct {
+		const char *name;
+		int (*fn)(const struct shell *shell);
+	} tests[] = {
+		{ "crc32", test_crc32 },
+		{ "vectors", test_vectors },
+		{ "mcrc skip", test_mcrc_skip },
+	};
+	int rc = 0;
+
+	shell_print(shell, "digest backend: %s", tmo_digest_backend_name());
+	for (int i = 0; i < ARRAY_SIZE(tests); i++) {
+		int ret = tests[i].fn(shell);
+
+		shell_print(shell, "digest %s: %s", tests[i].name, ret ? "FAILED" : "passed");
+		rc |= ret;
+	}
+	return rc;
+}
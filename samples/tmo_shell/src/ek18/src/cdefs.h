@@ -32,15 +32,16 @@ typedef unsigned short USHORT;
 
 /* Unix platform.h for EK */
 
+/* File buffers hold one packet's worth of data, see zephyrio.c */
 #ifndef IBUFLEN
-#define IBUFLEN  2048			/* File input buffer size */
+#define IBUFLEN  CONFIG_TMO_SHELL_EK_PKTLEN	/* File input buffer size */
 #endif /* IBUFLEN */
 
 #ifndef OBUFLEN
-#define OBUFLEN  2048                   /* File output buffer size */
+#define OBUFLEN  CONFIG_TMO_SHELL_EK_PKTLEN	/* File output buffer size */
 #endif /* OBUFLEN */
 
-#define P_PKTLEN 2000
-#define P_WSLOTS 4
+#define P_PKTLEN CONFIG_TMO_SHELL_EK_PKTLEN
+#define P_WSLOTS CONFIG_TMO_SHELL_EK_WSLOTS
 
 #endif /* __CDEFS_H__ */
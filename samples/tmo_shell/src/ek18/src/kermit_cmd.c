@@ -80,6 +80,7 @@
 #include <zephyr/fs/fs.h>
 #include <stdlib.h>
 #include "kermit_cmd.h"
+#include "zephyrio.h"
 
 const struct shell* log_shell;
 
@@ -312,6 +313,26 @@ int doarg(char c) {				/* Command-line option parser */
 
 int ekermit_main(int argc, char ** argv);
 
+/* Throughput and error counts of the transfer that just finished */
+static void print_summary(const struct shell *shell)
+{
+    struct zek_stats st;
+    uint32_t ms;
+
+    zek_stats_get(&st);
+    if (!st.start_ms || !(st.rx_pkts || st.tx_pkts))
+        return;
+    ms = MAX(st.end_ms - st.start_ms, 1);
+    shell_print(shell, "%u file bytes in %u ms, %u B/s (link %u B in, %u B out)",
+            st.file_bytes, ms, (uint32_t)((uint64_t)st.file_bytes * 1000 / ms),
+            st.link_rx, st.link_tx);
+    shell_print(shell, "%u packets in (largest %u), %u out, %u retransmitted, "
+            "%u NAKs sent, %u NAKs received", st.rx_pkts, st.max_pkt, st.tx_pkts,
+            st.retransmits, st.naks_sent, st.naks_rcvd);
+    shell_print(shell, "Packet length %d in, %d out, window %d of %d",
+            k.r_maxlen, k.s_maxlen, k.window, P_WSLOTS);
+}
+
 #define MY_STACK_SIZE 2048
 #define MY_PRIORITY 5
 
@@ -319,7 +340,9 @@ int ekermit_main(int argc, char ** argv);
 void ekermit_entry(void *shell, void *argc, void *argv)
 {
     shell_print(shell, "ekermit started");
+    zek_stats_reset();
     int stat = ekermit_main(*(int*)argc, argv);
+    print_summary(shell);
     shell_print(shell, "ekermit exited with status %d", stat);
 }
 
@@ -382,9 +405,11 @@ int cmd_ekermit(const struct shell* shell, int argc, char ** argv)
 {
     log_shell = shell;
     zek_ctrl_c_sent = false;
+    zek_stats_reset();
     k_timer_start(&ctrl_c_chk_timer, K_MSEC(500), K_MSEC(500));
     ekermit_main(argc, argv);
     k_timer_stop(&ctrl_c_chk_timer);
+    print_summary(shell);
     return 0;
 }
 #endif
@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <string.h>
 #include "cdefs.h"
 #include "debug.h"
 #include "kermit.h"
@@ -15,14 +16,49 @@
 #include <SEGGER_RTT.h>
 #include <zephyr/fs/fs.h>
 #include <zephyr/device.h>
+#include "zephyrio.h"
 
 #define EOF -1
 
-// UCHAR o_buf[OBUFLEN+8];			/* File output buffer */
-// UCHAR i_buf[IBUFLEN+8];			/* File output buffer */
-extern uint8_t mxfer_buf[];
-UCHAR *i_buf = (UCHAR*)mxfer_buf;
-UCHAR *o_buf = (UCHAR*)&mxfer_buf[2048];
+/* Header and check of a long packet, over the P_PKTLEN of data */
+#define ZEK_PKT_OVERHEAD  16
+/* Incoming plus outgoing window buffers, see struct k_data */
+#define ZEK_WINDOW_RAM    (2 * (P_PKTLEN+8) * P_WSLOTS)
+#define ZEK_WINDOW_RAM_MAX (64 * 1024)
+
+BUILD_ASSERT(ZEK_WINDOW_RAM <= ZEK_WINDOW_RAM_MAX,
+             "Kermit packet length times window slots takes too much RAM");
+BUILD_ASSERT(CONFIG_SEGGER_RTT_BUFFER_SIZE_UP >= P_PKTLEN + ZEK_PKT_OVERHEAD,
+             "RTT up buffer cannot hold a whole Kermit packet");
+
+/*
+ * File buffers are sized with the packets (CONFIG_TMO_SHELL_EK_PKTLEN) and
+ * no longer borrow mxfer_buf, which is only 5000 bytes.
+ */
+static UCHAR o_buf_mem[OBUFLEN+8];		/* File output buffer */
+static UCHAR i_buf_mem[IBUFLEN+8];		/* File input buffer */
+UCHAR *i_buf = i_buf_mem;
+UCHAR *o_buf = o_buf_mem;
+
+/*
+ * RTT has no receive interrupt, so waiting for input sleeps a tick between
+ * polls instead of spinning on k_yield(), which starved every lower
+ * priority thread for the length of a transfer. Single bytes are served
+ * from a staging buffer filled by one bulk read.
+ */
+#define ZEK_RX_STAGE      256
+#define ZEK_TX_TIMEOUT_MS 2000
+
+static UCHAR rx_stage[ZEK_RX_STAGE];
+static size_t rx_pos, rx_cnt;
+
+static struct zek_stats stats;
+/*
+ * Type of the last packet sent with each sequence number, 0 once the number
+ * has left the window. A window is at most 31 of the 64 numbers, so sending
+ * seq n retires n + 32 before it can come round again.
+ */
+static UCHAR sent_type[64];
 
 bool zek_ctrl_c_sent;
 
@@ -47,17 +83,20 @@ int devopen(char * dev)		/* Communications device/path */
 int devsettings(char *a)
 {
     ARG_UNUSED(a);
+    rx_pos = rx_cnt = 0;
 #if CONFIG_SHELL_BACKEND_RTT
     if (sh) {
         shell_uninit(sh, NULL);
         k_msleep(100);
     } 
 #endif
+    stats.start_ms = k_uptime_get();
     return 1;
 }
 
 int devrestore(void)
 {
+    stats.end_ms = k_uptime_get();
 #if CONFIG_SHELL_BACKEND_RTT
     if (shell_backend_rtt_get_ptr() == sh) {
         bool log_backend = CONFIG_SHELL_RTT_INIT_LOG_LEVEL > 0;
@@ -78,30 +117,79 @@ int devclose(void)
     return 0;
 }
 
+void zek_stats_reset(void)
+{
+    memset(&stats, 0, sizeof(stats));
+    memset(sent_type, 0, sizeof(sent_type));
+}
+
+void zek_stats_get(struct zek_stats *st)
+{
+    *st = stats;
+    if (!st->end_ms) {
+        st->end_ms = k_uptime_get();
+    }
+}
+
+/* Block until RTT has input, false if the user hit ^C */
+static bool z_wait(void)
+{
+    while (!SEGGER_RTT_HasKey()) {
+        if (zek_ctrl_c_sent)
+            return false;
+        k_sleep(K_TICKS(1));
+    }
+    return !zek_ctrl_c_sent;
+}
+
 UCHAR z_getchar()
 {
-    char c;
-    while (!SEGGER_RTT_HasKey() && !zek_ctrl_c_sent)
-        k_yield();
-    SEGGER_RTT_Read(0, &c, 1);
-    return c;
+    if (rx_pos == rx_cnt) {
+        rx_pos = rx_cnt = 0;
+        if (!z_wait())
+            return 0;
+        rx_cnt = SEGGER_RTT_Read(0, rx_stage, sizeof(rx_stage));
+        stats.link_rx += rx_cnt;
+        if (!rx_cnt)
+            return 0;
+    }
+    return rx_stage[rx_pos++];
 }
 
 size_t z_read(void *buf, size_t n)
 {
-    while (!SEGGER_RTT_HasKey() && !zek_ctrl_c_sent) k_yield();
-    return SEGGER_RTT_Read(0, buf, n);
+    size_t cnt;
+
+    if (rx_pos < rx_cnt) {              /* Staged bytes first */
+        cnt = MIN(n, rx_cnt - rx_pos);
+        memcpy(buf, &rx_stage[rx_pos], cnt);
+        rx_pos += cnt;
+        return cnt;
+    }
+    if (!z_wait())
+        return 0;
+    cnt = SEGGER_RTT_Read(0, buf, n);   /* Packet body straight from RTT */
+    stats.link_rx += cnt;
+    return cnt;
 }
 
+/* Writes what fits in the up buffer, 0 if it is full */
 ssize_t z_write(void *buf, size_t cnt)
 {
-    return SEGGER_RTT_Write(0, buf, cnt);
+    unsigned int avail = SEGGER_RTT_GetAvailWriteSpace(0);
+    unsigned int x;
+
+    if (!avail)
+        return 0;
+    x = SEGGER_RTT_Write(0, buf, MIN(cnt, avail));
+    stats.link_tx += x;
+    return x;
 }
 
 /* I N C H K  --  Check if input waiting */
 int inchk(struct k_data * k)
 { 
-    return SEGGER_RTT_HasKey();
+    return rx_pos < rx_cnt || SEGGER_RTT_HasKey();
 }
 
 /*  R E A D P K T  --  Read a Kermit packet from the communications device  */
@@ -142,6 +230,7 @@ int readpkt(struct k_data * k, UCHAR *p, int len)
     if (!p) {		/* No buffer */
         return(-1);
     }
+    UCHAR *start = p;
     flag = n = s = plen= 0;                       /* Init local variables */
     lp = false;
     while (1) {
@@ -208,6 +297,10 @@ int readpkt(struct k_data * k, UCHAR *p, int len)
         } else if (c == k->r_eom	/* Packet terminator */
 		   || c == '\012'	/* 1.3: For HyperTerminal */
 		   ) {
+            stats.rx_pkts++;
+            stats.max_pkt = MAX(stats.max_pkt, n);
+            if (n > 2 && start[2] == 'N')   /* LEN SEQ TYPE ... */
+                stats.naks_rcvd++;
             return(n);
         } else {                        /* Contents of packet */
             if (n++ > k->r_maxlen)	/* Check length */
@@ -233,14 +326,33 @@ int tx_data(struct k_data * k, UCHAR *p, int n)
 {
     //SEGGER_RTT_WriteString(0,"TX\n");
     int x;
-    int max;
-
-    max = 10;                           /* Loop breaker */
+    int64_t deadline;
+
+    if (n > 3) {                        /* SOH LEN SEQ TYPE ... */
+        int seq = xunchar(p[2]) & 63;
+
+        stats.tx_pkts++;
+        if (p[3] == 'N')
+            stats.naks_sent++;
+        else if (sent_type[seq] == p[3])
+            stats.retransmits++;
+        sent_type[seq] = p[3];
+        sent_type[(seq + 32) & 63] = 0;
+    }
+    /* Loop breaker: the host stopped draining the up buffer */
+    deadline = k_uptime_get() + ZEK_TX_TIMEOUT_MS;
 
     while (n > 0) {                     /* Keep trying till done */
         x = z_write(p,n);
-        if (x < 0 || --max < 1)         /* Errors are fatal */
+        if (x < 0)                      /* Errors are fatal */
             return(X_ERROR);
+        if (x == 0) {
+            if (zek_ctrl_c_sent || k_uptime_get() > deadline)
+                return(X_ERROR);
+            k_sleep(K_TICKS(1));
+            continue;
+        }
+        deadline = k_uptime_get() + ZEK_TX_TIMEOUT_MS;
         n -= x;
 	    p += x;
     }
@@ -409,6 +521,8 @@ int readfile(struct k_data * k)
                 k->zinbuf[k->zincnt] = c;
             }
         }
+        if (k->zincnt > 0)
+            stats.file_bytes += k->zincnt;
         k->zinbuf[k->zincnt] = '\0';	/* Terminate. */
         if (k->zincnt == 0)		/* Check for EOF */
             return -1;
@@ -439,6 +553,8 @@ int writefile(struct k_data * k, UCHAR * s, int n)
     if (k->binary) {			/* Binary mode, just write it */
         if (fs_write(&ofile, s, n) != n)
             rc = X_ERROR;
+        else
+            stats.file_bytes += n;
     } else {				/* Text mode, skip CRs */
         UCHAR * p, * q;
         int i;
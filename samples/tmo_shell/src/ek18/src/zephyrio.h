@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __ZEPHYRIO_H__
+#define __ZEPHYRIO_H__
+
+#include <stdint.h>
+
+/* Link and file counters of the last transfer, kept by zephyrio.c */
+struct zek_stats {
+    uint32_t file_bytes;        /* File data read or written */
+    uint32_t link_rx;           /* Bytes read from RTT */
+    uint32_t link_tx;           /* Bytes written to RTT */
+    uint32_t rx_pkts;
+    uint32_t tx_pkts;
+    uint32_t retransmits;       /* Packets sent again while their seq is in the window */
+    uint32_t naks_sent;
+    uint32_t naks_rcvd;
+    uint32_t max_pkt;           /* Largest packet received */
+    int64_t start_ms;
+    int64_t end_ms;
+};
+
+void zek_stats_reset(void);
+void zek_stats_get(struct zek_stats *st);
+
+#endif /* __ZEPHYRIO_H__ */
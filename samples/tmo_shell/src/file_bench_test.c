@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fs.h>
+#include <zephyr/shell/shell.h>
+
+#include "tmo_file.h"
+
+#define TEST_DIR "/tmo/bench_test"
+
+#define CHECK(cond, ...)                                                                           \
+	do {                                                                                       \
+		if (!(cond)) {                                                                     \
+			shell_error(shell, __VA_ARGS__);                                           \
+			rc = -1;                                                                   \
+		}                                                                                  \
+	} while (0)
+
+static int dir_entries(const char *dir)
+{
+	struct fs_dir_t zdp;
+	struct fs_dirent entry;
+	int n = 0;
+
+	fs_dir_t_init(&zdp);
+	if (fs_opendir(&zdp, dir)) {
+		return -ENOENT;
+	}
+	while (fs_readdir(&zdp, &entry) == 0 && entry.name[0] != 0) {
+		n++;
+	}
+	fs_closedir(&zdp);
+	return n;
+}
+
+/*
+ * Runs every bench workload on a small file, then checks that it leaves
+ * nothing behind and only removes a directory it created itself.
+ */
+int file_bench_test(const struct shell *shell, size_t argc, char **argv)
+{
+	char *bench_argv[] = { "bench", TEST_DIR, "4" };
+	struct fs_dirent entry;
+	int rc = 0;
+	int ret;
+
+	fs_unlink(TEST_DIR);
+	ret = tmo_file_bench(shell, ARRAY_SIZE(bench_argv), bench_argv);
+	CHECK(ret == 0, "new dir: bench returned %d", ret);
+	CHECK(fs_stat(TEST_DIR, &entry) == -ENOENT, "new dir: %s was not removed", TEST_DIR);
+
+	ret = fs_mkdir(TEST_DIR);
+	CHECK(ret == 0, "existing dir: cannot create %s, err = %d", TEST_DIR, ret);
+	if (ret == 0) {
+		ret = tmo_file_bench(shell, ARRAY_SIZE(bench_argv), bench_argv);
+		CHECK(ret == 0, "existing dir: bench returned %d", ret);
+		ret = dir_entries(TEST_DIR);
+		CHECK(ret >= 0, "existing dir: %s was removed", TEST_DIR);
+		CHECK(ret <= 0, "existing dir: %d entries left behind", ret);
+		fs_unlink(TEST_DIR);
+	}
+
+	shell_print(shell, "file bench: %s", rc ? "FAILED" : "passed");
+	return rc;
+}
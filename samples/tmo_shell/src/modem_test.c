@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/drivers/modem/murata-1sc.h>
+
+#include "tmo_modem.h"
+
+#define MOCK_DELAY_MS 50
+
+#define CHECK(cond, ...)                                                                           \
+	do {                                                                                       \
+		if (!(cond)) {                                                                     \
+			shell_error(shell, __VA_ARGS__);                                           \
+			rc = -1;                                                                   \
+		}                                                                                  \
+	} while (0)
+
+/* fcntl_ptr() only passes pointers it can represent as an int, keep this off the stack */
+static int ptw;
+
+static int test_sync(const struct shell *shell)
+{
+	int rc = 0;
+	char imei[32];
+	char empty[8];
+	int ssi;
+	struct tmo_modem_query q[] = {
+		{ .cmd = "IMEI", .res = imei, .res_len = sizeof(imei) },
+		{ .cmd = "SSI", .num = &ssi },
+		{ .cmd = "EMPTY", .res = empty, .res_len = sizeof(empty) },
+	};
+	int ret;
+
+	tmo_modem_mock_reset(0);
+	ret = tmo_modem_query_batch(q, ARRAY_SIZE(q));
+	CHECK(ret == 2, "batch: %d of 3 succeeded, expected 2", ret);
+	CHECK(q[0].rc == 0 && !strcmp(imei, TMO_MODEM_MOCK_IMEI), "batch: IMEI rc %d '%s'",
+	      q[0].rc, imei);
+	CHECK(q[1].rc == 0 && ssi == atoi(TMO_MODEM_MOCK_SSI), "batch: SSI rc %d %d", q[1].rc,
+	      ssi);
+	CHECK(q[2].rc == -EAGAIN, "batch: empty response rc %d, expected -EAGAIN", q[2].rc);
+
+	return rc;
+}
+
+static int test_order(const struct shell *shell)
+{
+	static const char *const expect[] = { "HOLD", "HIGH", "NORMAL", "LOW" };
+	struct tmo_modem_query q[ARRAY_SIZE(expect)];
+	struct tmo_modem_req req[ARRAY_SIZE(expect)];
+	struct k_poll_signal sig[ARRAY_SIZE(expect)];
+	struct k_poll_event evt[ARRAY_SIZE(expect)];
+	static const enum tmo_modem_prio prio[] = {
+		TMO_MODEM_PRIO_LOW, TMO_MODEM_PRIO_LOW, TMO_MODEM_PRIO_NORMAL, TMO_MODEM_PRIO_HIGH
+	};
+	static const char *const cmd[] = { "HOLD", "LOW", "NORMAL", "HIGH" };
+	char got[TMO_MODEM_STATS_CMD_LEN];
+	int rc = 0;
+
+	tmo_modem_mock_reset(0);
+	memset(q, 0, sizeof(q));
+	memset(req, 0, sizeof(req));
+	for (int i = 0; i < ARRAY_SIZE(req); i++) {
+		q[i].cmd = cmd[i];
+		k_poll_signal_init(&sig[i]);
+		k_poll_event_init(&evt[i], K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &sig[i]);
+		req[i].q = &q[i];
+		req[i].cnt = 1;
+		req[i].prio = prio[i];
+		req[i].signal = &sig[i];
+	}
+
+	/* Park the worker on the first request, then queue the rest lowest priority first */
+	tmo_modem_submit(&req[0]);
+	if (tmo_modem_mock_wait_held(K_SECONDS(5))) {
+		shell_error(shell, "order: worker never picked up the request");
+		return -1;
+	}
+	for (int i = 1; i < ARRAY_SIZE(req); i++) {
+		tmo_modem_submit(&req[i]);
+	}
+	tmo_modem_mock_release();
+
+	for (int i = 0; i < ARRAY_SIZE(evt); i++) {
+		if (k_poll(&evt[i], 1, K_SECONDS(5))) {
+			shell_error(shell, "order: %s did not complete", cmd[i]);
+			return -1;
+		}
+		CHECK(req[i].rc == 1, "order: %s rc %d", cmd[i], req[i].rc);
+	}
+	/* Skip anything the status cache slipped in, only the relative order matters */
+	for (int i = 0, n = 0; n < ARRAY_SIZE(expect); i++) {
+		if (tmo_modem_mock_log(got, i)) {
+			shell_error(shell, "order: only %d of %d requests logged", n,
+				    (int)ARRAY_SIZE(expect));
+			return -1;
+		}
+		if (strcmp(got, "HOLD") && strcmp(got, "HIGH") && strcmp(got, "NORMAL") &&
+		    strcmp(got, "LOW")) {
+			continue;
+		}
+		CHECK(!strcmp(got, expect[n]), "order: request %d was '%s', expected '%s'", n, got,
+		      expect[n]);
+		n++;
+	}
+
+	return rc;
+}
+
+static int test_latency(const struct shell *shell)
+{
+	static struct tmo_modem_query bg_q[4];
+	static struct tmo_modem_req bg[ARRAY_SIZE(bg_q)];
+	int ssi;
+	struct tmo_modem_query q = { .cmd = "SSI", .num = &ssi };
+	struct k_poll_signal sig;
+	struct k_poll_event evt;
+	uint32_t ms;
+	int64_t start;
+	int rc = 0;
+
+	tmo_modem_mock_reset(MOCK_DELAY_MS);
+	k_poll_signal_init(&sig);
+	k_poll_event_init(&evt, K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &sig);
+	memset(bg_q, 0, sizeof(bg_q));
+	memset(bg, 0, sizeof(bg));
+	for (int i = 0; i < ARRAY_SIZE(bg); i++) {
+		bg_q[i].cmd = "SSI";
+		bg[i].q = &bg_q[i];
+		bg[i].cnt = 1;
+		bg[i].prio = TMO_MODEM_PRIO_LOW;
+	}
+	bg[ARRAY_SIZE(bg) - 1].signal = &sig;
+	for (int i = 0; i < ARRAY_SIZE(bg); i++) {
+		tmo_modem_submit(&bg[i]);
+	}
+
+	/* At most the request already on the "UART" runs ahead of an interactive one */
+	start = k_uptime_get();
+	tmo_modem_query_prio(&q, 1, TMO_MODEM_PRIO_HIGH);
+	ms = k_uptime_get() - start;
+	CHECK(q.rc == 0, "latency: rc %d", q.rc);
+	CHECK(ms < 3 * MOCK_DELAY_MS, "latency: high priority took %u ms behind %d low, limit %d",
+	      ms, (int)ARRAY_SIZE(bg), 3 * MOCK_DELAY_MS);
+
+	if (k_poll(&evt, 1, K_SECONDS(5))) {
+		shell_error(shell, "latency: background requests did not complete");
+		return -1;
+	}
+	tmo_modem_mock_reset(0);
+
+	return rc;
+}
+
+static int test_ioctl(const struct shell *shell)
+{
+	struct tmo_modem_cmd_stats stats[CONFIG_TMO_MODEM_STATS_CMDS];
+	bool found = false;
+	int rc = 0;
+	int ret;
+	int n;
+
+	tmo_modem_mock_reset(0);
+	tmo_modem_reset_stats();
+	ptw = 7;
+	ret = tmo_modem_ioctl("PTW_SET", AT_MODEM_EDRX_PTW_SET, &ptw);
+	CHECK(ret == 0, "ioctl: set returned %d errno %d", ret, errno);
+	ptw = 0;
+	ret = tmo_modem_ioctl("PTW_GET", AT_MODEM_EDRX_PTW_GET, &ptw);
+	CHECK(ret == 0 && ptw == 7, "ioctl: get returned %d, ptw %d", ret, ptw);
+
+	/* The worker's errno must come back to the caller */
+	errno = 0;
+	ret = tmo_modem_ioctl("PSM_GET", AT_MODEM_PSM_GET, &ptw);
+	CHECK(ret == -1 && errno == ENOTSUP, "ioctl: unsupported returned %d errno %d", ret,
+	      errno);
+
+	n = tmo_modem_get_stats(stats, ARRAY_SIZE(stats));
+	for (int i = 0; i < n; i++) {
+		if (!strcmp(stats[i].cmd, "PTW_SET") && stats[i].lat.count == 1) {
+			found = true;
+		}
+	}
+	CHECK(found, "ioctl: no latency recorded for PTW_SET");
+
+	return rc;
+}
+
+int modem_test(const struct shell *shell, size_t argc, char **argv)
+{
+	static const struct {
+		const char *name;
+		int (*fn)(const struct shell *shell);
+	} tests[] = {
+		{ "sync", test_sync },
+		{ "order", test_order },
+		{ "latency", test_latency },
+		{ "ioctl", test_ioctl },
+	};
+	int rc = 0;
+
+	for (int i = 0; i < ARRAY_SIZE(tests); i++) {
+		int ret = tests[i].fn(shell);
+
+		shell_print(shell, "modem %s: %s", tests[i].name, ret ? "FAILED" : "passed");
+		rc |= ret;
+	}
+	return rc;
+}
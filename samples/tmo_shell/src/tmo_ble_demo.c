@@ -38,6 +38,8 @@
 #include "tmo_smp.h"
 #include "tmo_shell.h"
 #include "tmo_battery_ctrl.h"
+#include "tmo_sensor_cache.h"
+#include "tmo_modem.h"
 #include "board.h"
 
 #define ON_CHARGER_POWER 0
@@ -103,11 +105,19 @@ void las_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
 static bool acc_notify = false;
 
 /* Sensors */
-static const struct device *acc_sensor = NULL;
-static const struct device *temp_sensor = NULL;
-static const struct device *press_sensor = NULL;
-static const struct device *light_sensor = NULL;
-static const struct device *ir_sensor = NULL;
+/* Fill an int16 x/y/z array in .01 m/s^2 from the sensor cache */
+static int acc_cached(int16_t value[3])
+{
+	struct sensor_value accel[3];
+	int rc = tmo_sensor_cache_get(TMO_SENSOR_ACCEL, accel, NULL);
+
+	if (rc == 0) {
+		for (int i = 0; i < 3; i++) {
+			value[i] = (int16_t)(sensor_value_to_double(&accel[i]) * 100);
+		}
+	}
+	return rc;
+}
 
 static ssize_t temp_read(struct bt_conn *conn,
 		const struct bt_gatt_attr *attr, void *buf,
@@ -116,15 +126,12 @@ static ssize_t temp_read(struct bt_conn *conn,
 	uint16_t rand_temp = 2221 + (uint8_t)sys_rand32_get() - 127;
 	int16_t real_temp;
 	uint8_t *value = (uint8_t*)&rand_temp;
+	struct sensor_value temp;
 
-	if (temp_sensor) {
-		struct sensor_value temp;
-		if (sensor_sample_fetch(temp_sensor) >= 0) {
-			sensor_channel_get(temp_sensor, SENSOR_CHAN_AMBIENT_TEMP, &temp);
-			double tvalue = sensor_value_to_double(&temp) * 100;
-			real_temp = tvalue;
-			value = (uint8_t*)&real_temp;
-		}
+	if (tmo_sensor_cache_get(TMO_SENSOR_TEMP, &temp, NULL) == 0) {
+		double tvalue = sensor_value_to_double(&temp) * 100;
+		real_temp = tvalue;
+		value = (uint8_t*)&real_temp;
 	}
 
 	return bt_gatt_attr_read(conn, attr, buf, len, offset, value, 2);
@@ -137,15 +144,12 @@ static ssize_t press_read(struct bt_conn *conn,
 	uint32_t rand_press = (100000 + (uint8_t)sys_rand32_get() - 127) * 10;
 	uint32_t real_press;
 	uint8_t *value = (uint8_t*)&rand_press;
+	struct sensor_value press;
 
-	if (press_sensor) {
-		struct sensor_value press;
-		if (sensor_sample_fetch(press_sensor) >= 0) {
-			sensor_channel_get(press_sensor, SENSOR_CHAN_PRESS, &press);
-			double pvalue = sensor_value_to_double(&press) * 10000;
-			real_press = pvalue;
-			value = (uint8_t*)&real_press;
-		}
+	if (tmo_sensor_cache_get(TMO_SENSOR_PRESS, &press, NULL) == 0) {
+		double pvalue = sensor_value_to_double(&press) * 10000;
+		real_press = pvalue;
+		value = (uint8_t*)&real_press;
 	}
 
 	return bt_gatt_attr_read(conn, attr, buf, len, offset, value, 4);
@@ -157,14 +161,11 @@ static ssize_t ambient_light_read(struct bt_conn *conn,
 {
 	// Default value
 	uint32_t real_light = 0;
+	struct sensor_value light_value;
 
-	if (light_sensor) {
-		struct sensor_value light_value;
-		if (sensor_sample_fetch(light_sensor) >= 0) {
-			sensor_channel_get(light_sensor, SENSOR_CHAN_LIGHT, &light_value);
-			double pvalue = sensor_value_to_double(&light_value);
-			real_light = 100 * pvalue;
-		}
+	if (tmo_sensor_cache_get(TMO_SENSOR_LIGHT, &light_value, NULL) == 0) {
+		double pvalue = sensor_value_to_double(&light_value);
+		real_light = 100 * pvalue;
 	}
 	return bt_gatt_attr_read(conn, attr, buf, len, offset, (uint8_t*) &real_light, 4);
 }
@@ -175,14 +176,11 @@ static ssize_t ambient_ir_read(struct bt_conn *conn,
 {
 	// Default value
 	uint32_t real_ir = 0;
+	struct sensor_value ir_value;
 
-	if (ir_sensor) {
-		struct sensor_value ir_value;
-		if (sensor_sample_fetch(ir_sensor) >= 0) {
-			sensor_channel_get(ir_sensor, SENSOR_CHAN_IR, &ir_value);
-			double pvalue = sensor_value_to_double(&ir_value);
-			real_ir = 10 * pvalue;
-		}
+	if (tmo_sensor_cache_get(TMO_SENSOR_IR, &ir_value, NULL) == 0) {
+		double pvalue = sensor_value_to_double(&ir_value);
+		real_ir = 10 * pvalue;
 	}
 	return bt_gatt_attr_read(conn, attr, buf, len, offset, (uint8_t*) &real_ir, 4);
 }
@@ -258,26 +256,7 @@ static ssize_t acc_ori_rd_cb(struct bt_conn *conn,
 {
 	int16_t value[3] = {0};
 
-	if (acc_sensor != NULL) {
-		struct sensor_value accel[3];
-		int rc = sensor_sample_fetch(acc_sensor);
-
-		if (rc == 0) {
-			rc = sensor_channel_get(acc_sensor,
-					SENSOR_CHAN_ACCEL_XYZ,
-					accel);
-		}
-		if (rc < 0) {
-			printf("ERROR: Update failed: %d\n", rc);
-		} else {
-			double xacc = sensor_value_to_double(&accel[0]);
-			double yacc = sensor_value_to_double(&accel[1]);
-			double zacc = sensor_value_to_double(&accel[2]);
-			value[0] = (int16_t)(xacc * 100);
-			value[1] = (int16_t)(yacc * 100);
-			value[2] = (int16_t)(zacc * 100);
-		}
-	}
+	acc_cached(value);
 
 	return bt_gatt_attr_read(conn, attr, buf, len, offset, value, 6);
 }
@@ -577,16 +556,9 @@ void button_stat_change(const struct device *dev, struct gpio_callback *cb,
 
 static uint64_t get_imei()
 {
-	struct net_if *iface = net_if_get_by_index(1);
-	int sd = zsock_socket_ext(AF_INET, SOCK_STREAM, IPPROTO_TCP, iface);
-	if (sd == -1) {
-		return 0;
-	}
-	uint8_t buf[16] = {0};
-	strcpy(buf, "IMEI");
-	strupper(buf);
-	int res = fcntl(sd, GET_ATCMD_RESP, buf);
-	zsock_close(sd);
+	char buf[32] = {0};
+	int res = tmo_modem_get_imei(buf, sizeof(buf));
+
 	if (res >= 0) {
 		uint8_t partial[8] = {0};
 		memcpy(partial, buf, 7);
@@ -616,7 +588,10 @@ static ssize_t cell_rssi_rd_cb(struct bt_conn *conn,
 	int rssi_value;
 	int8_t rssi_byte_value;
 	uint8_t *value = attr->user_data;
-	get_cell_strength(&rssi_value);
+	if (get_cell_strength(&rssi_value)) {
+		/* No current reading */
+		rssi_value = INT8_MIN;
+	}
 	rssi_byte_value = (int8_t) rssi_value;
 	value = (uint8_t *) &rssi_byte_value;
 	return bt_gatt_attr_read(conn, attr, buf, len, offset, value, 1);
@@ -807,26 +782,7 @@ void ble_notif_thread(void *a, void *b, void *c)
 		if (acc_notify) {
 			int16_t acc_value[3] = {0};
 
-			if (acc_sensor != NULL) {
-				struct sensor_value accel[3];
-				int rc = sensor_sample_fetch(acc_sensor);
-
-				if (rc == 0) {
-					rc = sensor_channel_get(acc_sensor,
-							SENSOR_CHAN_ACCEL_XYZ,
-							accel);
-				}
-				if (rc < 0) {
-					printf("ERROR: Update failed: %d\n", rc);
-				} else {
-					double xacc = sensor_value_to_double(&accel[0]);
-					double yacc = sensor_value_to_double(&accel[1]);
-					double zacc = sensor_value_to_double(&accel[2]);
-					acc_value[0] = (int16_t)(xacc * 100);
-					acc_value[1] = (int16_t)(yacc * 100);
-					acc_value[2] = (int16_t)(zacc * 100);
-				}
-			}
+			acc_cached(acc_value);
 			bt_gatt_notify(NULL, &acc_ori_svc.attrs[1], &acc_value, 6);
 		}
 		if (get_active_le_conns() && aio_btn_notify && aio_btn_pushed != button_last_state){
@@ -915,25 +871,6 @@ static int tmo_ble_demo_init()
 	tmo_smp_shell_init();
 #endif
 	bt_conn_cb_register(&conn_callbacks);
-	acc_sensor = DEVICE_DT_GET(DT_NODELABEL(lis2dw12));
-	temp_sensor = DEVICE_DT_GET(DT_NODELABEL(as6212));
-#if CONFIG_LPS22HH
-	press_sensor = DEVICE_DT_GET(DT_NODELABEL(lps22hh));
-#else
-	press_sensor = NULL;
-#endif
-	ir_sensor = light_sensor = DEVICE_DT_GET(DT_NODELABEL(tsl2540));  // idx = 17, idx = 18
-
-	if (press_sensor) {
-		struct sensor_value attr = {
-			.val1 = 1,
-		};
-		if (sensor_attr_set(press_sensor, SENSOR_CHAN_ALL,
-					SENSOR_ATTR_SAMPLING_FREQUENCY, &attr) < 0) {
-			printf("Cannot configure sampling rate\n");
-		}
-	}
-
 #if 0 /* DaR TODO def CONFIG_WIFI */
 	net_mgmt_init_event_callback(&ble_demo_mgmt_cb,
 			ble_sample_wifi_mgmt_event_handler,
@@ -946,66 +883,36 @@ static int tmo_ble_demo_init()
 	return 0;
 }
 
+/*
+ * The helpers below are served from the sensor cache and never touch the bus.
+ * They keep their original contract: true (or 0) when the sensor is present.
+ */
 bool fetch_temperature(struct sensor_value *temp)
 {
-	if (temp_sensor && temp) {
-		if (sensor_sample_fetch(temp_sensor) >= 0) {
-			sensor_channel_get(temp_sensor, SENSOR_CHAN_AMBIENT_TEMP, temp);
-		}
-		return true;
-	}
-	return false;
+	return temp && tmo_sensor_cache_get(TMO_SENSOR_TEMP, temp, NULL) != -ENODEV;
 }
 
 /* acc_sensor is a pointer to a 3 element array of sensor_value struct  */
 int read_accelerometer(SENSOR_VALUE_STRUCT* acc_sensor_val_arr)
 {
-	int rc = 0;
-	if (acc_sensor != NULL) {
-		rc = sensor_sample_fetch(acc_sensor);
-
-		if (rc == 0) {
-			rc = sensor_channel_get(acc_sensor,
-					SENSOR_CHAN_ACCEL_XYZ,
-					acc_sensor_val_arr);
-		}
-	} else {
-		return -EINVAL;
-	}
-	return rc;
+	int rc = tmo_sensor_cache_get(TMO_SENSOR_ACCEL, acc_sensor_val_arr, NULL);
+
+	return rc == -ENODEV ? -EINVAL : rc;
 }
 
 bool fetch_light(struct sensor_value *light)
 {
-	if (light_sensor && light) {
-		if (sensor_sample_fetch(light_sensor) >= 0) {
-			sensor_channel_get(light_sensor, SENSOR_CHAN_LIGHT, light);
-		}
-		return true;
-	}
-	return false;
+	return light && tmo_sensor_cache_get(TMO_SENSOR_LIGHT, light, NULL) != -ENODEV;
 }
 
 bool fetch_ir(struct sensor_value *ir_value)
 {
-	if (ir_sensor && ir_value) {
-		if (sensor_sample_fetch(ir_sensor) >= 0) {
-			sensor_channel_get(ir_sensor, SENSOR_CHAN_IR, ir_value);
-		}
-		return true;
-	}
-	return false;
+	return ir_value && tmo_sensor_cache_get(TMO_SENSOR_IR, ir_value, NULL) != -ENODEV;
 }
 
 bool fetch_pressure(struct sensor_value *press)
 {
-	if (press_sensor && press) {
-		if (sensor_sample_fetch(press_sensor) >= 0) {
-			sensor_channel_get(press_sensor, SENSOR_CHAN_PRESS, press);
-		}
-		return true;
-	}
-	return false;
+	return press && tmo_sensor_cache_get(TMO_SENSOR_PRESS, press, NULL) != -ENODEV;
 }
 SYS_INIT(tmo_ble_demo_init, APPLICATION, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
 
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "tmo_cbor.h"
+
+#define CBOR_UINT   0
+#define CBOR_NINT   1
+#define CBOR_TEXT   3
+#define CBOR_ARRAY  4
+#define CBOR_MAP    5
+#define CBOR_TAG    6
+#define CBOR_SIMPLE 7
+
+#define CBOR_FALSE      20
+#define CBOR_TRUE       21
+#define CBOR_NULL       22
+#define CBOR_INDEF      31
+#define CBOR_TAG_DECFRAC 4
+
+void tmo_cbor_init(struct tmo_cbor *c, uint8_t *buf, size_t size)
+{
+	c->buf = buf;
+	c->size = size;
+	c->len = 0;
+	c->err = 0;
+}
+
+static void put(struct tmo_cbor *c, const void *data, size_t len)
+{
+	if (c->err) {
+		return;
+	}
+	if (!c->buf) {
+		/* Size-only pass */
+		c->len += len;
+		return;
+	}
+	if (c->len + len > c->size) {
+		c->err = -ENOMEM;
+		return;
+	}
+	memcpy(c->buf + c->len, data, len);
+	c->len += len;
+}
+
+static void put_head(struct tmo_cbor *c, uint8_t major, uint64_t val)
+{
+	uint8_t head[9];
+	int n;
+
+	if (val < 24) {
+		head[0] = (major << 5) | val;
+		n = 1;
+	} else if (val <= UINT8_MAX) {
+		head[0] = (major << 5) | 24;
+		n = 2;
+	} else if (val <= UINT16_MAX) {
+		head[0] = (major << 5) | 25;
+		n = 3;
+	} else if (val <= UINT32_MAX) {
+		head[0] = (major << 5) | 26;
+		n = 5;
+	} else {
+		head[0] = (major << 5) | 27;
+		n = 9;
+	}
+	/* Argument is big-endian after the initial byte */
+	for (int i = n - 1; i > 0; i--) {
+		head[i] = val & 0xff;
+		val >>= 8;
+	}
+	put(c, head, n);
+}
+
+void tmo_cbor_map(struct tmo_cbor *c, int pairs)
+{
+	if (pairs < 0) {
+		uint8_t b = (CBOR_MAP << 5) | CBOR_INDEF;
+
+		put(c, &b, 1);
+	} else {
+		put_head(c, CBOR_MAP, pairs);
+	}
+}
+
+void tmo_cbor_array(struct tmo_cbor *c, int items)
+{
+	if (items < 0) {
+		uint8_t b = (CBOR_ARRAY << 5) | CBOR_INDEF;
+
+		put(c, &b, 1);
+	} else {
+		put_head(c, CBOR_ARRAY, items);
+	}
+}
+
+void tmo_cbor_end(struct tmo_cbor *c)
+{
+	uint8_t b = 0xff;
+
+	put(c, &b, 1);
+}
+
+void tmo_cbor_uint(struct tmo_cbor *c, uint64_t val)
+{
+	put_head(c, CBOR_UINT, val);
+}
+
+void tmo_cbor_int(struct tmo_cbor *c, int64_t val)
+{
+	if (val < 0) {
+		/* Major type 1 stores -1 - n */
+		put_head(c, CBOR_NINT, (uint64_t)(-1 - val));
+	} else {
+		put_head(c, CBOR_UINT, val);
+	}
+}
+
+void tmo_cbor_text(struct tmo_cbor *c, const char *str)
+{
+	size_t len = strlen(str);
+
+	put_head(c, CBOR_TEXT, len);
+	put(c, str, len);
+}
+
+void tmo_cbor_bool(struct tmo_cbor *c, bool val)
+{
+	put_head(c, CBOR_SIMPLE, val ? CBOR_TRUE : CBOR_FALSE);
+}
+
+void tmo_cbor_null(struct tmo_cbor *c)
+{
+	put_head(c, CBOR_SIMPLE, CBOR_NULL);
+}
+
+void tmo_cbor_decimal(struct tmo_cbor *c, int64_t mantissa, int exp)
+{
+	put_head(c, CBOR_TAG, CBOR_TAG_DECFRAC);
+	put_head(c, CBOR_ARRAY, 2);
+	tmo_cbor_int(c, exp);
+	tmo_cbor_int(c, mantissa);
+}
+
+int tmo_cbor_finish(struct tmo_cbor *c)
+{
+	return c->err ? c->err : (int)c->len;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TMO_CBOR_H
+#define TMO_CBOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Minimal RFC 8949 encoder covering what the telemetry model needs: maps,
+ * arrays, text keys, integers, booleans, null and decimal fractions.
+ * Errors are sticky, so a sequence of calls only needs one check at the end.
+ */
+struct tmo_cbor {
+	uint8_t *buf;
+	size_t size;
+	size_t len;
+	int err;
+};
+
+/**
+ * @brief Start encoding into buf. A NULL buf only counts the encoded size
+ */
+void tmo_cbor_init(struct tmo_cbor *c, uint8_t *buf, size_t size);
+
+/**
+ * @brief Start a map or array. Pass a negative count for indefinite length,
+ * which must then be closed with tmo_cbor_end()
+ */
+void tmo_cbor_map(struct tmo_cbor *c, int pairs);
+void tmo_cbor_array(struct tmo_cbor *c, int items);
+void tmo_cbor_end(struct tmo_cbor *c);
+
+void tmo_cbor_uint(struct tmo_cbor *c, uint64_t val);
+void tmo_cbor_int(struct tmo_cbor *c, int64_t val);
+void tmo_cbor_text(struct tmo_cbor *c, const char *str);
+void tmo_cbor_bool(struct tmo_cbor *c, bool val);
+void tmo_cbor_null(struct tmo_cbor *c);
+
+/**
+ * @brief Encode mantissa * 10^exp as a tag 4 decimal fraction, which carries
+ * exactly the digits the JSON encoding prints
+ */
+void tmo_cbor_decimal(struct tmo_cbor *c, int64_t mantissa, int exp);
+
+/**
+ * @brief Returns the encoded length, or -err if the buffer overflowed
+ */
+int tmo_cbor_finish(struct tmo_cbor *c);
+
+#endif
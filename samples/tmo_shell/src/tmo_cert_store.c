@@ -0,0 +1,702 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Indexed CA certificate store. The data file keeps the cert.bin layout the
+ * shell has always used, a CN/size record followed by the DER. The index
+ * file next to it is
+ *
+ *   header | uint16 buckets[CONFIG_TMO_CERT_INDEX_BUCKETS] | entries[count]
+ *
+ * where a bucket holds entry number + 1 (0 is empty) and is probed linearly
+ * from the CN hash. Deleting an entry only flags it, both in the index and
+ * in the record size, so a rebuilt index agrees; compaction reclaims the
+ * space. The index records the data file length it was built for and is
+ * rebuilt from the data file whenever the two disagree, e.g. after a reset
+ * in the middle of an add or on a store written by older firmware. A delete
+ * leaves the length alone, so it marks the index stale for its duration.
+ *
+ * The meta file caches what listing a certificate needs (subject, issuer,
+ * validity, key, fingerprint) as a fixed size record per entry number. It
+ * is written when the certificate is added, so listing the store does not
+ * run the X.509 parser. A rebuild keeps the records whose fingerprint still
+ * matches the DER and parses the rest again.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fs.h>
+#include <zephyr/sys/byteorder.h>
+#include <mbedtls/oid.h>
+#include <mbedtls/pk.h>
+#include <mbedtls/x509_crt.h>
+
+#include "tmo_cert_store.h"
+
+#define CERT_IDX_MAGIC	 0x58444943 /* "CIDX" */
+#define CERT_IDX_VERSION 1
+
+/* Set in cert_record.cert_sz of a deleted certificate */
+#define CERT_REC_DELETED 0x8000
+
+/* tmo_cert_idx_hdr.data_len while a delete is in progress, matches no file */
+#define CERT_IDX_STALE UINT32_MAX
+
+#define CERT_IDX_BUCKETS     CONFIG_TMO_CERT_INDEX_BUCKETS
+#define CERT_IDX_MAX_ENTRIES (CERT_IDX_BUCKETS * 3 / 4)
+
+#define BUCKET_OFF(b) (sizeof(struct tmo_cert_idx_hdr) + (b) * sizeof(uint16_t))
+#define ENTRY_OFF(n)                                                                               \
+	(BUCKET_OFF(CERT_IDX_BUCKETS) + (n) * sizeof(struct tmo_cert_entry))
+
+/* Largest DER that fits ca_cert, longer ones only get their size and CN as metadata */
+#define CERT_DER_MAX 2048
+
+#define META_OFF(n) ((n) * sizeof(struct tmo_cert_meta))
+
+BUILD_ASSERT(IS_POWER_OF_TWO(CERT_IDX_BUCKETS), "Index buckets must be a power of two");
+
+struct cert_record {
+	char cert_cn[TMO_CERT_CN_LEN];
+	uint16_t cert_sz;
+};
+
+/* Shell transfer buffer, holds the DER while the index is rebuilt */
+extern uint8_t mxfer_buf[];
+static mbedtls_x509_crt meta_crt;
+
+static void store_path(const struct tmo_cert_store *st, const char *ext, char *path, size_t len)
+{
+	snprintf(path, len, "%s%s", st->base, ext);
+}
+
+static uint32_t cn_hash(const char *cn)
+{
+	size_t len = strnlen(cn, TMO_CERT_CN_LEN);
+	uint32_t h = 2166136261U;
+
+	for (size_t i = 0; i < len; i++) {
+		h ^= (uint8_t)cn[i];
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static int file_pread(struct fs_file_t *file, off_t off, void *buf, size_t len)
+{
+	int ret = fs_seek(file, off, FS_SEEK_SET);
+
+	if (ret) {
+		return ret;
+	}
+	ret = fs_read(file, buf, len);
+	return ret == len ? 0 : (ret < 0 ? ret : -EIO);
+}
+
+static int file_pwrite(struct fs_file_t *file, off_t off, const void *buf, size_t len)
+{
+	int ret = fs_seek(file, off, FS_SEEK_SET);
+
+	if (ret) {
+		return ret;
+	}
+	ret = fs_write(file, buf, len);
+	return ret == len ? 0 : (ret < 0 ? ret : -EIO);
+}
+
+static off_t file_size(struct fs_file_t *file)
+{
+	int ret = fs_seek(file, 0, FS_SEEK_END);
+
+	return ret ? ret : fs_tell(file);
+}
+
+static int hdr_write(struct tmo_cert_store *st)
+{
+	return file_pwrite(&st->idx, 0, &st->hdr, sizeof(st->hdr));
+}
+
+/* Prefers the CN, falls back to the whole DN */
+static bool meta_name(const mbedtls_x509_name *dn, char *out, size_t len)
+{
+	for (const mbedtls_x509_name *n = dn; n; n = n->next) {
+		if (MBEDTLS_OID_CMP(MBEDTLS_OID_AT_CN, &n->oid) == 0) {
+			size_t l = MIN(n->val.len, len - 1);
+
+			memcpy(out, n->val.p, l);
+			out[l] = '\0';
+			return true;
+		}
+	}
+	if (mbedtls_x509_dn_gets(out, len, dn) < 0) {
+		out[0] = '\0';
+	}
+	out[len - 1] = '\0';
+	return false;
+}
+
+static void meta_time(const mbedtls_x509_time *t, struct tmo_cert_time *out)
+{
+	out->year = t->year;
+	out->mon = t->mon;
+	out->day = t->day;
+	out->hour = t->hour;
+	out->min = t->min;
+	out->sec = t->sec;
+}
+
+static void meta_fingerprint(const uint8_t *der, uint16_t len, uint8_t *out)
+{
+	struct tmo_digest d;
+
+	tmo_digest_start(&d, TMO_DIGEST_SHA256);
+	tmo_digest_update(&d, der, len);
+	tmo_digest_finish(&d);
+	memcpy(out, d.sha256, TMO_DIGEST_SHA256_LEN);
+}
+
+/* Without a parsed subject, name the record by the CN it is stored under */
+static void meta_fallback(const char *cn, struct tmo_cert_meta *meta)
+{
+	size_t l = MIN(strnlen(cn, TMO_CERT_CN_LEN), sizeof(meta->subject) - 1);
+
+	memcpy(meta->subject, cn, l);
+	meta->subject[l] = '\0';
+	meta->flags |= TMO_CERT_META_CN;
+}
+
+/* cn, if not NULL, names the record when the DER does not parse */
+static void meta_parse(const uint8_t *der, uint16_t len, const char *cn,
+		       struct tmo_cert_meta *meta)
+{
+	uint32_t start = k_cycle_get_32();
+
+	memset(meta, 0, sizeof(*meta));
+	meta->size = len;
+	mbedtls_x509_crt_init(&meta_crt);
+	if (mbedtls_x509_crt_parse_der_nocopy(&meta_crt, der, len) == 0) {
+		meta->version = meta_crt.version;
+		if (meta_name(&meta_crt.subject, meta->subject, sizeof(meta->subject))) {
+			meta->flags |= TMO_CERT_META_CN;
+		}
+		meta_name(&meta_crt.issuer, meta->issuer, sizeof(meta->issuer));
+		meta_time(&meta_crt.valid_from, &meta->not_before);
+		meta_time(&meta_crt.valid_to, &meta->not_after);
+		strncpy(meta->key_type, mbedtls_pk_get_name(&meta_crt.pk),
+			sizeof(meta->key_type) - 1);
+		meta->key_bits = mbedtls_pk_get_bitlen(&meta_crt.pk);
+	} else if (cn) {
+		meta_fallback(cn, meta);
+	}
+	mbedtls_x509_crt_free(&meta_crt);
+	meta->parse_us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+	meta_fingerprint(der, len, meta->fingerprint);
+}
+
+/* Keeps the cached record of entry num if it still describes its DER */
+static int meta_refresh(struct tmo_cert_store *st, int num, const char *cn, uint32_t offset,
+			uint16_t size)
+{
+	uint8_t *der = mxfer_buf;
+	uint8_t fp[TMO_DIGEST_SHA256_LEN];
+	struct tmo_cert_meta meta;
+	int ret;
+
+	if (size > CERT_DER_MAX) {
+		memset(&meta, 0, sizeof(meta));
+		meta.size = size;
+		meta_fallback(cn, &meta);
+		return file_pwrite(&st->meta, META_OFF(num), &meta, sizeof(meta));
+	}
+	ret = file_pread(&st->data, offset + sizeof(struct cert_record), der, size);
+	if (ret) {
+		return ret;
+	}
+	if (file_pread(&st->meta, META_OFF(num), &meta, sizeof(meta)) == 0 && meta.size == size) {
+		meta_fingerprint(der, size, fp);
+		if (memcmp(fp, meta.fingerprint, sizeof(fp)) == 0) {
+			return 0;
+		}
+	}
+	meta_parse(der, size, cn, &meta);
+	return file_pwrite(&st->meta, META_OFF(num), &meta, sizeof(meta));
+}
+
+static int index_init(struct tmo_cert_store *st)
+{
+	uint16_t zero[32] = {0};
+	int ret;
+
+	ret = fs_truncate(&st->idx, 0);
+	if (ret) {
+		return ret;
+	}
+	memset(&st->hdr, 0, sizeof(st->hdr));
+	st->hdr.magic = CERT_IDX_MAGIC;
+	st->hdr.version = CERT_IDX_VERSION;
+	st->hdr.buckets = CERT_IDX_BUCKETS;
+	ret = hdr_write(st);
+	for (int b = 0; b < CERT_IDX_BUCKETS && !ret; b += ARRAY_SIZE(zero)) {
+		ret = fs_write(&st->idx, zero,
+			       MIN(ARRAY_SIZE(zero), CERT_IDX_BUCKETS - b) * sizeof(uint16_t));
+		ret = ret < 0 ? ret : 0;
+	}
+	return ret;
+}
+
+/* Adds an entry to the index, the caller writes the header */
+static int index_append(struct tmo_cert_store *st, const char *cn, uint32_t offset, uint16_t size,
+			uint16_t flags)
+{
+	struct tmo_cert_entry ent = {
+		.hash = cn_hash(cn), .offset = offset, .size = size, .flags = flags};
+	uint16_t slot;
+	uint32_t b;
+	int ret;
+
+	if (st->hdr.count >= CERT_IDX_MAX_ENTRIES) {
+		return -ENOSPC;
+	}
+	ret = file_pwrite(&st->idx, ENTRY_OFF(st->hdr.count), &ent, sizeof(ent));
+	if (ret) {
+		return ret;
+	}
+	if (!(flags & TMO_CERT_DELETED)) {
+		/* The load factor limit guarantees an empty bucket */
+		for (b = ent.hash & (CERT_IDX_BUCKETS - 1);; b = (b + 1) & (CERT_IDX_BUCKETS - 1)) {
+			ret = file_pread(&st->idx, BUCKET_OFF(b), &slot, sizeof(slot));
+			if (ret) {
+				return ret;
+			}
+			if (slot == 0) {
+				break;
+			}
+		}
+		slot = st->hdr.count + 1;
+		ret = file_pwrite(&st->idx, BUCKET_OFF(b), &slot, sizeof(slot));
+		if (ret) {
+			return ret;
+		}
+		st->hdr.live++;
+	}
+	st->hdr.count++;
+	return 0;
+}
+
+static int index_rebuild(struct tmo_cert_store *st)
+{
+	off_t size = file_size(&st->data);
+	struct cert_record rec;
+	uint32_t offset = 0;
+	int ret;
+
+	if (size < 0) {
+		return size;
+	}
+	ret = index_init(st);
+	while (!ret && offset + sizeof(rec) <= size) {
+		uint16_t sz;
+
+		ret = file_pread(&st->data, offset, &rec, sizeof(rec));
+		if (ret) {
+			break;
+		}
+		sz = sys_be16_to_cpu(rec.cert_sz) & ~CERT_REC_DELETED;
+		if (offset + sizeof(rec) + sz > size) {
+			break;
+		}
+		ret = meta_refresh(st, st->hdr.count, rec.cert_cn, offset, sz);
+		if (!ret) {
+			ret = index_append(st, rec.cert_cn, offset, sz,
+					   (sys_be16_to_cpu(rec.cert_sz) & CERT_REC_DELETED)
+						   ? TMO_CERT_DELETED
+						   : 0);
+		}
+		offset += sizeof(rec) + sz;
+	}
+	if (!ret) {
+		ret = fs_truncate(&st->meta, META_OFF(st->hdr.count));
+	}
+	if (ret) {
+		return ret;
+	}
+	/* Drop a record torn by a reset during an add */
+	if (offset != size) {
+		ret = fs_truncate(&st->data, offset);
+		if (ret) {
+			return ret;
+		}
+	}
+	st->hdr.data_len = offset;
+	return hdr_write(st);
+}
+
+static int index_load(struct tmo_cert_store *st)
+{
+	off_t size = file_size(&st->data);
+	off_t meta_size = file_size(&st->meta);
+
+	if (size < 0 || meta_size < 0) {
+		return size < 0 ? size : meta_size;
+	}
+	if (file_pread(&st->idx, 0, &st->hdr, sizeof(st->hdr)) ||
+	    st->hdr.magic != CERT_IDX_MAGIC || st->hdr.version != CERT_IDX_VERSION ||
+	    st->hdr.buckets != CERT_IDX_BUCKETS || st->hdr.data_len != size ||
+	    meta_size != META_OFF(st->hdr.count)) {
+		return index_rebuild(st);
+	}
+	return 0;
+}
+
+int tmo_cert_store_open(struct tmo_cert_store *st, const char *base, bool truncate)
+{
+	char path[32];
+	int ret;
+
+	memset(st, 0, sizeof(*st));
+	strncpy(st->base, base, sizeof(st->base) - 1);
+
+	store_path(st, ".bin", path, sizeof(path));
+	ret = fs_open(&st->data, path, FS_O_CREATE | FS_O_RDWR);
+	if (ret) {
+		return ret;
+	}
+	store_path(st, ".idx", path, sizeof(path));
+	ret = fs_open(&st->idx, path, FS_O_CREATE | FS_O_RDWR);
+	if (ret) {
+		fs_close(&st->data);
+		return ret;
+	}
+	store_path(st, ".meta", path, sizeof(path));
+	ret = fs_open(&st->meta, path, FS_O_CREATE | FS_O_RDWR);
+	if (ret) {
+		fs_close(&st->idx);
+		fs_close(&st->data);
+		return ret;
+	}
+
+	if (truncate) {
+		ret = fs_truncate(&st->data, 0);
+		if (!ret) {
+			ret = fs_truncate(&st->meta, 0);
+		}
+		if (!ret) {
+			ret = index_init(st);
+		}
+	} else {
+		ret = index_load(st);
+	}
+	if (ret) {
+		tmo_cert_store_close(st);
+	}
+	return ret;
+}
+
+void tmo_cert_store_close(struct tmo_cert_store *st)
+{
+	fs_close(&st->meta);
+	fs_close(&st->idx);
+	fs_close(&st->data);
+}
+
+int tmo_cert_store_remove(const char *base)
+{
+	static const char *const exts[] = {".bin", ".idx", ".meta", ".tmp"};
+	char path[32];
+	int ret = 0;
+
+	for (int i = 0; i < ARRAY_SIZE(exts); i++) {
+		int err;
+
+		snprintf(path, sizeof(path), "%s%s", base, exts[i]);
+		err = fs_unlink(path);
+		if (err && err != -ENOENT && !ret) {
+			ret = err;
+		}
+	}
+	return ret;
+}
+
+int tmo_cert_store_add(struct tmo_cert_store *st, const char *cn, const uint8_t *der,
+		       uint16_t len)
+{
+	struct cert_record rec = {0};
+	struct tmo_cert_meta meta;
+	uint32_t offset = st->hdr.data_len;
+	int ret;
+
+	if (len == 0 || (len & CERT_REC_DELETED)) {
+		return -EINVAL;
+	}
+	if (st->hdr.count >= CERT_IDX_MAX_ENTRIES) {
+		return -ENOSPC;
+	}
+	meta_parse(der, len, cn, &meta);
+	if (cn == NULL) {
+		if (meta.version == 0) {
+			return -EINVAL;
+		}
+		cn = (meta.flags & TMO_CERT_META_CN) ? meta.subject : "";
+	}
+	memcpy(rec.cert_cn, cn, strnlen(cn, sizeof(rec.cert_cn)));
+	rec.cert_sz = sys_cpu_to_be16(len);
+
+	/* Header last: a reset before it leaves a stale index, rebuilt on open */
+	ret = file_pwrite(&st->data, offset, &rec, sizeof(rec));
+	if (!ret) {
+		ret = fs_write(&st->data, der, len);
+		ret = ret == len ? 0 : (ret < 0 ? ret : -EIO);
+	}
+	if (!ret) {
+		ret = file_pwrite(&st->meta, META_OFF(st->hdr.count), &meta, sizeof(meta));
+	}
+	if (!ret) {
+		ret = index_append(st, rec.cert_cn, offset, len, 0);
+	}
+	if (ret) {
+		return ret;
+	}
+	st->hdr.data_len = offset + sizeof(rec) + len;
+	ret = hdr_write(st);
+	return ret ? ret : st->hdr.count - 1;
+}
+
+static int entry_read(struct tmo_cert_store *st, int num, struct tmo_cert_entry *ent)
+{
+	if (num < 0 || num >= st->hdr.count) {
+		return -ENOENT;
+	}
+	return file_pread(&st->idx, ENTRY_OFF(num), ent, sizeof(*ent));
+}
+
+int tmo_cert_store_get(struct tmo_cert_store *st, int num, struct tmo_cert_entry *ent)
+{
+	int ret = entry_read(st, num, ent);
+
+	if (ret) {
+		return ret;
+	}
+	return (ent->flags & TMO_CERT_DELETED) ? -ENOENT : 0;
+}
+
+int tmo_cert_store_find(struct tmo_cert_store *st, const char *cn, struct tmo_cert_entry *ent)
+{
+	char rec_cn[TMO_CERT_CN_LEN];
+	uint32_t h = cn_hash(cn);
+	uint32_t b = h & (CERT_IDX_BUCKETS - 1);
+	uint16_t slot;
+	int ret;
+
+	if (*cn == '\0') {
+		return -EINVAL;
+	}
+	for (int i = 0; i < CERT_IDX_BUCKETS; i++, b = (b + 1) & (CERT_IDX_BUCKETS - 1)) {
+		ret = file_pread(&st->idx, BUCKET_OFF(b), &slot, sizeof(slot));
+		if (ret) {
+			return ret;
+		}
+		if (slot == 0) {
+			break;
+		}
+		ret = tmo_cert_store_get(st, slot - 1, ent);
+		if (ret == -ENOENT || (!ret && ent->hash != h)) {
+			continue;
+		} else if (ret) {
+			return ret;
+		}
+		/* Hash match, confirm against the CN in the data file */
+		ret = file_pread(&st->data, ent->offset, rec_cn, sizeof(rec_cn));
+		if (ret) {
+			return ret;
+		}
+		if (strncmp(rec_cn, cn, sizeof(rec_cn)) == 0) {
+			return slot - 1;
+		}
+	}
+	return -ENOENT;
+}
+
+int tmo_cert_store_read(struct tmo_cert_store *st, const struct tmo_cert_entry *ent, char *cn,
+			uint8_t *der, size_t len)
+{
+	int ret;
+
+	if (cn) {
+		ret = file_pread(&st->data, ent->offset, cn, TMO_CERT_CN_LEN);
+		if (ret) {
+			return ret;
+		}
+		cn[TMO_CERT_CN_LEN] = '\0';
+	}
+	if (der) {
+		if (len < ent->size) {
+			return -ENOMEM;
+		}
+		ret = file_pread(&st->data, ent->offset + sizeof(struct cert_record), der,
+				 ent->size);
+		if (ret) {
+			return ret;
+		}
+	}
+	return 0;
+}
+
+int tmo_cert_store_meta(struct tmo_cert_store *st, int num, struct tmo_cert_meta *meta)
+{
+	struct tmo_cert_entry ent;
+	int ret = tmo_cert_store_get(st, num, &ent);
+
+	if (ret) {
+		return ret;
+	}
+	return file_pread(&st->meta, META_OFF(num), meta, sizeof(*meta));
+}
+
+int tmo_cert_store_delete(struct tmo_cert_store *st, int num)
+{
+	struct tmo_cert_entry ent;
+	uint32_t data_len = st->hdr.data_len;
+	uint16_t sz;
+	int ret;
+
+	ret = tmo_cert_store_get(st, num, &ent);
+	if (ret) {
+		return ret;
+	}
+	/*
+	 * The tombstone does not change the data file length, so a reset
+	 * between it and the index entry would go unnoticed on open. Mark the
+	 * index stale until both are written.
+	 */
+	st->hdr.data_len = CERT_IDX_STALE;
+	ret = hdr_write(st);
+	st->hdr.data_len = data_len;
+	if (ret) {
+		return ret;
+	}
+	sz = sys_cpu_to_be16(ent.size | CERT_REC_DELETED);
+	ret = file_pwrite(&st->data, ent.offset + offsetof(struct cert_record, cert_sz), &sz,
+			  sizeof(sz));
+	if (!ret) {
+		ent.flags |= TMO_CERT_DELETED;
+		ret = file_pwrite(&st->idx, ENTRY_OFF(num), &ent, sizeof(ent));
+	}
+	if (ret) {
+		/* Bring the index back in line with whatever reached the data file */
+		index_rebuild(st);
+		return ret;
+	}
+	st->hdr.live--;
+	return hdr_write(st);
+}
+
+int tmo_cert_store_compact(struct tmo_cert_store *st)
+{
+	struct fs_file_t tmp = {0};
+	struct tmo_cert_entry ent;
+	struct tmo_cert_meta meta;
+	uint32_t data_len = st->hdr.data_len;
+	char path[32], tmp_path[32];
+	uint8_t buf[128];
+	int ret, err, kept = 0;
+
+	if (st->hdr.live == st->hdr.count) {
+		return 0;
+	}
+	store_path(st, ".tmp", tmp_path, sizeof(tmp_path));
+	ret = fs_open(&tmp, tmp_path, FS_O_CREATE | FS_O_WRITE);
+	if (ret) {
+		return ret;
+	}
+	/*
+	 * The metadata is moved in place and the data file swapped without
+	 * changing the index, so a reset part way must force a rebuild on open
+	 */
+	st->hdr.data_len = CERT_IDX_STALE;
+	ret = hdr_write(st);
+	st->hdr.data_len = data_len;
+	if (!ret) {
+		ret = fs_truncate(&tmp, 0);
+	}
+	for (int num = 0; num < st->hdr.count && !ret; num++) {
+		if (tmo_cert_store_get(st, num, &ent)) {
+			continue;
+		}
+		/*
+		 * Slide the cached metadata down in place, kept never passes
+		 * num so nothing is overwritten before it is read
+		 */
+		ret = file_pread(&st->meta, META_OFF(num), &meta, sizeof(meta));
+		if (!ret && kept != num) {
+			ret = file_pwrite(&st->meta, META_OFF(kept), &meta, sizeof(meta));
+		}
+		kept++;
+		if (!ret) {
+			ret = fs_seek(&st->data, ent.offset, FS_SEEK_SET);
+		}
+		for (size_t left = sizeof(struct cert_record) + ent.size; left && !ret;) {
+			size_t n = MIN(left, sizeof(buf));
+
+			ret = fs_read(&st->data, buf, n);
+			if (ret == n) {
+				ret = fs_write(&tmp, buf, n);
+			}
+			ret = ret == n ? 0 : (ret < 0 ? ret : -EIO);
+			left -= n;
+		}
+	}
+	fs_close(&tmp);
+	if (ret) {
+		fs_unlink(tmp_path);
+		/* Realign the metadata already moved with the untouched data */
+		index_rebuild(st);
+		return ret;
+	}
+
+	/* The rename replaces the old data file atomically */
+	store_path(st, ".bin", path, sizeof(path));
+	fs_close(&st->data);
+	ret = fs_rename(tmp_path, path);
+	if (ret) {
+		fs_unlink(tmp_path);
+	}
+	/* Whichever data file is in place now, the index is rebuilt from it */
+	err = fs_open(&st->data, path, FS_O_CREATE | FS_O_RDWR);
+	if (err) {
+		/* Leave nothing to read or write through, the next open rebuilds */
+		memset(&st->hdr, 0, sizeof(st->hdr));
+		return ret ? ret : err;
+	}
+	err = index_rebuild(st);
+	return ret ? ret : err;
+}
+
+int tmo_cert_store_scan(struct tmo_cert_store *st, const char *cn, struct tmo_cert_entry *ent)
+{
+	struct cert_record rec;
+	uint32_t offset = 0;
+	int num = 0;
+
+	while (offset < st->hdr.data_len) {
+		uint16_t sz;
+
+		if (file_pread(&st->data, offset, &rec, sizeof(rec))) {
+			return -EIO;
+		}
+		sz = sys_be16_to_cpu(rec.cert_sz);
+		if (!(sz & CERT_REC_DELETED) && strncmp(rec.cert_cn, cn, sizeof(rec.cert_cn)) == 0) {
+			ent->hash = cn_hash(cn);
+			ent->offset = offset;
+			ent->size = sz;
+			ent->flags = 0;
+			return num;
+		}
+		offset += sizeof(rec) + (sz & ~CERT_REC_DELETED);
+		num++;
+	}
+	return -ENOENT;
+}
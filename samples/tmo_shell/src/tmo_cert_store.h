@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TMO_CERT_STORE_H
+#define TMO_CERT_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/fs/fs.h>
+#include <zephyr/sys/util.h>
+
+#include "tmo_digest.h"
+
+#define TMO_CERT_STORE_PATH "/tmo/certs/cert"
+#define TMO_CERT_CN_LEN	    64
+
+#define TMO_CERT_DELETED BIT(0)
+
+struct tmo_cert_entry {
+	/* FNV-1a of the CN */
+	uint32_t hash;
+	/* Offset of the record header in the data file */
+	uint32_t offset;
+	/* DER length */
+	uint16_t size;
+	uint16_t flags;
+};
+
+#define TMO_CERT_META_NAME_LEN 64
+
+/* tmo_cert_meta.subject is the subject CN rather than the whole DN */
+#define TMO_CERT_META_CN BIT(0)
+
+struct tmo_cert_time {
+	uint16_t year;
+	uint8_t mon;
+	uint8_t day;
+	uint8_t hour;
+	uint8_t min;
+	uint8_t sec;
+	uint8_t reserved;
+};
+
+/**
+ * @brief What a listing needs from a certificate, parsed once when it is added
+ */
+struct tmo_cert_meta {
+	/* DER length the record was made from */
+	uint16_t size;
+	uint16_t key_bits;
+	/* X.509 version, 0 if the DER did not parse */
+	uint8_t version;
+	uint8_t flags;
+	char key_type[14];
+	struct tmo_cert_time not_before;
+	struct tmo_cert_time not_after;
+	/* The CN the record is stored under if the DER did not parse */
+	char subject[TMO_CERT_META_NAME_LEN];
+	char issuer[TMO_CERT_META_NAME_LEN];
+	/* SHA-256 of the DER */
+	uint8_t fingerprint[TMO_DIGEST_SHA256_LEN];
+	/* What parsing the DER took, i.e. what reading this record saves */
+	uint32_t parse_us;
+};
+
+struct tmo_cert_idx_hdr {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t buckets;
+	/* Entries, deleted ones included */
+	uint16_t count;
+	uint16_t live;
+	/* Length of the data file this index describes */
+	uint32_t data_len;
+};
+
+/**
+ * @brief Certificate store
+ *
+ * <base>.bin holds the certificates as CN/size records followed by the DER,
+ * in the order they were added. <base>.idx holds an open addressed hash
+ * table of CN to entry number and the entry table itself, so a lookup by
+ * CN or by number reads a few index words instead of walking the data file.
+ * <base>.meta holds a struct tmo_cert_meta per entry number.
+ */
+struct tmo_cert_store {
+	char base[24];
+	struct fs_file_t data;
+	struct fs_file_t idx;
+	struct fs_file_t meta;
+	struct tmo_cert_idx_hdr hdr;
+};
+
+/**
+ * @brief Open a store, rebuilding the index if it is missing or stale
+ *
+ * @param truncate Start with an empty store
+ */
+int tmo_cert_store_open(struct tmo_cert_store *st, const char *base, bool truncate);
+void tmo_cert_store_close(struct tmo_cert_store *st);
+
+/**
+ * @brief Delete the files of a closed store
+ *
+ * @return 0, or the first error other than -ENOENT
+ */
+int tmo_cert_store_remove(const char *base);
+
+/**
+ * @brief Add a certificate and its parsed metadata
+ *
+ * @param cn CN to index it under, or NULL to use the subject CN of the
+ * certificate, in which case a DER that does not parse is refused
+ * @return The new entry number, or a negative errno
+ */
+int tmo_cert_store_add(struct tmo_cert_store *st, const char *cn, const uint8_t *der,
+		       uint16_t len);
+
+/** @return 0, or -ENOENT if the entry does not exist or was deleted */
+int tmo_cert_store_get(struct tmo_cert_store *st, int num, struct tmo_cert_entry *ent);
+
+/** @return The entry number, or -ENOENT */
+int tmo_cert_store_find(struct tmo_cert_store *st, const char *cn, struct tmo_cert_entry *ent);
+
+/**
+ * @brief Read an entry's CN and/or DER
+ *
+ * @param cn Buffer of TMO_CERT_CN_LEN + 1 bytes, or NULL
+ * @param der Buffer for the DER, or NULL
+ */
+int tmo_cert_store_read(struct tmo_cert_store *st, const struct tmo_cert_entry *ent, char *cn,
+			uint8_t *der, size_t len);
+
+/** @brief Read the cached metadata of an entry */
+int tmo_cert_store_meta(struct tmo_cert_store *st, int num, struct tmo_cert_meta *meta);
+
+int tmo_cert_store_delete(struct tmo_cert_store *st, int num);
+
+/**
+ * @brief Drop deleted entries from the data file and rebuild the index
+ *
+ * Entry numbers of the certificates after a deleted one change.
+ */
+int tmo_cert_store_compact(struct tmo_cert_store *st);
+
+/** @brief Lookup by walking the data file, the reference for the benchmark */
+int tmo_cert_store_scan(struct tmo_cert_store *st, const char *cn, struct tmo_cert_entry *ent);
+
+static inline int tmo_cert_store_count(const struct tmo_cert_store *st)
+{
+	return st->hdr.count;
+}
+
+#endif
@@ -16,11 +16,13 @@
 #include <zephyr/shell/shell.h>
 
 #include "tmo_shell.h"
+#include "tmo_cert_store.h"
+#include "tmo_tls_creds.h"
 #include "ca_certificate.h"
 #include "tmo_http_request.h"
 
-#define CERT_BIN_LOCATION "/tmo/certs/cert.bin"
 #define CERT_BIN_FOLDER "/tmo/certs/"
+#define CERT_BENCH_STORE "/tmo/certs/bench"
 #define HTTP_PREFIX  "http://"
 #define HTTPS_PREFIX  "https://"
 
@@ -32,114 +34,274 @@ static char *dec_buf = &mxfer_buf[2000];
 static int cert_cnt, success_cnt;
 mbedtls_x509_crt ca_x509;
 
-struct cert_record {
-	char cert_cn[64];
-	uint16_t cert_sz;
-};
-
+static bool is_number(const char *str)
+{
+	if (*str == '\0') {
+		return false;
+	}
+	for (; *str; str++) {
+		if (*str < '0' || *str > '9') {
+			return false;
+		}
+	}
+	return true;
+}
 
 int cmd_tmo_cert_load(const struct shell *shell, size_t argc, char **argv)
 {
 	if (argc < 2){
 		shell_error(shell, "Missing required arguments");
+		shell_print(shell, "Usage: tmo certs load <number or CN>");
 		return -EINVAL;
 	}
-	int target = strtol(argv[1], NULL, 10);
-	char cn_buf[65] = {0};
-	struct cert_record rec = {0};
-	int idx = 0, stat;
-	char *filename = CERT_BIN_LOCATION;
-	struct fs_file_t file = {0};
-	stat = fs_open(&file, filename, FS_O_READ);
+	char cn_buf[TMO_CERT_CN_LEN + 1] = {0};
+	struct tmo_cert_store store;
+	struct tmo_cert_entry ent;
+	int target, stat;
+
+	stat = tmo_cert_store_open(&store, TMO_CERT_STORE_PATH, false);
 	if (stat) {
-		shell_error(shell, "Failed to open file %s (%d)", filename, stat);
+		shell_error(shell, "Failed to open cert store %s (%d)", TMO_CERT_STORE_PATH, stat);
 		return -EIO;
 	}
-	while (1){
-		memset(&rec, 0, sizeof(rec));
-		stat = fs_read(&file, &rec, sizeof(rec));
-		if (stat == 0) {
-			shell_error(shell, "Cert not found");
-			fs_close(&file);
-			return -EINVAL;
-		} else if (stat != sizeof(rec)) {
-			shell_error(shell, "Bad entry in %s", filename);
-			fs_close(&file);
-			return -EIO;
-		}
-		memcpy(cn_buf, rec.cert_cn, 64);
-		if (idx != target) {
-			fs_seek(&file, sys_be16_to_cpu(rec.cert_sz), FS_SEEK_CUR);
-		} else {
-			memcpy(cn_buf, rec.cert_cn, 64);
-			fs_read(&file, ca_cert, sys_be16_to_cpu(rec.cert_sz));
-			ca_cert_sz = sys_be16_to_cpu(rec.cert_sz);
-			tls_credential_delete(CA_CERTIFICATE_TAG, TLS_CREDENTIAL_CA_CERTIFICATE);
-			tls_credential_add(CA_CERTIFICATE_TAG, TLS_CREDENTIAL_CA_CERTIFICATE,
-					ca_cert, ca_cert_sz);
-			if (strlen(cn_buf)){
-				shell_print(shell, "Cert \"%s\" loaded (%d bytes)", cn_buf, ca_cert_sz);
-			} else {
-				shell_print(shell, "Cert loaded (%d bytes)", ca_cert_sz);   
-			}
-			fs_close(&file);
-			ca_cert_idx = target;
-			return 0;
-		}
-		idx++;
+	if (is_number(argv[1])) {
+		target = strtol(argv[1], NULL, 10);
+		stat = tmo_cert_store_get(&store, target, &ent);
+	} else {
+		target = stat = tmo_cert_store_find(&store, argv[1], &ent);
+	}
+	if (stat < 0) {
+		shell_error(shell, "Cert not found");
+		tmo_cert_store_close(&store);
+		return -EINVAL;
+	}
+	/* ca_cert backs the registered user CA, unregister it before overwriting */
+	tmo_tls_creds_set_user_ca(NULL, 0);
+	ca_cert_sz = 0;
+	stat = tmo_cert_store_read(&store, &ent, cn_buf, ca_cert, sizeof(ca_cert));
+	tmo_cert_store_close(&store);
+	if (stat) {
+		shell_error(shell, "Failed to read cert %d (%d)", target, stat);
+		return -EIO;
+	}
+	ca_cert_sz = ent.size;
+	stat = tmo_tls_creds_set_user_ca(ca_cert, ca_cert_sz);
+	if (stat) {
+		shell_error(shell, "Failed to register cert %d (%d)", target, stat);
+		return stat;
+	}
+	if (strlen(cn_buf)){
+		shell_print(shell, "Cert \"%s\" loaded (%d bytes)", cn_buf, ca_cert_sz);
+	} else {
+		shell_print(shell, "Cert loaded (%d bytes)", ca_cert_sz);
+	}
+	ca_cert_idx = target;
+	return 0;
+}
+
+static void print_meta(const struct shell *shell, const struct tmo_cert_meta *meta)
+{
+	char fp[2 * TMO_DIGEST_SHA256_LEN + 1];
+
+	for (int i = 0; i < TMO_DIGEST_SHA256_LEN; i++) {
+		sprintf(&fp[2 * i], "%02x", meta->fingerprint[i]);
 	}
+	shell_print(shell, "     Issuer: %s", meta->issuer);
+	shell_print(shell, "     Valid: %04u-%02u-%02u %02u:%02u:%02u to %04u-%02u-%02u %02u:%02u:%02u",
+		    meta->not_before.year, meta->not_before.mon, meta->not_before.day,
+		    meta->not_before.hour, meta->not_before.min, meta->not_before.sec,
+		    meta->not_after.year, meta->not_after.mon, meta->not_after.day,
+		    meta->not_after.hour, meta->not_after.min, meta->not_after.sec);
+	shell_print(shell, "     Key: %s %u bits, X.509 v%u, %u bytes", meta->key_type,
+		    meta->key_bits, meta->version, meta->size);
+	shell_print(shell, "     SHA-256: %s", fp);
 }
 
 int cmd_tmo_cert_list(const struct shell *shell, size_t argc, char **argv)
 {
 	char *search_string = "";
+	bool verbose = false;
+	if (argc >= 2 && !strcmp(argv[1], "-l")) {
+		verbose = true;
+		argc--;
+		argv++;
+	}
 	if (argc >= 2) {
 		search_string = argv[1];
 	}
-	char cn_buf[65] = {0};
-	struct cert_record rec = {0};
-	int idx = 0, stat;
-	char *filename = CERT_BIN_LOCATION;
-	struct fs_file_t file = {0};
-	stat = fs_open(&file, filename, FS_O_READ);
+	struct tmo_cert_store store;
+	struct tmo_cert_meta meta;
+	uint64_t saved_us = 0;
+	int listed = 0, stat;
+
+	stat = tmo_cert_store_open(&store, TMO_CERT_STORE_PATH, false);
 	if (stat) {
-		shell_error(shell, "Failed to open file %s (%d)", filename, stat);
+		shell_error(shell, "Failed to open cert store %s (%d)", TMO_CERT_STORE_PATH, stat);
 		return -EIO;
 	}
-	while (1){
-		memset(cn_buf, 0, sizeof(cn_buf));
-		memset(&rec, 0, sizeof(rec));
-		stat = fs_read(&file, &rec, sizeof(rec));
-		if (stat == 0) {
-			fs_close(&file);
-			return 0;
-		} else if (stat != sizeof(rec)) {
-			shell_error(shell, "Bad entry in %s", filename);
-			fs_close(&file);
+	/* Everything printed comes from the metadata cached when the cert was added */
+	for (int idx = 0; idx < tmo_cert_store_count(&store); idx++) {
+		stat = tmo_cert_store_meta(&store, idx, &meta);
+		if (stat == -ENOENT) {
+			continue;
+		} else if (stat) {
+			shell_error(shell, "Bad entry %d in %s", idx, TMO_CERT_STORE_PATH);
+			tmo_cert_store_close(&store);
 			return -EIO;
 		}
-		memcpy(cn_buf, rec.cert_cn, 64);
-		if (strlen(cn_buf)){
-			if (strstr(cn_buf, search_string))
-				shell_print(shell, "%03d: %s", idx, cn_buf);
-			fs_seek(&file, sys_be16_to_cpu(rec.cert_sz), FS_SEEK_CUR);
+		if (!strstr(meta.subject, search_string)) {
+			continue;
+		}
+		if (meta.version == 0) {
+			/* Only the CN it was stored under is known */
+			shell_print(shell, "%03d: %s%s<unparsed, %u bytes>", idx, meta.subject,
+				    meta.subject[0] ? " " : "", meta.size);
+		} else if (meta.flags & TMO_CERT_META_CN) {
+			shell_print(shell, "%03d: %s", idx, meta.subject);
 		} else {
-			char *subject_dn, *subject_eol;
-			fs_read(&file, dec_buf, sys_be16_to_cpu(rec.cert_sz));
-			mbedtls_x509_crt_init(&ca_x509);
-			mbedtls_x509_crt_parse_der_nocopy(&ca_x509, dec_buf, sys_be16_to_cpu(rec.cert_sz));
-			mbedtls_x509_crt_info(mxfer_buf, 2000, "", &ca_x509);
-			mbedtls_x509_crt_free(&ca_x509);
-			memset(dec_buf, 0, 3000);
-			subject_dn = strstr(mxfer_buf, "subject name");
-			subject_dn = strstr(subject_dn, ":") + 2;
-			subject_eol = strstr(subject_dn, "\n");
-			memcpy(dec_buf, subject_dn, subject_eol - subject_dn);
-			if (strstr(dec_buf, search_string))
-				shell_print(shell, "%03d: Subject name:%s", idx, dec_buf);
+			shell_print(shell, "%03d: Subject name:%s", idx, meta.subject);
+		}
+		if (verbose && meta.version) {
+			print_meta(shell, &meta);
 		}
-		idx++;
+		saved_us += meta.parse_us;
+		listed++;
 	}
+	tmo_cert_store_close(&store);
+	shell_print(shell, "%d certs, %u ms of X.509 parsing saved by the metadata cache", listed,
+		    (uint32_t)(saved_us / 1000));
+	return 0;
+}
+
+int cmd_tmo_cert_delete(const struct shell *shell, size_t argc, char **argv)
+{
+	struct tmo_cert_store store;
+	int stat;
+
+	if (argc < 2 || !is_number(argv[1])) {
+		shell_error(shell, "Missing required arguments");
+		shell_print(shell, "Usage: tmo certs delete <number>");
+		return -EINVAL;
+	}
+	stat = tmo_cert_store_open(&store, TMO_CERT_STORE_PATH, false);
+	if (stat) {
+		shell_error(shell, "Failed to open cert store %s (%d)", TMO_CERT_STORE_PATH, stat);
+		return -EIO;
+	}
+	stat = tmo_cert_store_delete(&store, strtol(argv[1], NULL, 10));
+	tmo_cert_store_close(&store);
+	if (stat == -ENOENT) {
+		shell_error(shell, "Cert not found");
+		return -EINVAL;
+	} else if (stat) {
+		shell_error(shell, "Failed to delete cert (%d)", stat);
+		return -EIO;
+	}
+	return 0;
+}
+
+int cmd_tmo_cert_compact(const struct shell *shell, size_t argc, char **argv)
+{
+	struct tmo_cert_store store;
+	uint32_t before;
+	int stat;
+
+	stat = tmo_cert_store_open(&store, TMO_CERT_STORE_PATH, false);
+	if (stat) {
+		shell_error(shell, "Failed to open cert store %s (%d)", TMO_CERT_STORE_PATH, stat);
+		return -EIO;
+	}
+	before = store.hdr.data_len;
+	stat = tmo_cert_store_compact(&store);
+	if (stat) {
+		shell_error(shell, "Compaction failed (%d)", stat);
+	} else {
+		shell_print(shell, "%d certs, %u bytes reclaimed", tmo_cert_store_count(&store),
+			    before - store.hdr.data_len);
+	}
+	tmo_cert_store_close(&store);
+	return stat;
+}
+
+/*
+ * Lookup benchmark. Grows a scratch store of same sized dummy certs and, at
+ * each size, times lookups by CN through the index and by walking the data
+ * file as the store used to.
+ */
+#define CERT_BENCH_DER_SIZE 1024
+#define CERT_BENCH_LOOKUPS  16
+
+static int cert_bench_lookups(struct tmo_cert_store *st, int n, bool indexed, uint32_t *us)
+{
+	struct tmo_cert_entry ent;
+	char cn[TMO_CERT_CN_LEN];
+	uint32_t start = k_cycle_get_32();
+
+	for (int i = 0; i < CERT_BENCH_LOOKUPS; i++) {
+		/* Spread over the store, last one is the worst case for a scan */
+		int target = (i + 1) * n / CERT_BENCH_LOOKUPS - 1;
+		int ret;
+
+		snprintf(cn, sizeof(cn), "Bench Root CA %04d", target);
+		ret = indexed ? tmo_cert_store_find(st, cn, &ent) : tmo_cert_store_scan(st, cn, &ent);
+		if (ret != target) {
+			return ret < 0 ? ret : -EIO;
+		}
+	}
+	*us = k_cyc_to_us_floor32(k_cycle_get_32() - start) / CERT_BENCH_LOOKUPS;
+	return 0;
+}
+
+int cmd_tmo_cert_bench(const struct shell *shell, size_t argc, char **argv)
+{
+	int max = argc > 1 ? strtol(argv[1], NULL, 10) : 256;
+	struct tmo_cert_store store;
+	char cn[TMO_CERT_CN_LEN];
+	int stat, n = 0;
+
+	if (max < CERT_BENCH_LOOKUPS) {
+		shell_error(shell, "Usage: tmo certs bench [max certs (>= %d)]", CERT_BENCH_LOOKUPS);
+		return -EINVAL;
+	}
+	stat = tmo_cert_store_open(&store, CERT_BENCH_STORE, true);
+	if (stat) {
+		shell_error(shell, "Failed to create %s (%d)", CERT_BENCH_STORE, stat);
+		return -EIO;
+	}
+	gen_payload(dec_buf, CERT_BENCH_DER_SIZE);
+	shell_print(shell, "certs  index us   scan us");
+	for (int size = CERT_BENCH_LOOKUPS; size <= max; size *= 2) {
+		uint32_t index_us, scan_us;
+
+		for (; n < size; n++) {
+			snprintf(cn, sizeof(cn), "Bench Root CA %04d", n);
+			stat = tmo_cert_store_add(&store, cn, dec_buf, CERT_BENCH_DER_SIZE);
+			if (stat < 0) {
+				break;
+			}
+		}
+		if (stat < 0) {
+			if (stat == -ENOSPC) {
+				shell_warn(shell, "Index full at %d certs", n);
+				stat = 0;
+			}
+			break;
+		}
+		stat = cert_bench_lookups(&store, n, true, &index_us);
+		if (!stat) {
+			stat = cert_bench_lookups(&store, n, false, &scan_us);
+		}
+		if (stat) {
+			break;
+		}
+		shell_print(shell, "%5d %9u %9u", n, index_us, scan_us);
+	}
+	tmo_cert_store_close(&store);
+	tmo_cert_store_remove(CERT_BENCH_STORE);
+	if (stat) {
+		shell_error(shell, "Benchmark failed (%d)", stat);
+	}
+	return stat;
 }
 
 int cmd_tmo_cert_info(const struct shell *shell, size_t argc, char **argv)
@@ -173,7 +335,7 @@ static inline bool isspace(char c)
 			c == '\v' || c == '\f' || c == '\r' || c == ' ' ? 1 : 0);
 }
 
-static void parse(struct fs_file_t *file, char * fragment, size_t fragment_len) 
+static void parse(struct tmo_cert_store *store, char * fragment, size_t fragment_len) 
 {
 	char chr;
 	// char dec_buf[96] = {0};
@@ -184,45 +346,23 @@ static void parse(struct fs_file_t *file, char * fragment, size_t fragment_len)
 				parse_state = outside_cert;
 				memset(ca_cert, 0, sizeof(ca_cert));
 				base64_decode(ca_cert, sizeof(ca_cert), &parse_cert_sz, dec_buf, buf_idx);
-				//Write to file
-				struct cert_record rec = {0};
-				rec.cert_sz = sys_cpu_to_be16(parse_cert_sz);
-				//fs_write(file, (uint8_t*)&sz_be, 2);
-				mbedtls_x509_crt_init(&ca_x509);
-				mbedtls_x509_crt_parse_der_nocopy(&ca_x509, ca_cert, parse_cert_sz);
-				mbedtls_x509_crt_info(dec_buf, 2048, "", &ca_x509);
-				int ver;
-				char *ver_start = strstr(dec_buf, "cert. version     : ");
-				ver_start += sizeof("cert. version     : ") - 1;
-				ver = strtol(ver_start, NULL, 10);
 				cert_cnt++;
-				if (ver != 0){
-					char *cn, *eol; 
-					cn = strstr(dec_buf, "subject name");
-					eol = strstr(cn, "\n");
-					cn = strstr(cn, "CN=");
-					if (cn && strstr(cn, ",") && strstr(cn, ",") < eol) {
-						eol = strstr(cn, ",");
-					}
-					if (!cn || cn > eol) {
-						cn = "";
-					} else {
-						cn += 3;
-						memcpy(rec.cert_cn, cn, MIN(eol-cn, 64));
-					}
-					fs_write(file, &rec, sizeof(rec));
-					// printk("Installed cert: %s\n%s\n", rec.cert_cn, dec_buf);
-					if (strlen(rec.cert_cn)){
-						printk("Installed cert: %s\n", rec.cert_cn);
+				//Write to store, indexed under the subject CN
+				struct tmo_cert_meta meta;
+				int num = tmo_cert_store_add(store, NULL, ca_cert, parse_cert_sz);
+				if (num == -EINVAL) {
+					printk("Cert parse failure.\n");
+				} else if (num < 0) {
+					printk("Cert store full or write failed.\n");
+				} else {
+					if (tmo_cert_store_meta(store, num, &meta) == 0 &&
+					    (meta.flags & TMO_CERT_META_CN)) {
+						printk("Installed cert: %s\n", meta.subject);
 					} else {
 						printk("Installed cert: %s\n", "<NO CN SPECIFIED>");
 					}
-					fs_write(file, ca_cert, parse_cert_sz);
 					success_cnt++;
-				} else {
-					printk("Cert parse failure.\n");
 				}
-				mbedtls_x509_crt_free(&ca_x509);
 				memset(dec_buf, 0, 3000);
 				buf_idx = 0;
 			} else if (pchr == '\n') {
@@ -247,37 +387,33 @@ static size_t http_total_received;
 
 int tmo_cert_dld(int devid, char *url) 
 {
-	tls_credential_delete(CA_CERTIFICATE_TAG, TLS_CREDENTIAL_CA_CERTIFICATE);
-	tls_credential_add(CA_CERTIFICATE_TAG, TLS_CREDENTIAL_CA_CERTIFICATE,
-			digicert_ca, sizeof(digicert_ca));
+	/* Certs are decoded into ca_cert, stop using it as the user CA */
+	tmo_tls_creds_set_user_ca(NULL, 0);
+	ca_cert_sz = 0;
 	int ret = -1;
-	struct fs_file_t file = {0};
+	struct tmo_cert_store store;
+	bool store_open = false;
 	struct fs_file_t tmp_file = {0};
 	struct fs_dirent dirent = {0};
 
 	http_total_received = 0;
 
 	// Assume fs is already mounted
-	char *filename = CERT_BIN_LOCATION;
-	printf("Opening file %s\n", filename);
+	printf("Opening cert store %s\n", TMO_CERT_STORE_PATH);
 
 	if (fs_stat(CERT_BIN_FOLDER, &dirent) == -ENOENT) {
 		fs_mkdir(CERT_BIN_FOLDER);
 	}
 
-	ret = fs_open(&file, filename, FS_O_CREATE | FS_O_WRITE);
-	if (ret != 0) {
-		printf("Error: could not open file %s\n", filename);
-		goto exit;
-	}
-
-	ret = fs_truncate(&file, 0);
+	ret = tmo_cert_store_open(&store, TMO_CERT_STORE_PATH, true);
 	if (ret != 0) {
-		printf("Could not truncate file %s\n", filename);
+		printf("Error: could not create cert store %s\n", TMO_CERT_STORE_PATH);
 		goto exit;
 	}
+	store_open = true;
 
-	http_total_received = tmo_http_download(devid, url, "/tmo/certs.tmp", NULL);
+	http_total_received = tmo_http_download(devid, url, "/tmo/certs.tmp", NULL,
+						 TMO_TLS_USE_CERTS);
 	
 	if (http_total_received <= 0) {
 		goto exit;
@@ -298,7 +434,7 @@ int tmo_cert_dld(int devid, char *url)
 	printf("\n");
 	do {
 		read = fs_read(&tmp_file, frag_buf, 64);
-		parse(&file, frag_buf, read);
+		parse(&store, frag_buf, read);
 	} while (read);
 
 	fs_close(&tmp_file);
@@ -306,7 +442,9 @@ int tmo_cert_dld(int devid, char *url)
 	
 	printf("Downloaded %d certs, installed %d sucessfully\n", cert_cnt, success_cnt);
 exit:
-	fs_close(&file);
+	if (store_open) {
+		tmo_cert_store_close(&store);
+	}
 	fs_close(&tmp_file);
 	if (ret < 0) {
 		return ret;
@@ -13,6 +13,9 @@ extern int ca_cert_idx;
 int cmd_tmo_cert_load(const struct shell *shell, size_t argc, char **argv);
 int cmd_tmo_cert_list(const struct shell *shell, size_t argc, char **argv);
 int cmd_tmo_cert_info(const struct shell *shell, size_t argc, char **argv);
+int cmd_tmo_cert_delete(const struct shell *shell, size_t argc, char **argv);
+int cmd_tmo_cert_compact(const struct shell *shell, size_t argc, char **argv);
+int cmd_tmo_cert_bench(const struct shell *shell, size_t argc, char **argv);
 int cmd_tmo_cert_dld(const struct shell *shell, size_t argc, char **argv);
 
 #endif
@@ -14,7 +14,6 @@ LOG_MODULE_REGISTER(tmo_dfu_download, LOG_LEVEL_DBG);
 #include <zephyr/net/tls_credentials.h>
 #include <zephyr/net/http/client.h>
 #include <zephyr/net/wifi_mgmt.h>
-#include <mbedtls/sha1.h>
 #include <zephyr/sys/base64.h>
 
 #include "ca_certificate.h"
@@ -23,6 +22,7 @@ LOG_MODULE_REGISTER(tmo_dfu_download, LOG_LEVEL_DBG);
 #include "dfu_rs9116w.h"
 #include "tmo_shell.h"
 #include "tmo_http_request.h"
+#include "tmo_digest.h"
 
 extern const struct dfu_file_t dfu_files_mcu[];
 extern const struct dfu_file_t dfu_files_modem[];
@@ -30,7 +30,6 @@ extern const struct dfu_file_t dfu_files_rs9116w[];
 
 extern uint8_t mxfer_buf[];
 
-mbedtls_sha1_context sha1_ctx;
 unsigned char sha1_output[20];
 
 struct fs_file_t file = {0};
@@ -69,63 +68,33 @@ int dfu_download(const struct dfu_file_t *dfu_file, enum dfu_tgts dfu_tgt)
 	printf("from url: %s\n", url);
 	printf("to file : %s\n", dfu_file->lfile);
 
-#if defined(CONFIG_NET_SOCKETS_SOCKOPT_TLS)
-	tls_credential_delete(CA_CERTIFICATE_TAG, TLS_CREDENTIAL_CA_CERTIFICATE);
-	if(strstr(base_url_s, "t-mobile.com")){
-		tls_credential_add(CA_CERTIFICATE_TAG, TLS_CREDENTIAL_CA_CERTIFICATE,
-				entrust_g2, sizeof(entrust_g2));
-	} else {
-		tls_credential_add(CA_CERTIFICATE_TAG, TLS_CREDENTIAL_CA_CERTIFICATE,
-				digicert_ca, sizeof(digicert_ca));
-	}
-#endif
 	if (strlen(dfu_auth_key)) {
-		ret = tmo_http_download(iface_s, url, dfu_file->lfile, dfu_auth_key);
+		ret = tmo_http_download(iface_s, url, dfu_file->lfile, dfu_auth_key,
+					TMO_TLS_USE_DFU);
 	} else {
-		ret = tmo_http_download(iface_s, url, dfu_file->lfile, NULL);
+		ret = tmo_http_download(iface_s, url, dfu_file->lfile, NULL, TMO_TLS_USE_DFU);
 	}
 	
 	if (ret < 0) {
 		return ret;
 	}
 
-	// mbedtls_sha1_init(&sha1_ctx);
-	memset(sha1_output, 0, sizeof(sha1_output));
-	mbedtls_sha1_starts(&sha1_ctx);
+	struct tmo_digest digest = {0};
+	int miscompareCnt = 0;
 
 	printf("\nChecking file %s\n", dfu_file->lfile);
-	if (fs_open(&file, dfu_file->lfile, FS_O_READ) != 0) {
+	ret = tmo_digest_file(dfu_file->lfile, TMO_DIGEST_SHA1, &digest);
+	if (ret == -ENOENT) {
 		LOG_ERR("Could not open file %s", dfu_file->lfile);
 		return -1;
+	} else if (ret) {
+		LOG_ERR("Could not read file %s", dfu_file->lfile);
+		return 0;
 	}
+	int totalbytes = digest.len;
 
-	int readbytes = 0;
-	int totalbytes = 0;
-	int notdone = 1;
-	int miscompareCnt = 0;
-	while (notdone)
-	{
-		readbytes = fs_read(&file, mxfer_buf, 4096);
-		if (readbytes < 0) {
-			LOG_ERR("Could not read file %s", dfu_file->lfile);
-			fs_close(&file);
-			return 0;
-		}
-		//printf("read %d\n", readbytes);
-		if (readbytes > 0) {
-			totalbytes += readbytes;
-			mbedtls_sha1_update(&sha1_ctx, (unsigned char *)mxfer_buf, readbytes);
-			//printf("r .. %d %d\n", (int)readbytes, totalbytes);
-			printk(".");
-		}
-		else {
-			notdone = 0;
-			//printf("done %d\n", readbytes);
-		}
-	}
 	printf("\ntotal bytes read %d\n", totalbytes);
-
-	mbedtls_sha1_finish(&sha1_ctx, sha1_output);
+	memcpy(sha1_output, digest.sha1, sizeof(sha1_output));
 
 	/*
 	   printf("\nInFlash  SHA1: ");
@@ -152,7 +121,6 @@ int dfu_download(const struct dfu_file_t *dfu_file, enum dfu_tgts dfu_tgt)
 			printf("\nSHA1 ERROR for %s\n", dfu_file->lfile);
 		}
 	}
-	fs_close(&file);
 
 	return totalbytes;
 }
@@ -184,7 +152,6 @@ void generate_mcu_filename(struct dfu_file_t *dfu_files_mcu, char *base, int slo
 
 int tmo_dfu_download(const struct shell *shell, enum dfu_tgts dfu_tgt, char *base, char *version)
 {
-	mbedtls_sha1_init(&sha1_ctx);
 	const struct dfu_file_t *dfu_files = NULL;
 	struct dfu_file_t dfu_files_mcu_gen[6];
 
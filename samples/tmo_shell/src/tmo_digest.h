@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TMO_DIGEST_H
+#define TMO_DIGEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/sys/util.h>
+#include <mbedtls/sha1.h>
+#include <mbedtls/sha256.h>
+
+#define TMO_DIGEST_SHA1	  BIT(0)
+#define TMO_DIGEST_SHA256 BIT(1)
+#define TMO_DIGEST_CRC32  BIT(2)
+/* Murata 1SC image CRC, see dfu_murata_1sc.h */
+#define TMO_DIGEST_MCRC32 BIT(3)
+
+#define TMO_DIGEST_SHA1_LEN   20
+#define TMO_DIGEST_SHA256_LEN 32
+
+struct tmo_digest {
+	/* Set before tmo_digest_start() */
+	uint32_t algs;
+	/* Leading bytes left out of the MCRC32 (the Murata update header) */
+	uint32_t mcrc_skip;
+
+	/* Results, valid after tmo_digest_finish() */
+	uint32_t len;
+	uint32_t crc32;
+	uint32_t mcrc32;
+	uint8_t sha1[TMO_DIGEST_SHA1_LEN];
+	uint8_t sha256[TMO_DIGEST_SHA256_LEN];
+
+	/* Hash state owned by the backend */
+	union {
+		mbedtls_sha1_context sha1;
+		void *priv;
+	} sha1_ctx;
+	union {
+		mbedtls_sha256_context sha256;
+		void *priv;
+	} sha256_ctx;
+};
+
+/**
+ * @brief Hash implementation
+ *
+ * A backend computes SHA1 and SHA-256 and may replace the CRC32. start,
+ * update and finish are required, crc32 may be NULL to keep the software
+ * CRC32.
+ */
+struct tmo_digest_backend {
+	const char *name;
+	int (*start)(struct tmo_digest *d);
+	int (*update)(struct tmo_digest *d, const uint8_t *buf, size_t len);
+	int (*finish)(struct tmo_digest *d);
+	uint32_t (*crc32)(uint32_t crc, const uint8_t *buf, size_t len);
+};
+
+/**
+ * @brief Installs a hash backend, NULL restores the software one
+ */
+void tmo_digest_set_backend(const struct tmo_digest_backend *backend);
+
+const char *tmo_digest_backend_name(void);
+
+/**
+ * @brief CRC32 (IEEE), a drop in for crc32_ieee_update()
+ */
+uint32_t tmo_digest_crc32(uint32_t crc, const uint8_t *buf, size_t len);
+
+int tmo_digest_start(struct tmo_digest *d, uint32_t algs);
+int tmo_digest_update(struct tmo_digest *d, const uint8_t *buf, size_t len);
+int tmo_digest_finish(struct tmo_digest *d);
+
+/**
+ * @brief Computes the digests selected in algs over a whole file in one pass
+ *
+ * @param path File to hash
+ * @param algs TMO_DIGEST_* flags
+ * @param d Digest state and results, mcrc_skip is honored
+ * @return int 0 or a negative errno
+ */
+int tmo_digest_file(const char *path, uint32_t algs, struct tmo_digest *d);
+
+#endif
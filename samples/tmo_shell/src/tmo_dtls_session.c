@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * DTLS session resumption and RFC 9146 connection ID for the shell DTLS
+ * sockets. With the session cache enabled, a socket reconnecting to a peer
+ * after PSM or eDRX sleep offers the earlier session instead of running a
+ * full handshake, and with a connection ID the peer keeps the session when
+ * the NAT binding or the device address changed.
+ *
+ * The socket API does not report whether the peer accepted a resumption, so
+ * handshakes are split by whether the socket took the session cache option
+ * and a session to the same peer could have been cached. Their durations are
+ * kept apart so the saving shows up in the histograms.
+ */
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/net/tls_credentials.h>
+
+#include "tmo_shell.h"
+#include "tmo_dtls_session.h"
+
+#define DTLS_SESSION_PEERS 4
+
+/* Options the driver accepted on each DTLS socket */
+struct dtls_sock {
+	int sd;
+	bool cache;
+	bool cid;
+};
+
+static struct tmo_dtls_stats dtls_stats;
+static struct sockaddr dtls_peers[DTLS_SESSION_PEERS];
+static int dtls_peer_next;
+static struct dtls_sock dtls_socks[MAX_SOCK_REC];
+static int dtls_sock_next;
+
+K_MUTEX_DEFINE(dtls_stats_lock);
+
+static bool peer_equal(const struct sockaddr *a, const struct sockaddr *b)
+{
+	if (a->sa_family != b->sa_family) {
+		return false;
+	}
+	if (a->sa_family == AF_INET) {
+		return net_sin(a)->sin_port == net_sin(b)->sin_port &&
+		       net_ipv4_addr_cmp(&net_sin(a)->sin_addr, &net_sin(b)->sin_addr);
+	}
+#if IS_ENABLED(CONFIG_NET_IPV6)
+	if (a->sa_family == AF_INET6) {
+		return net_sin6(a)->sin6_port == net_sin6(b)->sin6_port &&
+		       net_ipv6_addr_cmp(&net_sin6(a)->sin6_addr, &net_sin6(b)->sin6_addr);
+	}
+#endif
+	return false;
+}
+
+/* Must be called with dtls_stats_lock held */
+static bool peer_known(const struct sockaddr *peer)
+{
+	for (int i = 0; i < DTLS_SESSION_PEERS; i++) {
+		if (peer_equal(&dtls_peers[i], peer)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Must be called with dtls_stats_lock held */
+static struct dtls_sock *sock_find(int sd)
+{
+	for (int i = 0; i < MAX_SOCK_REC; i++) {
+		if (dtls_socks[i].sd == sd) {
+			return &dtls_socks[i];
+		}
+	}
+	return NULL;
+}
+
+void tmo_dtls_session_setup(const struct shell *shell, int sd)
+{
+	struct dtls_sock *ds;
+	bool unsupported = false;
+	bool cache = false;
+	bool cid = false;
+	int val;
+
+#if defined(CONFIG_TMO_DTLS_SESSION_CACHE) && defined(TLS_SESSION_CACHE)
+	val = TLS_SESSION_CACHE_ENABLED;
+	if (zsock_setsockopt(sd, SOL_TLS, TLS_SESSION_CACHE, &val, sizeof(val)) < 0) {
+		shell_warn(shell, "Session cache not supported on socket %d, errno = %d", sd,
+			   errno);
+		unsupported = true;
+	} else {
+		cache = true;
+	}
+#endif
+#if defined(CONFIG_TMO_DTLS_CID) && defined(TLS_DTLS_CID)
+	val = TLS_DTLS_CID_SUPPORTED;
+	if (zsock_setsockopt(sd, SOL_TLS, TLS_DTLS_CID, &val, sizeof(val)) < 0) {
+		shell_warn(shell, "Connection ID not supported on socket %d, errno = %d", sd,
+			   errno);
+		unsupported = true;
+	} else {
+		cid = true;
+	}
+#endif
+	ARG_UNUSED(val);
+
+	k_mutex_lock(&dtls_stats_lock, K_FOREVER);
+	/* A closed socket's descriptor may come back, so reuse its entry */
+	ds = sock_find(sd);
+	if (ds == NULL) {
+		ds = &dtls_socks[dtls_sock_next];
+		dtls_sock_next = (dtls_sock_next + 1) % MAX_SOCK_REC;
+	}
+	ds->sd = sd;
+	ds->cache = cache;
+	ds->cid = cid;
+	dtls_stats.sockets++;
+	dtls_stats.cache_on += cache;
+	dtls_stats.cid_on += cid;
+	dtls_stats.unsupported += unsupported;
+	k_mutex_unlock(&dtls_stats_lock);
+}
+
+void tmo_dtls_session_handshake(int sd, const struct sockaddr *peer, uint32_t ms, bool ok)
+{
+	struct dtls_sock *ds;
+	bool cid = false;
+
+#if defined(CONFIG_TMO_DTLS_CID) && defined(TLS_DTLS_CID_STATUS)
+	int status;
+	socklen_t len = sizeof(status);
+
+	if (ok && zsock_getsockopt(sd, SOL_TLS, TLS_DTLS_CID_STATUS, &status, &len) == 0) {
+		cid = status != TLS_DTLS_CID_STATUS_DISABLED;
+	}
+#endif
+
+	k_mutex_lock(&dtls_stats_lock, K_FOREVER);
+	ds = sock_find(sd);
+	if (!ok) {
+		dtls_stats.failed++;
+	} else if (ds && ds->cache && peer_known(peer)) {
+		dtls_stats.resumable++;
+		tmo_histogram_add(&dtls_stats.resumable_ms, ms);
+	} else {
+		dtls_stats.full++;
+		tmo_histogram_add(&dtls_stats.full_ms, ms);
+		memcpy(&dtls_peers[dtls_peer_next], peer, sizeof(*peer));
+		dtls_peer_next = (dtls_peer_next + 1) % DTLS_SESSION_PEERS;
+	}
+	if (cid) {
+		dtls_stats.cid++;
+	}
+	k_mutex_unlock(&dtls_stats_lock);
+}
+
+void tmo_dtls_session_get_stats(struct tmo_dtls_stats *st)
+{
+	k_mutex_lock(&dtls_stats_lock, K_FOREVER);
+	*st = dtls_stats;
+	k_mutex_unlock(&dtls_stats_lock);
+}
+
+void tmo_dtls_session_reset_stats(void)
+{
+	k_mutex_lock(&dtls_stats_lock, K_FOREVER);
+	dtls_stats.full = dtls_stats.resumable = dtls_stats.failed = 0;
+	dtls_stats.cid = dtls_stats.unsupported = 0;
+	dtls_stats.sockets = dtls_stats.cache_on = dtls_stats.cid_on = 0;
+	tmo_histogram_reset(&dtls_stats.full_ms);
+	tmo_histogram_reset(&dtls_stats.resumable_ms);
+	k_mutex_unlock(&dtls_stats_lock);
+}
+
+static void dtls_hist_print(const struct shell *shell, const char *name,
+			    const struct tmo_histogram *h)
+{
+	if (h->count == 0) {
+		return;
+	}
+	shell_print(shell, "%-10s %6u %8u %8u %8u %8u", name, h->count, h->min,
+		    tmo_histogram_avg(h), h->max, tmo_histogram_percentile(h, 95));
+}
+
+int cmd_dtls_stats(const struct shell *shell, size_t argc, char **argv)
+{
+	static struct tmo_dtls_stats st;
+
+	if (argc > 1 && !strcmp(argv[1], "reset")) {
+		tmo_dtls_session_reset_stats();
+		shell_print(shell, "DTLS handshake stats reset");
+		return 0;
+	} else if (argc > 1) {
+		shell_error(shell, "Unknown argument %s", argv[1]);
+		return -EINVAL;
+	}
+
+	tmo_dtls_session_get_stats(&st);
+	shell_print(shell, "session cache on %u of %u sockets%s, connection ID on %u%s",
+		    st.cache_on, st.sockets,
+		    IS_ENABLED(CONFIG_TMO_DTLS_SESSION_CACHE) ? "" : " (disabled)", st.cid_on,
+		    IS_ENABLED(CONFIG_TMO_DTLS_CID) ? "" : " (disabled)");
+	shell_print(shell, "handshakes: %u full, %u resumable, %u failed, %u with CID", st.full,
+		    st.resumable, st.failed, st.cid);
+	if (st.unsupported) {
+		shell_warn(shell, "%u sockets rejected the session cache or CID options",
+			   st.unsupported);
+	}
+	shell_print(shell, "%-10s %6s %8s %8s %8s %8s", "(ms)", "count", "min", "avg", "max",
+		    "p95");
+	dtls_hist_print(shell, "full", &st.full_ms);
+	dtls_hist_print(shell, "resumable", &st.resumable_ms);
+	return 0;
+}
+
+static int dtls_session_init(const struct device *unused)
+{
+	ARG_UNUSED(unused);
+	for (int i = 0; i < MAX_SOCK_REC; i++) {
+		dtls_socks[i].sd = -1;
+	}
+	tmo_histogram_reset(&dtls_stats.full_ms);
+	tmo_histogram_reset(&dtls_stats.resumable_ms);
+	return 0;
+}
+
+SYS_INIT(dtls_session_init, APPLICATION, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TMO_DTLS_SESSION_H
+#define TMO_DTLS_SESSION_H
+
+#include <stdint.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/shell/shell.h>
+
+#include "tmo_histogram.h"
+
+struct tmo_dtls_stats {
+	/* Handshakes with no earlier session to the same peer */
+	uint32_t full;
+	/* Handshakes that could offer a cached session to the peer */
+	uint32_t resumable;
+	uint32_t failed;
+	/* Handshakes that ended with a connection ID in use */
+	uint32_t cid;
+	/* Sockets whose driver rejected the session cache or CID options */
+	uint32_t unsupported;
+	/* DTLS sockets set up, and those that took each option */
+	uint32_t sockets;
+	uint32_t cache_on;
+	uint32_t cid_on;
+	struct tmo_histogram full_ms;
+	struct tmo_histogram resumable_ms;
+};
+
+/**
+ * @brief Enables the session cache and connection ID on a new DTLS socket
+ *
+ * @param shell Shell used to report options the socket does not support
+ * @param sd The socket descriptor
+ */
+void tmo_dtls_session_setup(const struct shell *shell, int sd);
+
+/**
+ * @brief Accounts for a DTLS handshake done by connect()
+ *
+ * @param sd The socket descriptor
+ * @param peer Address the socket connected to
+ * @param ms Duration of the connect() call
+ * @param ok Whether the handshake succeeded
+ */
+void tmo_dtls_session_handshake(int sd, const struct sockaddr *peer, uint32_t ms, bool ok);
+
+void tmo_dtls_session_get_stats(struct tmo_dtls_stats *st);
+
+void tmo_dtls_session_reset_stats(void);
+
+int cmd_dtls_stats(const struct shell *shell, size_t argc, char **argv);
+
+#endif
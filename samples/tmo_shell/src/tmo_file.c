@@ -5,26 +5,36 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <zephyr/fs/fs.h>
 #include <zephyr/shell/shell.h>
-#include <mbedtls/sha1.h>
-#include <zephyr/sys/crc.h>
+#include <zephyr/random/rand32.h>
 
 #include "tmo_file.h"
+#include "tmo_file_copy.h"
+#include "tmo_digest.h"
+#include "tmo_histogram.h"
+#include "tmo_shell.h"
 #include "dfu_murata_1sc.h"
 
 #define READ_SIZE 4096
 extern uint8_t mxfer_buf[];
-#define SHA_DIGEST_20   20
 
 int tmo_cp(const struct shell *shell, size_t argc, char **argv)
 {
-	int ret = 0;
+	struct tmo_file_xfer st;
 	struct fs_dirent entry_src;
+	bool verify = false;
+	int ret;
 
+	if (argc > 1 && strcmp(argv[1], "-v") == 0) {
+		verify = true;
+		argc--;
+		argv++;
+	}
 	if (argc != 3) {
-		shell_error(shell, "usage: tmo file cp <source file> <destination file>");
+		shell_error(shell, "usage: tmo file cp [-v] <source file> <destination file>");
 		return -EINVAL;
 	}
 
@@ -48,50 +58,15 @@ int tmo_cp(const struct shell *shell, size_t argc, char **argv)
 		return -EINVAL;
 	}
 
-	struct fs_file_t zfp_src;
-	fs_file_t_init(&zfp_src);
-	ret = fs_open(&zfp_src, src, FS_O_READ);
-	if (ret) {
-		shell_error(shell, "cannot open %s", src);
-		return ret;
-	}
-
-	struct fs_file_t zfp_dst;
-	fs_file_t_init(&zfp_dst);
-	ret = fs_open(&zfp_dst, dst, FS_O_CREATE | FS_O_WRITE);
-	if (ret) {
-		shell_error(shell, "cannot open %s", dst);
-		fs_close(&zfp_src);
-		return ret;
-	}
-
-	while (1) {
-		ret = fs_read(&zfp_src, mxfer_buf, READ_SIZE);
-		if (ret < 0) {
-			shell_error(shell, "error reading from %s", src);
-			goto end;
-		}
-
-		if (ret == 0) {
-			goto end;
-		}
-
-		int size = ret;
-		ret = fs_write(&zfp_dst, mxfer_buf, size);
-		if (ret < 0) {
-			shell_error(shell, "error writing to %s", dst);
-			goto end;
-		}
-
-		if (ret != size) {
-			shell_error(shell, "size mismatch");
-			ret = -ENOSPC;
-			goto end;
-		}
+	ret = tmo_file_copy(src, dst, verify, &st);
+	if (ret == -EIO && verify) {
+		shell_error(shell, "verify failed, %s does not match %s", dst, src);
+	} else if (ret) {
+		shell_error(shell, "copy failed, err = %d", ret);
 	}
-end:
-	fs_close(&zfp_src);
-	fs_close(&zfp_dst);
+	shell_print(shell, "%u bytes in %u ms (%u bytes/s)%s", st.bytes, st.elapsed_ms,
+		    st.elapsed_ms ? (uint32_t)((uint64_t)st.bytes * 1000 / st.elapsed_ms) : 0,
+		    (verify && ret == 0) ? ", verified" : "");
 	return ret;
 }
 
@@ -155,8 +130,20 @@ int tmo_mv(const struct shell *shell, size_t argc, char **argv)
 	return ret;
 }
 
+static void print_hex(const char *label, const uint8_t *buf, size_t len)
+{
+	printf("%s", label);
+	for (int i = 0; i < len; i++) {
+		printf(" %02x", buf[i]);
+	}
+	printf("\n");
+}
+
 int cmd_sha1(const struct shell *shell, size_t argc, char **argv)
 {
+	struct tmo_digest d = {.mcrc_skip = UA_HEADER_SIZE};
+	int ret;
+
 	if (argc < 2) {
 		shell_error(shell, "Missing required arguments");
 		shell_print(shell, "Usage: tmo sha1 <filename>\n");
@@ -165,70 +152,412 @@ int cmd_sha1(const struct shell *shell, size_t argc, char **argv)
 
 	char *filename = argv[1];
 
-	struct fs_file_t sha1file = {0};
-	int readbytes = 0;
-	int totalreadbytes = 0;
+	ret = tmo_digest_file(filename, TMO_DIGEST_SHA1 | TMO_DIGEST_CRC32 | TMO_DIGEST_MCRC32,
+			      &d);
+	if (ret == -ENOENT) {
+		shell_error(shell, "%s is missing", filename);
+		return -EINVAL;
+	} else if (ret) {
+		shell_error(shell, "Could not read file %s", filename);
+		return -1;
+	}
+	if (d.len < UA_HEADER_SIZE) {
+		shell_error(shell, "Error reading header, read %d bytes\n", d.len);
+		return -1;
+	}
 
-	mbedtls_sha1_context tmo_sha1_ctx;
-	unsigned char tmo_sha1_output[SHA_DIGEST_20];
+	shell_print(shell, "  Size: %d bytes", d.len);
+	shell_print(shell, " CRC32: %x", d.crc32);
+	shell_print(shell, "MCRC32: %x", d.mcrc32);
+	print_hex("  SHA1:", d.sha1, sizeof(d.sha1));
+	return 0;
+}
 
-	uint32_t crc32 = 0;
-	uint32_t mcrc32 = 0;
+static const struct {
+	const char *name;
+	uint32_t alg;
+} hash_algs[] = {
+	{"sha1", TMO_DIGEST_SHA1},
+	{"sha256", TMO_DIGEST_SHA256},
+	{"crc32", TMO_DIGEST_CRC32},
+	{"mcrc32", TMO_DIGEST_MCRC32},
+};
 
-	mbedtls_sha1_init(&tmo_sha1_ctx);
-	memset(tmo_sha1_output, 0, sizeof(tmo_sha1_output));
-	mbedtls_sha1_starts(&tmo_sha1_ctx);
+#define HASH_ALL	  (TMO_DIGEST_SHA1 | TMO_DIGEST_SHA256 | TMO_DIGEST_CRC32 | TMO_DIGEST_MCRC32)
+#define HASH_BENCH_RAM_KB 64
 
-	readbytes = 0;
-	totalreadbytes = 0;
+static int parse_algs(const char *list, uint32_t *algs)
+{
+	char buf[32];
+	char *tok, *save;
+
+	strncpy(buf, list, sizeof(buf) - 1);
+	buf[sizeof(buf) - 1] = '\0';
+	*algs = 0;
+	for (tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		int i;
+
+		for (i = 0; i < ARRAY_SIZE(hash_algs); i++) {
+			if (!strcmp(tok, hash_algs[i].name)) {
+				*algs |= hash_algs[i].alg;
+				break;
+			}
+		}
+		if (i == ARRAY_SIZE(hash_algs)) {
+			return -EINVAL;
+		}
+	}
+	return *algs ? 0 : -EINVAL;
+}
 
-	if (fs_open(&sha1file, filename, FS_O_READ) != 0) {
-		shell_error(shell, "%s is missing", filename);
-		return -EINVAL;
+static void hash_bench_row(const struct shell *shell, const char *name, uint32_t algs,
+			   const char *filename)
+{
+	struct tmo_digest d = {.mcrc_skip = UA_HEADER_SIZE};
+	uint32_t file_ms, ram_ms;
+	int64_t start;
+
+	/* Compute only, over the same 4 KB buffer again and again */
+	memset(mxfer_buf, 0xa5, READ_SIZE);
+	start = k_uptime_get();
+	tmo_digest_start(&d, algs);
+	for (int i = 0; i < HASH_BENCH_RAM_KB * 1024 / READ_SIZE; i++) {
+		tmo_digest_update(&d, mxfer_buf, READ_SIZE);
 	}
+	tmo_digest_finish(&d);
+	ram_ms = MAX(k_uptime_get() - start, 1);
 
-	fs_seek(&sha1file, 0, FS_SEEK_SET);
+	/* Flash reads included */
+	start = k_uptime_get();
+	if (tmo_digest_file(filename, algs, &d)) {
+		d.len = 0;
+	}
+	file_ms = MAX(k_uptime_get() - start, 1);
+
+	shell_print(shell, "%-8s %8u %8u %8u", name, HASH_BENCH_RAM_KB * 1000 / ram_ms, file_ms,
+		    (uint32_t)((uint64_t)d.len * 1000 / 1024 / file_ms));
+}
 
-	int notdone = 1;
-	while (notdone)
-	{
-		readbytes = fs_read(&sha1file, mxfer_buf, UA_HEADER_SIZE);
-		if (readbytes < 0) {
-			shell_error(shell, "Could not read file %s", filename);
-			fs_close(&sha1file);
-			return -1;
+int cmd_hash(const struct shell *shell, size_t argc, char **argv)
+{
+	struct tmo_digest d = {.mcrc_skip = UA_HEADER_SIZE};
+	uint32_t algs = HASH_ALL;
+	char *filename = NULL;
+	bool bench = false;
+	int ret;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--bench")) {
+			bench = true;
+		} else if (!strcmp(argv[i], "-a") && i + 1 < argc) {
+			if (parse_algs(argv[++i], &algs)) {
+				shell_error(shell, "Unknown algorithm in %s", argv[i]);
+				return -EINVAL;
+			}
+		} else {
+			filename = argv[i];
+		}
+	}
+	if (filename == NULL) {
+		shell_error(shell, "usage: tmo file hash [--bench] [-a sha1,sha256,crc32,mcrc32] "
+				   "<file>");
+		return -EINVAL;
+	}
+
+	if (bench) {
+		shell_print(shell, "backend %s, buffer %d bytes", tmo_digest_backend_name(),
+			    CONFIG_TMO_DIGEST_BUF_SIZE);
+		shell_print(shell, "%-8s %8s %8s %8s", "alg", "ram KB/s", "file ms", "KB/s");
+		for (int i = 0; i < ARRAY_SIZE(hash_algs); i++) {
+			if (algs & hash_algs[i].alg) {
+				hash_bench_row(shell, hash_algs[i].name, hash_algs[i].alg, filename);
+			}
 		}
-		if ((totalreadbytes == 0) && (readbytes != UA_HEADER_SIZE)) {
-			shell_error(shell, "Error reading header, read %d bytes\n", readbytes);
-			fs_close(&sha1file);
-			return -1;
+		hash_bench_row(shell, "one pass", algs, filename);
+		return 0;
+	}
+
+	ret = tmo_digest_file(filename, algs, &d);
+	if (ret) {
+		shell_error(shell, "cannot hash %s, err = %d", filename, ret);
+		return ret;
+	}
+	shell_print(shell, "  Size: %u bytes", d.len);
+	if (algs & TMO_DIGEST_CRC32) {
+		shell_print(shell, " CRC32: %08x", d.crc32);
+	}
+	if (algs & TMO_DIGEST_MCRC32) {
+		shell_print(shell, "MCRC32: %08x", d.mcrc32);
+	}
+	if (algs & TMO_DIGEST_SHA1) {
+		print_hex("  SHA1:", d.sha1, sizeof(d.sha1));
+	}
+	if (algs & TMO_DIGEST_SHA256) {
+		print_hex("SHA256:", d.sha256, sizeof(d.sha256));
+	}
+	return 0;
+}
+
+/*
+ * littlefs benchmark. Each workload times every file system call it makes,
+ * so the report shows per operation latency as well as throughput.
+ */
+#define BENCH_DEFAULT_DIR     "/tmo/bench"
+#define BENCH_DEFAULT_KB      64
+#define BENCH_RAND_READS      64
+#define BENCH_RAND_READ_SIZE  256
+#define BENCH_RECORDS	      128
+#define BENCH_RECORD_SIZE     32
+#define BENCH_SMALL_FILES     32
+#define BENCH_SMALL_FILE_SIZE 64
+
+struct bench_op {
+	const char *name;
+	uint32_t bytes;
+	uint32_t total_us;
+	struct tmo_histogram lat;
+};
+
+static inline uint32_t bench_start(void)
+{
+	return k_cycle_get_32();
+}
+
+static inline void bench_end(struct bench_op *op, uint32_t start, uint32_t bytes)
+{
+	uint32_t us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+
+	tmo_histogram_add(&op->lat, us);
+	op->total_us += us;
+	op->bytes += bytes;
+}
+
+static void bench_print(const struct shell *shell, const struct bench_op *op)
+{
+	const struct tmo_histogram *h = &op->lat;
+
+	if (h->count == 0) {
+		return;
+	}
+	shell_print(shell, "%-10s %5u %8u %7u %7u %7u %7u %7u", op->name, h->count,
+		    op->total_us / 1000,
+		    op->total_us ? (uint32_t)((uint64_t)op->bytes * 1000000 / 1024 / op->total_us)
+				 : 0,
+		    h->min, tmo_histogram_avg(h), tmo_histogram_percentile(h, 95), h->max);
+}
+
+static int bench_seq(const char *path, uint32_t size, struct bench_op *wr, struct bench_op *rd)
+{
+	struct fs_file_t file;
+	uint32_t t, done;
+	int ret;
+
+	fs_file_t_init(&file);
+	for (uint32_t i = 0; i < READ_SIZE; i++) {
+		mxfer_buf[i] = i;
+	}
+	ret = fs_open(&file, path, FS_O_CREATE | FS_O_RDWR);
+	if (ret) {
+		return ret;
+	}
+	fs_truncate(&file, 0);
+	for (done = 0; done < size && ret >= 0; done += READ_SIZE) {
+		t = bench_start();
+		ret = fs_write(&file, mxfer_buf, MIN(READ_SIZE, size - done));
+		bench_end(wr, t, MAX(ret, 0));
+	}
+	/* The data is not on flash until the file is synced */
+	t = bench_start();
+	fs_sync(&file);
+	bench_end(wr, t, 0);
+	if (ret < 0) {
+		goto end;
+	}
+
+	fs_seek(&file, 0, FS_SEEK_SET);
+	do {
+		t = bench_start();
+		ret = fs_read(&file, mxfer_buf, READ_SIZE);
+		bench_end(rd, t, MAX(ret, 0));
+	} while (ret > 0);
+end:
+	fs_close(&file);
+	return MIN(ret, 0);
+}
+
+static int bench_random(const char *path, uint32_t size, struct bench_op *op)
+{
+	struct fs_file_t file;
+	int ret;
+
+	fs_file_t_init(&file);
+	ret = fs_open(&file, path, FS_O_READ);
+	if (ret) {
+		return ret;
+	}
+	for (int i = 0; i < BENCH_RAND_READS && ret >= 0; i++) {
+		off_t off = sys_rand32_get() % (size - BENCH_RAND_READ_SIZE + 1);
+		uint32_t t = bench_start();
+
+		ret = fs_seek(&file, off, FS_SEEK_SET);
+		if (ret == 0) {
+			ret = fs_read(&file, mxfer_buf, BENCH_RAND_READ_SIZE);
 		}
+		bench_end(op, t, MAX(ret, 0));
+	}
+	fs_close(&file);
+	return MIN(ret, 0);
+}
+
+/* One sample for a whole file copy through the copy engine */
+static int bench_copy(const char *src, const char *dir, struct bench_op *op)
+{
+	struct tmo_file_xfer st;
+	char dst[64];
+	uint32_t t;
+	int ret;
+
+	snprintf(dst, sizeof(dst), "%s/copy", dir);
+	t = bench_start();
+	ret = tmo_file_copy(src, dst, false, &st);
+	bench_end(op, t, st.bytes);
+	fs_unlink(dst);
+	return ret;
+}
 
-		totalreadbytes += readbytes;
-		if (readbytes == 0) {
-			notdone = 0;
+/* Log style appends, each one synced the way a logger would */
+static int bench_append(const char *path, struct bench_op *op)
+{
+	struct fs_file_t file;
+	int ret = 0;
+
+	fs_unlink(path);
+	memset(mxfer_buf, 'r', BENCH_RECORD_SIZE);
+	for (int i = 0; i < BENCH_RECORDS && ret >= 0; i++) {
+		uint32_t t = bench_start();
+
+		fs_file_t_init(&file);
+		ret = fs_open(&file, path, FS_O_CREATE | FS_O_APPEND | FS_O_WRITE);
+		if (ret) {
+			break;
 		}
-		else {
-			mbedtls_sha1_update(&tmo_sha1_ctx, (unsigned char *)mxfer_buf, readbytes);
-			crc32 = crc32_ieee_update(crc32, mxfer_buf, readbytes);
-			if (totalreadbytes > UA_HEADER_SIZE)
-				mcrc32 = murata_1sc_crc32_update(mcrc32, mxfer_buf, readbytes);
+		ret = fs_write(&file, mxfer_buf, BENCH_RECORD_SIZE);
+		fs_close(&file);
+		bench_end(op, t, MAX(ret, 0));
+	}
+	fs_unlink(path);
+	return MIN(ret, 0);
+}
+
+static int bench_small_files(const char *dir, struct bench_op *create, struct bench_op *list,
+			     struct bench_op *del)
+{
+	char path[64];
+	struct fs_file_t file;
+	struct fs_dir_t zdp;
+	struct fs_dirent entry;
+	uint32_t t;
+	int ret = 0;
+
+	memset(mxfer_buf, 'f', BENCH_SMALL_FILE_SIZE);
+	for (int i = 0; i < BENCH_SMALL_FILES && ret >= 0; i++) {
+		snprintf(path, sizeof(path), "%s/f%03d", dir, i);
+		t = bench_start();
+		fs_file_t_init(&file);
+		ret = fs_open(&file, path, FS_O_CREATE | FS_O_WRITE);
+		if (ret) {
+			break;
 		}
+		ret = fs_write(&file, mxfer_buf, BENCH_SMALL_FILE_SIZE);
+		fs_close(&file);
+		bench_end(create, t, MAX(ret, 0));
 	}
 
-	mbedtls_sha1_finish(&tmo_sha1_ctx, tmo_sha1_output);
-	mcrc32 = murata_1sc_crc32_finish(mcrc32, totalreadbytes - UA_HEADER_SIZE);
+	/* One sample per full listing of the directory */
+	fs_dir_t_init(&zdp);
+	t = bench_start();
+	if (fs_opendir(&zdp, dir) == 0) {
+		while (fs_readdir(&zdp, &entry) == 0 && entry.name[0] != 0) {
+		}
+		fs_closedir(&zdp);
+	}
+	bench_end(list, t, 0);
 
-	shell_print(shell, "  Size: %d bytes", (uint32_t) totalreadbytes);
-	shell_print(shell, " CRC32: %x", crc32);
-	shell_print(shell, "MCRC32: %x", mcrc32);
+	for (int i = 0; i < BENCH_SMALL_FILES; i++) {
+		snprintf(path, sizeof(path), "%s/f%03d", dir, i);
+		t = bench_start();
+		if (fs_unlink(path) == 0) {
+			bench_end(del, t, 0);
+		}
+	}
+	return MIN(ret, 0);
+}
 
-	printf("  SHA1:");
-	for (int i = 0; i < SHA_DIGEST_20; i++) {
-		printf(" %02x", tmo_sha1_output[i]);
+int tmo_file_bench(const struct shell *shell, size_t argc, char **argv)
+{
+	static struct bench_op ops[] = {
+		{.name = "seq write"},	 {.name = "seq read"}, {.name = "rand read"},
+		{.name = "copy"},	 {.name = "append"},   {.name = "create"},
+		{.name = "list dir"}, {.name = "delete"},
+	};
+	const char *dir = BENCH_DEFAULT_DIR;
+	uint32_t kb = BENCH_DEFAULT_KB;
+	uint32_t size;
+	bool created;
+	char path[64];
+	int ret;
+
+	if (argc > 1) {
+		dir = argv[1];
+	}
+	if (argc > 2 && tmo_parse_uint(shell, argv[2], &kb)) {
+		return -EINVAL;
+	}
+	size = kb * 1024;
+	if (size < BENCH_RAND_READ_SIZE || size / 1024 != kb) {
+		shell_error(shell, "usage: tmo file bench [directory] [file size KB]");
+		return -EINVAL;
+	}
+	for (int i = 0; i < ARRAY_SIZE(ops); i++) {
+		ops[i].bytes = ops[i].total_us = 0;
+		tmo_histogram_reset(&ops[i].lat);
+	}
+	ret = fs_mkdir(dir);
+	if (ret && ret != -EEXIST) {
+		shell_error(shell, "cannot create %s, err = %d", dir, ret);
+		return ret;
+	}
+	/* Only a directory made here is removed again, never the user's own */
+	created = ret == 0;
+	shell_print(shell, "Benchmarking %s with a %u KB file", dir, size / 1024);
+
+	snprintf(path, sizeof(path), "%s/seq", dir);
+	ret = bench_seq(path, size, &ops[0], &ops[1]);
+	if (ret == 0) {
+		ret = bench_random(path, size, &ops[2]);
+	}
+	if (ret == 0) {
+		ret = bench_copy(path, dir, &ops[3]);
+	}
+	fs_unlink(path);
+	if (ret == 0) {
+		snprintf(path, sizeof(path), "%s/log", dir);
+		ret = bench_append(path, &ops[4]);
+	}
+	if (ret == 0) {
+		ret = bench_small_files(dir, &ops[5], &ops[6], &ops[7]);
+	}
+	if (created) {
+		fs_unlink(dir);
+	}
+	if (ret) {
+		shell_error(shell, "benchmark stopped, err = %d", ret);
 	}
-	printf("\n");
 
-	fs_close(&sha1file);
-	return 0;
+	shell_print(shell, "%-10s %5s %8s %7s %7s %7s %7s %7s", "op", "count", "total ms", "KB/s",
+		    "min us", "avg us", "p95 us", "max us");
+	for (int i = 0; i < ARRAY_SIZE(ops); i++) {
+		bench_print(shell, &ops[i]);
+	}
+	return ret;
 }
@@ -8,8 +8,10 @@
 #define TMO_FILE_H
 
 int tmo_cp(const struct shell *shell, size_t argc, char **argv);
+int tmo_file_bench(const struct shell *shell, size_t argc, char **argv);
 int tmo_ll(const struct shell *shell, size_t argc, char **argv);
 int tmo_mv(const struct shell *shell, size_t argc, char **argv);
 int cmd_sha1(const struct shell *shell, size_t argc, char **argv);
+int cmd_hash(const struct shell *shell, size_t argc, char **argv);
 
 #endif
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * File copy engine. A reader thread fills two buffers of its own in turn
+ * and the caller's thread drains them into a sink (a file or a socket), so
+ * flash reads overlap the writes. The buffers are a multiple of the
+ * littlefs cache size so every access covers whole cache lines. The CRC of
+ * the source is computed as it streams, letting a copy be verified by
+ * reading only the destination.
+ */
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fs.h>
+
+#include "tmo_file_copy.h"
+#include "tmo_digest.h"
+
+#define FILE_COPY_READER_STACK	  1536
+#define FILE_COPY_READER_PRIORITY CONFIG_MAIN_THREAD_PRIORITY
+
+#ifdef CONFIG_FS_LITTLEFS_CACHE_SIZE
+BUILD_ASSERT(CONFIG_TMO_FILE_COPY_BUF_SIZE % CONFIG_FS_LITTLEFS_CACHE_SIZE == 0,
+	     "copy buffers must be a multiple of the littlefs cache size");
+#endif
+
+/* Filled by the reader and handed to the sink through copy_full */
+struct copy_chunk {
+	int idx;
+	int len;
+};
+
+static uint8_t copy_bufs[2][CONFIG_TMO_FILE_COPY_BUF_SIZE] __aligned(4);
+K_MSGQ_DEFINE(copy_full, sizeof(struct copy_chunk), 2, 4);
+K_SEM_DEFINE(copy_free, 0, 2);
+K_THREAD_STACK_DEFINE(copy_reader_stack, FILE_COPY_READER_STACK);
+static struct k_thread copy_reader_thread;
+static atomic_t copy_abort;
+
+/* One stream at a time owns the buffers and the reader thread */
+K_MUTEX_DEFINE(copy_lock);
+
+static void copy_reader(void *p1, void *p2, void *p3)
+{
+	struct fs_file_t *file = p1;
+	struct copy_chunk chunk = {.idx = 0};
+
+	do {
+		k_sem_take(&copy_free, K_FOREVER);
+		if (atomic_get(&copy_abort)) {
+			break;
+		}
+		chunk.len = fs_read(file, copy_bufs[chunk.idx], sizeof(copy_bufs[0]));
+		k_msgq_put(&copy_full, &chunk, K_FOREVER);
+		chunk.idx ^= 1;
+	} while (chunk.len > 0);
+}
+
+int tmo_file_stream(const char *path, tmo_file_sink_t sink, void *ctx, struct tmo_file_xfer *st)
+{
+	struct fs_file_t file;
+	struct copy_chunk chunk;
+	int64_t start;
+	int ret = 0;
+
+	memset(st, 0, sizeof(*st));
+	fs_file_t_init(&file);
+	ret = fs_open(&file, path, FS_O_READ);
+	if (ret) {
+		return ret;
+	}
+
+	k_mutex_lock(&copy_lock, K_FOREVER);
+	atomic_set(&copy_abort, 0);
+	k_msgq_purge(&copy_full);
+	k_sem_reset(&copy_free);
+	k_sem_give(&copy_free);
+	k_sem_give(&copy_free);
+	start = k_uptime_get();
+	k_thread_create(&copy_reader_thread, copy_reader_stack,
+			K_THREAD_STACK_SIZEOF(copy_reader_stack), copy_reader, &file, NULL, NULL,
+			FILE_COPY_READER_PRIORITY, 0, K_NO_WAIT);
+
+	while (true) {
+		k_msgq_get(&copy_full, &chunk, K_FOREVER);
+		if (chunk.len <= 0) {
+			ret = chunk.len;
+			break;
+		}
+		st->crc32 = tmo_digest_crc32(st->crc32, copy_bufs[chunk.idx], chunk.len);
+		ret = sink(ctx, copy_bufs[chunk.idx], chunk.len);
+		if (ret < 0) {
+			/* Wake the reader so it sees the abort */
+			atomic_set(&copy_abort, 1);
+			k_sem_give(&copy_free);
+			break;
+		}
+		st->bytes += chunk.len;
+		k_sem_give(&copy_free);
+	}
+	k_thread_join(&copy_reader_thread, K_FOREVER);
+	st->elapsed_ms = k_uptime_get() - start;
+	k_mutex_unlock(&copy_lock);
+
+	fs_close(&file);
+	return MIN(ret, 0);
+}
+
+static int file_sink(void *ctx, const uint8_t *buf, size_t len)
+{
+	int ret = fs_write(ctx, buf, len);
+
+	return (ret >= 0 && ret != len) ? -ENOSPC : ret;
+}
+
+static int file_crc(const char *path, uint32_t *crc)
+{
+	struct fs_file_t file;
+	int ret;
+
+	fs_file_t_init(&file);
+	ret = fs_open(&file, path, FS_O_READ);
+	if (ret) {
+		return ret;
+	}
+	*crc = 0;
+	k_mutex_lock(&copy_lock, K_FOREVER);
+	while ((ret = fs_read(&file, copy_bufs[0], sizeof(copy_bufs[0]))) > 0) {
+		*crc = tmo_digest_crc32(*crc, copy_bufs[0], ret);
+	}
+	k_mutex_unlock(&copy_lock);
+	fs_close(&file);
+	return ret;
+}
+
+int tmo_file_copy(const char *src, const char *dst, bool verify, struct tmo_file_xfer *st)
+{
+	struct fs_file_t file;
+	uint32_t crc;
+	int ret;
+
+	memset(st, 0, sizeof(*st));
+	fs_file_t_init(&file);
+	ret = fs_open(&file, dst, FS_O_CREATE | FS_O_WRITE);
+	if (ret) {
+		return ret;
+	}
+	fs_truncate(&file, 0);
+	ret = tmo_file_stream(src, file_sink, &file, st);
+	fs_close(&file);
+	if (ret || !verify) {
+		return ret;
+	}
+
+	ret = file_crc(dst, &crc);
+	if (ret == 0 && crc != st->crc32) {
+		ret = -EIO;
+	}
+	return ret;
+}
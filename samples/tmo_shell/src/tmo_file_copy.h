@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TMO_FILE_COPY_H
+#define TMO_FILE_COPY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct tmo_file_xfer {
+	uint32_t bytes;
+	uint32_t elapsed_ms;
+	/* CRC32 (IEEE) of the data read from the source */
+	uint32_t crc32;
+};
+
+/**
+ * @brief Consumer of a file stream
+ *
+ * @return int Bytes consumed (all of len) or a negative errno to stop
+ */
+typedef int (*tmo_file_sink_t)(void *ctx, const uint8_t *buf, size_t len);
+
+/**
+ * @brief Streams a file to a sink
+ *
+ * The next buffer is read on a helper thread while the sink consumes the
+ * previous one.
+ *
+ * @param path File to read
+ * @param sink Called with every buffer read, in order
+ * @param ctx Passed to sink
+ * @param st Filled with the transfer size, time and CRC32, zeroed on early failure
+ * @return int 0 or a negative errno
+ */
+int tmo_file_stream(const char *path, tmo_file_sink_t sink, void *ctx, struct tmo_file_xfer *st);
+
+/**
+ * @brief Copies a file
+ *
+ * @param src Source file
+ * @param dst Destination file, created or truncated
+ * @param verify Read the destination back and compare its CRC32 with the
+ * one computed while copying
+ * @param st Filled with the transfer size, time and CRC32, zeroed on early failure
+ * @return int 0, -EIO on a verify mismatch or a negative errno
+ */
+int tmo_file_copy(const char *src, const char *dst, bool verify, struct tmo_file_xfer *st);
+
+#endif
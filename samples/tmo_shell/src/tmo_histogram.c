@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+
+#include "tmo_histogram.h"
+
+static int bucket_of(uint32_t val)
+{
+	int b = 0;
+
+	while (val) {
+		val >>= 1;
+		b++;
+	}
+	return b < TMO_HISTOGRAM_BUCKETS ? b : TMO_HISTOGRAM_BUCKETS - 1;
+}
+
+void tmo_histogram_reset(struct tmo_histogram *h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+void tmo_histogram_add(struct tmo_histogram *h, uint32_t val)
+{
+	if (h->count == 0 || val < h->min) {
+		h->min = val;
+	}
+	if (val > h->max) {
+		h->max = val;
+	}
+	h->count++;
+	h->sum += val;
+	h->buckets[bucket_of(val)]++;
+}
+
+uint32_t tmo_histogram_avg(const struct tmo_histogram *h)
+{
+	return h->count ? (uint32_t)(h->sum / h->count) : 0;
+}
+
+uint32_t tmo_histogram_percentile(const struct tmo_histogram *h, unsigned int pct)
+{
+	uint64_t target;
+	uint64_t seen = 0;
+
+	if (h->count == 0) {
+		return 0;
+	}
+	/* Rank of the sample at pct, rounded up */
+	target = ((uint64_t)h->count * pct + 99) / 100;
+	if (target == 0) {
+		return h->min;
+	}
+	for (int b = 0; b < TMO_HISTOGRAM_BUCKETS; b++) {
+		seen += h->buckets[b];
+		if (seen >= target) {
+			uint32_t upper = b == 0 ? 0 : (uint32_t)((1ULL << b) - 1);
+
+			if (b == TMO_HISTOGRAM_BUCKETS - 1 || upper > h->max) {
+				upper = h->max;
+			}
+			return upper < h->min ? h->min : upper;
+		}
+	}
+	return h->max;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TMO_HISTOGRAM_H
+#define TMO_HISTOGRAM_H
+
+#include <stdint.h>
+
+/* Bucket 0 holds 0, bucket i holds [2^(i-1), 2^i), the last one everything above */
+#define TMO_HISTOGRAM_BUCKETS 26
+
+struct tmo_histogram {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t sum;
+	uint32_t buckets[TMO_HISTOGRAM_BUCKETS];
+};
+
+void tmo_histogram_reset(struct tmo_histogram *h);
+
+void tmo_histogram_add(struct tmo_histogram *h, uint32_t val);
+
+uint32_t tmo_histogram_avg(const struct tmo_histogram *h);
+
+/**
+ * @brief Estimates a percentile from the buckets
+ *
+ * @param h The histogram
+ * @param pct Percentile, 0-100
+ * @return uint32_t Upper bound of the bucket holding the percentile, capped at
+ * the largest value recorded
+ */
+uint32_t tmo_histogram_percentile(const struct tmo_histogram *h, unsigned int pct);
+
+#endif
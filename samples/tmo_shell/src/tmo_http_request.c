@@ -20,6 +20,7 @@ LOG_MODULE_REGISTER(tmo_http_request, LOG_LEVEL_DBG);
 #include "tmo_web_demo.h"
 #include "tmo_shell.h"
 #include "tmo_certs.h"
+#include "tmo_tls_creds.h"
 
 #if CONFIG_MODEM
 #include <zephyr/drivers/modem/murata-1sc.h>
@@ -39,7 +40,7 @@ static const char* aws_session_file = "/tmo/aws_session.txt";
 static char* suffix = "aaaaaaaa";
 #endif
 
-/* Set the timeout for http requests to 10 minutes (in milliseconds) */
+/* Set the timeout for http downloads to 10 minutes (in milliseconds) */
 #define HTTP_CLIENT_REQ_TIMEOUT (10 * 60 * 1000)
 
 int get_endpoint()
@@ -74,14 +75,133 @@ int get_endpoint()
 	return rc;
 }
 
+/* Persistent connection used for JSON telemetry posts */
+static struct {
+	int sock;
+	int iface;
+	int port;
+	bool tls;
+	bool server_close;
+	/* Closed by another thread while a post was using it */
+	bool stale;
+	char host[64];
+} json_conn = {.sock = -1};
+
+/* Held by a post for as long as it uses json_conn */
+K_MUTEX_DEFINE(json_conn_lock);
+
+static bool json_keepalive = IS_ENABLED(CONFIG_TMO_HTTP_JSON_KEEPALIVE);
+static int json_keepalive_idle = CONFIG_TMO_HTTP_JSON_KEEPALIVE_IDLE_SECS;
+static struct tmo_http_json_stats json_stats;
+
+struct json_rsp_ctx {
+	int status;
+	tmo_http_json_gen_t gen;
+	void *arg;
+	int sock;
+	size_t sent;
+	/* The writer is flushing its last chunk, append the terminating one */
+	bool last;
+	bool terminated;
+};
+
+#define JSON_CHUNK_HDR	10 /* "%x\r\n" of a 32 bit length */
+#define JSON_CHUNK_LAST "\r\n0\r\n\r\n"
+
+/*
+ * A chunk is framed in place, size line in front of the writer's buffer and
+ * CRLF behind it, so it costs one send. On the offloaded modems every send
+ * is a round trip over the UART.
+ */
+static char json_frame[JSON_CHUNK_HDR + CONFIG_TMO_HTTP_JSON_CHUNK_SIZE +
+		       sizeof(JSON_CHUNK_LAST)];
+
+static int json_send_all(int sock, const char *data, size_t len)
+{
+	while (len) {
+		ssize_t ret = zsock_send(sock, data, len, 0);
+
+		if (ret < 0) {
+			return -errno;
+		}
+		data += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+/* Writer sink: each buffered chunk goes out as one HTTP/1.1 chunk */
+static int json_chunk_sink(void *user_data, const char *data, size_t len)
+{
+	struct json_rsp_ctx *ctx = user_data;
+	char *body = &json_frame[JSON_CHUNK_HDR];
+	char hdr[JSON_CHUNK_HDR + 1];
+	int hlen, tlen;
+	int ret;
+
+	/* The writer always flushes from the start of its buffer */
+	__ASSERT_NO_MSG(data == body);
+	hlen = snprintf(hdr, sizeof(hdr), "%x\r\n", (unsigned int)len);
+	memcpy(body - hlen, hdr, hlen);
+	if (ctx->last) {
+		tlen = strlen(JSON_CHUNK_LAST);
+		memcpy(body + len, JSON_CHUNK_LAST, tlen);
+		ctx->terminated = true;
+	} else {
+		tlen = 2;
+		memcpy(body + len, "\r\n", tlen);
+	}
+	ret = json_send_all(ctx->sock, body - hlen, hlen + len + tlen);
+	if (!ret) {
+		ctx->sent += len;
+	}
+	return ret;
+}
+
+static int json_stream_cb(int sock, struct http_request *req, void *user_data)
+{
+	struct json_rsp_ctx *ctx = user_data;
+	struct tmo_json_writer w;
+	int ret;
+
+	ctx->sock = sock;
+	ctx->sent = 0;
+	ctx->last = ctx->terminated = false;
+	tmo_json_init(&w, &json_frame[JSON_CHUNK_HDR], CONFIG_TMO_HTTP_JSON_CHUNK_SIZE,
+		      json_chunk_sink, ctx);
+	ret = ctx->gen(&w, ctx->arg);
+	if (ret < 0) {
+		return ret;
+	}
+	/* Whatever is still buffered goes out together with the last chunk */
+	ctx->last = true;
+	ret = tmo_json_finish(&w);
+	if (ret < 0) {
+		return ret;
+	}
+	if (!ctx->terminated) {
+		ret = json_send_all(sock, "0\r\n\r\n", 5);
+	}
+	return ret < 0 ? ret : (int)ctx->sent;
+}
+
 static void response_cb_json(struct http_response *rsp,
 		enum http_final_call final_data, void *user_data)
 {
+	struct json_rsp_ctx *ctx = user_data;
+
 	if (final_data == HTTP_DATA_FINAL) {
+		struct http_request *req = CONTAINER_OF(rsp, struct http_request,
+				internal.response);
+
 		LOG_INF("Response status code: %d, %s", rsp->http_status_code, rsp->http_status);
 		if (rsp->body_found) {
 			LOG_INF("Body length: %d, Body: %s", rsp->recv_buf_len, rsp->recv_buf);
 		}
+		if (!http_should_keep_alive(&req->internal.parser)) {
+			json_conn.server_close = true;
+		}
+		ctx->status = rsp->http_status_code;
 	}
 }
 
@@ -89,22 +209,130 @@ static void response_cb_json(struct http_response *rsp,
 #define HTTP_PREFIX  "http://"
 #define HTTPS_PREFIX "https://"
 
-void tmo_http_json()
+static void json_conn_close(void)
+{
+	if (json_conn.sock >= 0) {
+		zsock_close(json_conn.sock);
+		json_conn.sock = -1;
+	}
+	json_conn.server_close = false;
+	json_conn.stale = false;
+}
+
+void tmo_http_json_close(void)
+{
+	/* A post in progress closes the socket itself before the next one */
+	if (k_mutex_lock(&json_conn_lock, K_NO_WAIT) == 0) {
+		json_conn_close();
+		k_mutex_unlock(&json_conn_lock);
+	} else {
+		json_conn.stale = true;
+	}
+}
+
+static int json_conn_open(const char *host, int port, bool tls, int idx)
+{
+	int ret;
+	int sock;
+	char port_sz[10];
+	static struct zsock_addrinfo hints;
+	struct zsock_addrinfo *res;
+
+	ret = tmo_offload_init(idx);
+	if (ret != 0) {
+		printf("Could not init device, ret = %d\n", ret);
+		return ret;
+	}
+
+	snprintf(port_sz, sizeof(port_sz), "%d", port);
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	ret = zsock_getaddrinfo(host, port_sz, &hints, &res);
+	if (ret) {
+		printf("Failed to resolve host %s\n", host);
+		return -EHOSTUNREACH;
+	}
+
+	struct net_if *iface = net_if_get_by_index(idx);
+	if (iface == NULL) {
+		printf("Interface type %d not found", idx);
+		zsock_freeaddrinfo(res);
+		return -EINVAL;
+	}
+
+#if defined(CONFIG_NET_SOCKETS_SOCKOPT_TLS)
+	if (tls) {
+		sock = zsock_socket_ext(res->ai_family, res->ai_socktype, IPPROTO_TLS_1_2, iface);
+	} else
+#endif
+	{
+		sock = zsock_socket_ext(res->ai_family, res->ai_socktype, res->ai_protocol, iface);
+	}
+
+	if (sock < 0) {
+		printf("Error creating socket, error: %d, errno: %d\n", sock, errno);
+		zsock_freeaddrinfo(res);
+		return -errno;
+	}
+
+#if defined(CONFIG_NET_SOCKETS_SOCKOPT_TLS)
+	if (tls) {
+		tmo_tls_creds_set_ca_list(sock, TMO_TLS_USE_JSON, host);
+
+		zsock_setsockopt(sock, SOL_TLS, TLS_HOSTNAME,
+				host, strlen(host) + 1);
+	}
+#endif
+#if CONFIG_MODEM
+	int tls_verify_val = TLS_PEER_VERIFY_NONE;
+	zsock_setsockopt(sock, SOL_TLS, TLS_PEER_VERIFY, &tls_verify_val, sizeof(tls_verify_val));
+#endif
+	//Now connect the socket
+	ret = zsock_connect(sock, res->ai_addr, res->ai_addrlen);
+	zsock_freeaddrinfo(res);
+	if (ret < 0) {
+		printf("Error connecting socket, error: %d, errno: %d\n", ret, errno);
+		ret = -errno;
+		zsock_close(sock);
+		return ret;
+	}
+
+	json_conn.sock = sock;
+	json_conn.iface = idx;
+	json_conn.port = port;
+	json_conn.tls = tls;
+	json_conn.server_close = false;
+	strncpy(json_conn.host, host, sizeof(json_conn.host) - 1);
+	json_stats.connects++;
+	return 0;
+}
+
+static int json_post_locked(const char *payload, size_t len, enum tmo_http_payload_fmt fmt,
+		tmo_http_json_gen_t gen, void *arg)
 {
 	int ret;
 	struct http_request req;
 	struct http_parser_url u;
-	char port_sz[10];
+	struct json_rsp_ctx ctx = {0};
 	int tls = 0;
+	int64_t start = k_uptime_get();
 
 	get_endpoint();
-	char *json_payload = get_json_payload_pointer();
 
 	char *server_url = endpoint;
-	printf("server_url: %s\npayload:\n%s\n", server_url, json_payload);
+	if (gen) {
+		printf("server_url: %s\npayload: streamed JSON\n", server_url);
+	} else if (fmt == TMO_HTTP_FMT_CBOR) {
+		printf("server_url: %s\npayload: %d bytes CBOR\n", server_url, (int)len);
+	} else {
+		printf("server_url: %s\npayload:\n%.*s\n", server_url, (int)len, payload);
+	}
 
 	const char *json_request_header[] = {
-		"Content-Type: application/json\r\n",
+		fmt == TMO_HTTP_FMT_CBOR ? "Content-Type: application/cbor\r\n" :
+			"Content-Type: application/json\r\n",
+		json_keepalive ? "Connection: keep-alive\r\n" : "Connection: close\r\n",
+		gen ? "Transfer-Encoding: chunked\r\n" : NULL,
 		NULL
 	};
 
@@ -128,9 +356,8 @@ void tmo_http_json()
 		port = 80;
 	} else {
 		printf("Unsupported schema\n");
-		return;
+		return -EINVAL;
 	}
-	snprintf(port_sz, sizeof(port_sz), "%d", port);
 
 	char path[256], host[64];
 	memset(path, 0, 256);
@@ -146,90 +373,147 @@ void tmo_http_json()
 	req.url = path;
 	req.host = host;
 	req.protocol = "HTTP/1.1";
-	req.payload = json_payload;
-	req.payload_len = strlen(req.payload);
+	if (gen) {
+		req.payload_cb = json_stream_cb;
+		ctx.gen = gen;
+		ctx.arg = arg;
+	} else {
+		req.payload = payload;
+		req.payload_len = len;
+	}
 	req.header_fields = json_request_header;
 	req.response = response_cb_json;
 	req.recv_buf = recv_buf;
 	req.recv_buf_len = sizeof(recv_buf);
 
-	static struct zsock_addrinfo hints;
-	struct zsock_addrinfo *res;
+	int idx = get_json_iface_type();
 
-	ret = tmo_offload_init(get_json_iface_type());
-	if (ret != 0) {
-		printf("Could not init device, ret = %d\n", ret);
-		return;
+	/* Drop a connection made stale or to a different endpoint or interface */
+	if (json_conn.stale ||
+	    (json_conn.sock >= 0 && (json_conn.iface != idx || json_conn.port != port ||
+				     json_conn.tls != tls || strcmp(json_conn.host, host)))) {
+		json_conn_close();
 	}
 
-	hints.ai_family = AF_INET;
-	hints.ai_socktype = SOCK_STREAM;
-	ret = zsock_getaddrinfo(host, port_sz, &hints, &res);
-	if (ret) {
-		printf("Failed to resolve host %s\n", host);
-		return;
-	}
+	/* One retry on a fresh connection covers a server that closed an idle socket */
+	for (int attempt = 0; attempt < 2; attempt++) {
+		bool reused = json_conn.sock >= 0;
 
-	int idx = get_json_iface_type();
-	struct net_if *iface = net_if_get_by_index(idx);
-	if (iface == NULL) {
-		printf("Interface type %d not found", idx);
-		zsock_freeaddrinfo(res);
-		return;
-	}
+		if (!reused) {
+			ret = json_conn_open(host, port, tls, idx);
+			if (ret < 0) {
+				break;
+			}
+		}
 
-	int sock;
+		ctx.status = 0;
+		printf("Sending request%s...\n", reused ? " (keep-alive)" : "");
+		ret = http_client_req(json_conn.sock, &req,
+				CONFIG_TMO_HTTP_JSON_TIMEOUT_SECS * MSEC_PER_SEC, &ctx);
+		printf("http_client_req returned %d\n", ret);
 
-#if defined(CONFIG_NET_SOCKETS_SOCKOPT_TLS)
-	if (tls) {
-		
-		if (!ca_cert_sz) {
-			tls_credential_delete(CA_CERTIFICATE_TAG, TLS_CREDENTIAL_CA_CERTIFICATE);
-			tls_credential_add(CA_CERTIFICATE_TAG, TLS_CREDENTIAL_CA_CERTIFICATE,
-					entrust_g2, sizeof(entrust_g2));
+		if (ret >= 0 && ctx.status != 0) {
+			ret = ctx.status;
+			if (json_conn.server_close || !json_keepalive) {
+				json_conn_close();
+			}
+			break;
 		}
 
-		sock = zsock_socket_ext(res->ai_family, res->ai_socktype, IPPROTO_TLS_1_2, iface);
-	} else
-#endif
-	{
-		sock = zsock_socket_ext(res->ai_family, res->ai_socktype, res->ai_protocol, iface);
+		json_conn_close();
+		if (ret >= 0) {
+			ret = -EIO;
+		}
+		if (!reused) {
+			break;
+		}
+		json_stats.reconnects++;
 	}
 
-	if (sock < 0) {
-		printf("Error creating socket, error: %d, errno: %d\n", sock, errno);
-		zsock_freeaddrinfo(res);
-		return;
+	uint32_t elapsed = (uint32_t)(k_uptime_get() - start);
+
+	if (gen) {
+		len = ctx.sent;
 	}
+	if (ret < 0) {
+		json_stats.failures++;
+	} else {
+		json_stats.posts++;
+		json_stats.bytes += len;
+		json_stats.last_ms = elapsed;
+		json_stats.total_ms += elapsed;
+		json_stats.max_ms = MAX(json_stats.max_ms, elapsed);
+		if (json_stats.min_ms == 0 || elapsed < json_stats.min_ms) {
+			json_stats.min_ms = elapsed;
+		}
+	}
+	return ret;
+}
 
-#if defined(CONFIG_NET_SOCKETS_SOCKOPT_TLS)
-	if (tls) {
-		sec_tag_t sec_tag_opt[] = {
-			CA_CERTIFICATE_TAG,
-		};
-		zsock_setsockopt(sock, SOL_TLS, TLS_SEC_TAG_LIST,
-				sec_tag_opt, sizeof(sec_tag_opt));
+static int json_post(const char *payload, size_t len, enum tmo_http_payload_fmt fmt,
+		tmo_http_json_gen_t gen, void *arg)
+{
+	int ret;
 
-		zsock_setsockopt(sock, SOL_TLS, TLS_HOSTNAME,
-				host, strlen(host) + 1);
+	k_mutex_lock(&json_conn_lock, K_FOREVER);
+	ret = json_post_locked(payload, len, fmt, gen, arg);
+	k_mutex_unlock(&json_conn_lock);
+	return ret;
+}
+
+int tmo_http_json_post(const char *payload, size_t len, enum tmo_http_payload_fmt fmt)
+{
+	return json_post(payload, len, fmt, NULL, NULL);
+}
+
+int tmo_http_json_post_stream(tmo_http_json_gen_t gen, void *arg)
+{
+	return json_post(NULL, 0, TMO_HTTP_FMT_JSON, gen, arg);
+}
+
+int tmo_http_json(void)
+{
+	char *json_payload = get_json_payload_pointer();
+
+	return tmo_http_json_post(json_payload, strlen(json_payload), TMO_HTTP_FMT_JSON);
+}
+
+void tmo_http_json_sleep_hint(int secs)
+{
+	if (json_conn.sock >= 0 && secs > json_keepalive_idle) {
+		/* Don't hold a TLS session open across an interval the modem may sleep in */
+		tmo_http_json_close();
 	}
-#endif
-#if CONFIG_MODEM
-	int tls_verify_val = TLS_PEER_VERIFY_NONE;
-	zsock_setsockopt(sock, SOL_TLS, TLS_PEER_VERIFY, &tls_verify_val, sizeof(tls_verify_val));
-#endif
-	//Now connect the socket
-	ret = zsock_connect(sock, res->ai_addr, res->ai_addrlen);
+}
 
-	if (ret < 0) {
-		printf("Error connecting socket, error: %d, errno: %d\n", ret, errno);
-	} else {
-		printf("Sending request...\n");
-		ret = http_client_req(sock, &req, HTTP_CLIENT_REQ_TIMEOUT, NULL);
-		printf("http_client_req returned %d\n", ret);
+void tmo_http_json_set_keepalive(bool enable, int idle_secs)
+{
+	json_keepalive = enable;
+	if (idle_secs >= 0) {
+		json_keepalive_idle = idle_secs;
 	}
-	zsock_freeaddrinfo(res);
-	zsock_close(sock);
+	if (!enable) {
+		tmo_http_json_close();
+	}
+}
+
+bool tmo_http_json_get_keepalive(int *idle_secs)
+{
+	if (idle_secs) {
+		*idle_secs = json_keepalive_idle;
+	}
+	return json_keepalive;
+}
+
+void tmo_http_json_get_stats(struct tmo_http_json_stats *stats)
+{
+	memcpy(stats, &json_stats, sizeof(json_stats));
+	stats->connected = json_conn.sock >= 0;
+}
+
+void tmo_http_json_reset_stats(void)
+{
+	memset(&json_stats, 0, sizeof(json_stats));
 }
 
 static int http_total_received = 0;
@@ -267,7 +551,8 @@ static void response_cb_download(struct http_response *rsp,
 extern uint8_t mxfer_buf[];
 
 #ifndef CONFIG_TMO_HTTP_MOCK_SOCKET
-int create_http_socket(bool tls, char* host, struct addrinfo *res, struct net_if *iface)
+int create_http_socket(bool tls, char* host, struct addrinfo *res, struct net_if *iface,
+		       enum tmo_tls_use use)
 {
 	int sock = -1;
 	if (!tls) {
@@ -287,11 +572,7 @@ int create_http_socket(bool tls, char* host, struct addrinfo *res, struct net_if
 		if (sock < 0) {
 			return sock;
 		}
-		sec_tag_t sec_tag_opt[] = {
-			CA_CERTIFICATE_TAG,
-		};
-		zsock_setsockopt(sock, SOL_TLS, TLS_SEC_TAG_LIST,
-				sec_tag_opt, sizeof(sec_tag_opt));
+		tmo_tls_creds_set_ca_list(sock, use, host);
 
 		zsock_setsockopt(sock, SOL_TLS, TLS_HOSTNAME,
 				host, strlen(host) + 1);
@@ -307,7 +588,8 @@ int create_http_socket(bool tls, char* host, struct addrinfo *res, struct net_if
 }
 #else
 extern int http_fail_unit_test_socket_create(void);
-int create_http_socket(bool tls, char* host, struct addrinfo *res, struct net_if *iface)
+int create_http_socket(bool tls, char* host, struct addrinfo *res, struct net_if *iface,
+		       enum tmo_tls_use use)
 {
 	LOG_WRN("Using mocked socket for download.");
 	int sock = -1;
@@ -317,7 +599,8 @@ int create_http_socket(bool tls, char* host, struct addrinfo *res, struct net_if
 #endif
 
 
-int tmo_http_download(int devid, char url[], char filename[], char *auth_key)
+int tmo_http_download(int devid, char url[], char filename[], char *auth_key,
+		      enum tmo_tls_use use)
 {
 	static struct addrinfo hints;
 	struct addrinfo *res = NULL;
@@ -406,7 +689,7 @@ int tmo_http_download(int devid, char url[], char filename[], char *auth_key)
 		return -EINVAL;
 	}
 
-	sock = create_http_socket(tls, host, res, iface);
+	sock = create_http_socket(tls, host, res, iface, use);
 	if (sock < 0) {
 		printf("Error creating socket, ret = %d, errno = %d", sock, errno);
 		goto exit;
@@ -426,7 +709,7 @@ int tmo_http_download(int devid, char url[], char filename[], char *auth_key)
 		ret = zsock_connect(sock, res->ai_addr, res->ai_addrlen);
 		if (ret == -1) {
 			zsock_close(sock);
-			sock = create_http_socket(tls, host, res, iface);
+			sock = create_http_socket(tls, host, res, iface, use);
 			profile = 255;
 			zsock_setsockopt(sock, SOL_TLS, TLS_MURATA_USE_PROFILE, &profile, sizeof(profile));
 			ret = zsock_connect(sock, res->ai_addr, res->ai_addrlen);
@@ -472,7 +755,7 @@ int tmo_http_download(int devid, char url[], char filename[], char *auth_key)
 			fail_count++;
 			printf("\nTransfer failure detected, reinitializing transfer... (%d/5) (%d < %d)\n", fail_count, http_total_received, http_content_length);
 			zsock_close(sock);
-			sock = create_http_socket(tls, host, res, iface);
+			sock = create_http_socket(tls, host, res, iface, use);
 			if (user_trust)
 				zsock_setsockopt(sock, SOL_TLS, TLS_MURATA_USE_PROFILE, &profile, sizeof(profile));
 			errno = 0;
@@ -505,7 +788,7 @@ int tmo_http_download(int devid, char url[], char filename[], char *auth_key)
 			fail_count++;
 			printf("\nTransfer failure detected, reinitializing transfer... (%d/5) (%d < %d)\n", fail_count, http_total_received, http_content_length);
 			zsock_close(sock);
-			sock = create_http_socket(tls, host, res, iface);
+			sock = create_http_socket(tls, host, res, iface, use);
 			if (user_trust)
 				zsock_setsockopt(sock, SOL_TLS, TLS_MURATA_USE_PROFILE, &profile, sizeof(profile));
 			errno = 0;
@@ -7,7 +7,94 @@
 #ifndef TMO_HTTP_REQUEST_H
 #define TMO_HTTP_REQUEST_H
 
-void tmo_http_json();
-int tmo_http_download(int devid, char url[], const char filename[], char *auth_key);
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tmo_json_writer.h"
+#include "tmo_tls_creds.h"
+
+enum tmo_http_payload_fmt {
+	TMO_HTTP_FMT_JSON,
+	TMO_HTTP_FMT_CBOR,
+};
+
+struct tmo_http_json_stats {
+	uint32_t posts;
+	uint32_t failures;
+	uint32_t connects;
+	uint32_t reconnects;
+	uint32_t bytes;
+	uint32_t last_ms;
+	uint32_t min_ms;
+	uint32_t max_ms;
+	uint64_t total_ms;
+	bool connected;
+};
+
+/**
+ * @brief Posts the current JSON payload to the configured endpoint
+ *
+ * @return int HTTP status code on success, -err on failure
+ */
+int tmo_http_json(void);
+
+/**
+ * @brief Posts a payload to the configured JSON endpoint, reusing the
+ * keep-alive connection when one is open
+ *
+ * @param payload The payload to post
+ * @param len The payload length
+ * @param fmt Payload encoding, selects the Content-Type header
+ * @return int HTTP status code on success, -err on failure
+ */
+int tmo_http_json_post(const char *payload, size_t len, enum tmo_http_payload_fmt fmt);
+
+/**
+ * @brief Writes a JSON document for a streamed post. Called again if the post
+ * is retried, so it must not consume its input.
+ *
+ * @return int 0 on success, -err to abort the post
+ */
+typedef int (*tmo_http_json_gen_t)(struct tmo_json_writer *w, void *arg);
+
+/**
+ * @brief Posts a JSON document to the configured endpoint using chunked
+ * transfer encoding, so the payload is never held in memory in full
+ *
+ * @param gen Writes the document
+ * @param arg Passed to gen
+ * @return int HTTP status code on success, -err on failure
+ */
+int tmo_http_json_post_stream(tmo_http_json_gen_t gen, void *arg);
+
+/**
+ * @brief Closes the keep-alive connection, if open
+ *
+ * Safe to call from any thread. If a post is using the connection, it is
+ * closed by the posting thread before its next request instead.
+ */
+void tmo_http_json_close(void);
+
+/**
+ * @brief Tells the JSON client how long until the next post, so the connection
+ * can be dropped before the modem sleeps
+ *
+ * @param secs Seconds until the next post
+ */
+void tmo_http_json_sleep_hint(int secs);
+
+void tmo_http_json_set_keepalive(bool enable, int idle_secs);
+bool tmo_http_json_get_keepalive(int *idle_secs);
+void tmo_http_json_get_stats(struct tmo_http_json_stats *stats);
+void tmo_http_json_reset_stats(void);
+
+/**
+ * @brief Download a URL to a file, or print it
+ *
+ * @param use What the download is for, picks the CAs an https server must chain to
+ */
+int tmo_http_download(int devid, char url[], const char filename[], char *auth_key,
+		      enum tmo_tls_use use);
 
 #endif
@@ -0,0 +1,540 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * iperf style throughput test. A client streams TCP or paced UDP traffic for
+ * a duration or a byte count, a server sinks it; both print interval and
+ * total throughput. UDP datagrams carry an iperf2 style sequence/timestamp
+ * header so the server can count lost and out of order datagrams.
+ *
+ * With -L the client and a server thread run against each other over the
+ * native stack's loopback interface, which validates the tool without a
+ * network.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/posix/unistd.h>
+#include <getopt.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "tmo_shell.h"
+#include "tmo_iperf.h"
+
+#define IPERF_DEFAULT_PORT	5001
+#define IPERF_DEFAULT_SECS	10
+#define IPERF_DEFAULT_RATE_KBPS 1000
+#define IPERF_UDP_FIN_CNT	3
+#define IPERF_UDP_IDLE_MS	3000
+
+struct iperf_cfg {
+	const struct shell *shell;
+	bool server;
+	bool udp;
+	bool loopback;
+	int iface;
+	const char *host;
+	uint16_t port;
+	uint32_t secs;
+	uint32_t bytes;
+	uint32_t interval_ms;
+	uint16_t len;
+	uint32_t rate_kbps;
+	/* Loopback server: listening and accepted socket, closed if it is aborted */
+	int *socks;
+};
+
+struct iperf_udp_hdr {
+	/* Network order, negative marks the end of the test */
+	int32_t seq;
+	uint32_t sec;
+	uint32_t usec;
+};
+
+struct iperf_report {
+	const char *role;
+	int64_t start;
+	int64_t last;
+	uint32_t last_bytes;
+	uint32_t total;
+	uint32_t pkts;
+	uint32_t errors;
+	uint32_t retries;
+	uint32_t lost;
+	uint32_t ooo;
+	int32_t next_seq;
+	/* Thread execution cycles when the run started */
+	uint64_t cycles;
+};
+
+static uint8_t iperf_buf[CONFIG_TMO_IPERF_BUF_SIZE];
+#if defined(CONFIG_NET_LOOPBACK)
+/* The loopback server receives on its own thread while the client fills iperf_buf */
+static uint8_t iperf_rx_buf[CONFIG_TMO_IPERF_BUF_SIZE];
+#endif
+
+static inline void print_usage(const struct shell *shell)
+{
+	shell_print(shell,
+		    "usage: iperf [-s] [-u] [-t secs] [-n bytes] [-i interval_ms] [-l len]\n"
+		    "             [-b kbit/s] [-p port] iface [host]\n"
+		    "       iperf -L [-u] [options]  (loopback client and server)");
+}
+
+static uint32_t kbps(uint32_t bytes, int64_t ms)
+{
+	return ms > 0 ? (uint32_t)(((uint64_t)bytes * 8) / ms) : 0;
+}
+
+static uint64_t thread_cycles(void)
+{
+#if defined(CONFIG_THREAD_RUNTIME_STATS)
+	k_thread_runtime_stats_t rt;
+
+	if (k_thread_runtime_stats_get(k_current_get(), &rt) == 0) {
+		return rt.execution_cycles;
+	}
+#endif
+	return 0;
+}
+
+static void report_interval(const struct shell *shell, struct iperf_report *r, int64_t now)
+{
+	uint32_t bytes = r->total - r->last_bytes;
+
+	shell_print(shell, "[%s] %5lld.%03lld-%5lld.%03lld s  %9u bytes  %7u kbit/s", r->role,
+		    (r->last - r->start) / 1000, (r->last - r->start) % 1000,
+		    (now - r->start) / 1000, (now - r->start) % 1000, bytes,
+		    kbps(bytes, now - r->last));
+	r->last = now;
+	r->last_bytes = r->total;
+}
+
+static void report_total(const struct iperf_cfg *cfg, struct iperf_report *r, int64_t now)
+{
+	const struct shell *shell = cfg->shell;
+
+	shell_print(shell, "[%s] total %u bytes in %lld ms, %u kbit/s", r->role, r->total,
+		    now - r->start, kbps(r->total, now - r->start));
+	if (cfg->udp) {
+		shell_print(shell, "[%s] datagrams %u, lost %u, out of order %u", r->role, r->pkts,
+			    r->lost, r->ooo);
+	}
+	shell_print(shell, "[%s] errors %u, retries %u", r->role, r->errors, r->retries);
+#if defined(CONFIG_THREAD_RUNTIME_STATS)
+	shell_print(shell, "[%s] cpu %u ms", r->role,
+		    (uint32_t)k_cyc_to_ms_floor64(thread_cycles() - r->cycles));
+#endif
+}
+
+static int iperf_socket(const struct iperf_cfg *cfg)
+{
+	int type = cfg->udp ? SOCK_DGRAM : SOCK_STREAM;
+	int proto = cfg->udp ? IPPROTO_UDP : IPPROTO_TCP;
+	struct net_if *iface;
+
+	if (cfg->loopback) {
+		return zsock_socket(AF_INET, type, proto);
+	}
+	iface = net_if_get_by_index(cfg->iface);
+	if (iface == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	return zsock_socket_ext(AF_INET, type, proto, iface);
+}
+
+static int iperf_resolve(const struct iperf_cfg *cfg, struct sockaddr *addr)
+{
+	struct zsock_addrinfo hints = {0};
+	struct zsock_addrinfo *res;
+
+	if (cfg->host == NULL) {
+		memset(addr, 0, sizeof(*addr));
+		addr->sa_family = AF_INET;
+	} else if (!net_ipaddr_parse(cfg->host, strlen(cfg->host), addr)) {
+		if (!cfg->loopback && tmo_offload_init(cfg->iface)) {
+			return -EINVAL;
+		}
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = cfg->udp ? SOCK_DGRAM : SOCK_STREAM;
+		if (zsock_getaddrinfo(cfg->host, NULL, &hints, &res)) {
+			return -EHOSTUNREACH;
+		}
+		memcpy(addr, res->ai_addr, sizeof(struct sockaddr_in));
+		zsock_freeaddrinfo(res);
+	}
+	net_sin(addr)->sin_port = htons(cfg->port);
+	return 0;
+}
+
+static bool client_done(const struct iperf_cfg *cfg, const struct iperf_report *r, int64_t now)
+{
+	if (cfg->bytes) {
+		return r->total >= cfg->bytes;
+	}
+	return now - r->start >= (int64_t)cfg->secs * MSEC_PER_SEC;
+}
+
+static int run_client(const struct iperf_cfg *cfg)
+{
+	const struct shell *shell = cfg->shell;
+	struct iperf_report r = {.role = "client"};
+	struct iperf_udp_hdr *hdr = (struct iperf_udp_hdr *)iperf_buf;
+	struct sockaddr addr;
+	/* Microseconds between datagrams at the requested rate */
+	uint32_t gap_us = cfg->udp ?
+		(uint32_t)((uint64_t)cfg->len * 8 * 1000 / cfg->rate_kbps) : 0;
+	int64_t next_us = 0;
+	int sd;
+	int ret;
+
+	ret = iperf_resolve(cfg, &addr);
+	if (ret) {
+		shell_error(shell, "Cannot resolve %s", cfg->host);
+		return ret;
+	}
+	sd = iperf_socket(cfg);
+	if (sd < 0) {
+		shell_error(shell, "Socket creation failed, errno = %d", errno);
+		return -errno;
+	}
+	if (zsock_connect(sd, &addr, sizeof(struct sockaddr_in)) < 0) {
+		shell_error(shell, "Connection failed, errno = %d", errno);
+		zsock_close(sd);
+		return -errno;
+	}
+
+	gen_payload(iperf_buf, cfg->len);
+	shell_print(shell, "[client] %s to %s port %u, %u byte writes", cfg->udp ? "UDP" : "TCP",
+		    cfg->host, cfg->port, cfg->len);
+	r.start = r.last = k_uptime_get();
+	r.cycles = thread_cycles();
+
+	while (1) {
+		int64_t now = k_uptime_get();
+		size_t len = cfg->len;
+
+		if (client_done(cfg, &r, now)) {
+			break;
+		}
+		if (cfg->bytes) {
+			len = MIN(len, cfg->bytes - r.total);
+		}
+		if (cfg->udp) {
+			int64_t now_us = k_ticks_to_us_floor64(k_uptime_ticks());
+
+			if (next_us > now_us) {
+				k_usleep(next_us - now_us);
+				now_us = next_us;
+			}
+			next_us = (next_us ? next_us : now_us) + gap_us;
+			hdr->seq = htonl(r.pkts);
+			hdr->sec = htonl(now_us / USEC_PER_SEC);
+			hdr->usec = htonl(now_us % USEC_PER_SEC);
+			len = MAX(len, sizeof(*hdr));
+		}
+		ret = zsock_send(sd, iperf_buf, len, 0);
+		if (ret < 0) {
+			if (errno == EAGAIN || errno == ENOBUFS) {
+				r.retries++;
+				k_yield();
+				continue;
+			}
+			r.errors++;
+			shell_error(shell, "send failed, errno = %d", errno);
+			break;
+		}
+		if (ret < len) {
+			/* A short stream write is counted, the payload is synthetic */
+			r.retries++;
+		}
+		r.total += ret;
+		r.pkts++;
+		now = k_uptime_get();
+		if (cfg->interval_ms && now - r.last >= cfg->interval_ms) {
+			report_interval(shell, &r, now);
+		}
+	}
+
+	if (cfg->udp) {
+		for (int i = 0; i < IPERF_UDP_FIN_CNT; i++) {
+			hdr->seq = htonl(-(int32_t)r.pkts - 1);
+			zsock_send(sd, iperf_buf, sizeof(*hdr), 0);
+		}
+	}
+	report_total(cfg, &r, k_uptime_get());
+	zsock_close(sd);
+	return r.errors ? -EIO : 0;
+}
+
+static void udp_account(struct iperf_report *r, const struct iperf_udp_hdr *hdr)
+{
+	int32_t seq = ntohl(hdr->seq);
+
+	if (seq < 0) {
+		return;
+	}
+	if (seq > r->next_seq) {
+		r->lost += seq - r->next_seq;
+		r->next_seq = seq + 1;
+	} else if (seq < r->next_seq) {
+		/* Counted as lost when its gap was seen, it arrived late instead */
+		r->ooo++;
+		if (r->lost) {
+			r->lost--;
+		}
+	} else {
+		r->next_seq = seq + 1;
+	}
+}
+
+static int run_server(const struct iperf_cfg *cfg)
+{
+	const struct shell *shell = cfg->shell;
+	struct iperf_report r = {.role = "server"};
+	struct sockaddr addr = {0};
+	struct zsock_pollfd pfd;
+	uint8_t *buf = iperf_buf;
+	int64_t wait_ms = ((int64_t)cfg->secs + 5) * MSEC_PER_SEC;
+	int64_t idle_since;
+	int sd;
+	int conn;
+	int ret;
+
+#if defined(CONFIG_NET_LOOPBACK)
+	if (cfg->loopback) {
+		buf = iperf_rx_buf;
+	}
+#endif
+	sd = iperf_socket(cfg);
+	if (sd < 0) {
+		shell_error(shell, "Socket creation failed, errno = %d", errno);
+		return -errno;
+	}
+	if (cfg->socks) {
+		cfg->socks[0] = sd;
+	}
+	addr.sa_family = AF_INET;
+	net_sin(&addr)->sin_port = htons(cfg->port);
+	if (zsock_bind(sd, &addr, sizeof(struct sockaddr_in)) < 0) {
+		shell_error(shell, "Bind failed, errno = %d", errno);
+		zsock_close(sd);
+		return -errno;
+	}
+	conn = sd;
+	if (!cfg->udp) {
+		if (zsock_listen(sd, 1) < 0) {
+			shell_error(shell, "Listen failed, errno = %d", errno);
+			zsock_close(sd);
+			return -errno;
+		}
+	}
+	shell_print(shell, "[server] listening on %s port %u", cfg->udp ? "UDP" : "TCP",
+		    cfg->port);
+
+	pfd.fd = sd;
+	pfd.events = ZSOCK_POLLIN;
+	ret = zsock_poll(&pfd, 1, wait_ms);
+	if (ret <= 0) {
+		shell_error(shell, "[server] no client within %lld s", wait_ms / MSEC_PER_SEC);
+		zsock_close(sd);
+		return -ETIMEDOUT;
+	}
+	if (!cfg->udp) {
+		conn = zsock_accept(sd, NULL, NULL);
+		if (conn < 0) {
+			shell_error(shell, "Accept failed, errno = %d", errno);
+			zsock_close(sd);
+			return -errno;
+		}
+		if (cfg->socks) {
+			cfg->socks[1] = conn;
+		}
+	}
+
+	r.start = r.last = idle_since = k_uptime_get();
+	r.cycles = thread_cycles();
+	pfd.fd = conn;
+	while (1) {
+		int64_t now;
+
+		ret = zsock_poll(&pfd, 1, cfg->interval_ms ? cfg->interval_ms : 1000);
+		now = k_uptime_get();
+		if (ret > 0) {
+			ret = zsock_recv(conn, buf, CONFIG_TMO_IPERF_BUF_SIZE, 0);
+			if (ret < 0) {
+				r.errors++;
+				break;
+			}
+			if (ret == 0) {
+				/* TCP peer closed */
+				break;
+			}
+			idle_since = now;
+			if (cfg->udp && ret >= sizeof(struct iperf_udp_hdr)) {
+				if ((int32_t)ntohl(((struct iperf_udp_hdr *)buf)->seq) < 0) {
+					break;
+				}
+				udp_account(&r, (struct iperf_udp_hdr *)buf);
+			}
+			r.total += ret;
+			r.pkts++;
+		} else if (ret < 0) {
+			r.errors++;
+			break;
+		} else if (cfg->udp && now - idle_since > IPERF_UDP_IDLE_MS) {
+			/* The end markers were lost */
+			break;
+		}
+		if (cfg->interval_ms && now - r.last >= cfg->interval_ms) {
+			report_interval(shell, &r, now);
+		}
+	}
+
+	report_total(cfg, &r, k_uptime_get());
+	if (conn != sd) {
+		zsock_close(conn);
+	}
+	zsock_close(sd);
+	return r.errors ? -EIO : 0;
+}
+
+#if defined(CONFIG_NET_LOOPBACK)
+K_THREAD_STACK_DEFINE(iperf_server_stack, CONFIG_TMO_IPERF_SERVER_STACK_SIZE);
+static struct k_thread iperf_server_thread;
+static int iperf_server_socks[2];
+
+static void iperf_server_entry(void *a, void *b, void *c)
+{
+	ARG_UNUSED(b);
+	ARG_UNUSED(c);
+
+	run_server((const struct iperf_cfg *)a);
+}
+#endif
+
+static int run_loopback(struct iperf_cfg *cfg)
+{
+#if defined(CONFIG_NET_LOOPBACK)
+	/* Shared with the server thread, which never outlives this call */
+	static struct iperf_cfg server;
+	int ret;
+
+	server = *cfg;
+	server.server = true;
+	server.host = NULL;
+	server.socks = iperf_server_socks;
+	iperf_server_socks[0] = iperf_server_socks[1] = -1;
+	cfg->host = "127.0.0.1";
+
+	k_thread_create(&iperf_server_thread, iperf_server_stack,
+			K_THREAD_STACK_SIZEOF(iperf_server_stack), iperf_server_entry, &server,
+			NULL, NULL, CONFIG_MAIN_THREAD_PRIORITY, 0, K_NO_WAIT);
+	/* Let the server bind before the client connects */
+	k_msleep(100);
+	ret = run_client(cfg);
+	if (k_thread_join(&iperf_server_thread, K_SECONDS(cfg->secs + 10))) {
+		/* Stuck server: reusing its thread object while it runs corrupts the kernel */
+		shell_error(cfg->shell, "[server] did not finish, aborted");
+		k_thread_abort(&iperf_server_thread);
+		for (int i = 0; i < ARRAY_SIZE(iperf_server_socks); i++) {
+			if (iperf_server_socks[i] >= 0) {
+				zsock_close(iperf_server_socks[i]);
+			}
+		}
+		ret = ret ? ret : -ETIMEDOUT;
+	}
+	return ret;
+#else
+	shell_error(cfg->shell, "Loopback mode requires CONFIG_NET_LOOPBACK");
+	return -ENOTSUP;
+#endif
+}
+
+int cmd_iperf(const struct shell *shell, size_t argc, char **argv)
+{
+	struct iperf_cfg cfg = {
+		.shell = shell,
+		.port = IPERF_DEFAULT_PORT,
+		.secs = IPERF_DEFAULT_SECS,
+		.interval_ms = MSEC_PER_SEC,
+		.len = sizeof(iperf_buf),
+		.rate_kbps = IPERF_DEFAULT_RATE_KBPS,
+	};
+	uint32_t val;
+	int c;
+
+	while ((c = getopt(argc, argv, "hsuLt:n:i:l:b:p:")) != -1) {
+		val = 0;
+		if (optarg && tmo_parse_uint(shell, optarg, &val)) {
+			return -EINVAL;
+		}
+		switch (c) {
+		case 's':
+			cfg.server = true;
+			break;
+		case 'u':
+			cfg.udp = true;
+			break;
+		case 'L':
+			cfg.loopback = true;
+			break;
+		case 't':
+			cfg.secs = val;
+			break;
+		case 'n':
+			cfg.bytes = val;
+			break;
+		case 'i':
+			cfg.interval_ms = val;
+			break;
+		case 'l':
+			cfg.len = CLAMP(val, sizeof(struct iperf_udp_hdr), sizeof(iperf_buf));
+			break;
+		case 'b':
+			cfg.rate_kbps = MAX(val, 1);
+			break;
+		case 'p':
+			cfg.port = val;
+			break;
+		case 'h':
+			print_usage(shell);
+			return 0;
+		default:
+			shell_error(shell, "Illegal option -- %c", (char)optopt);
+			print_usage(shell);
+			return -EINVAL;
+		}
+	}
+
+	if (cfg.loopback) {
+		return run_loopback(&cfg);
+	}
+
+	if (optind >= argc || (!cfg.server && optind + 1 >= argc)) {
+		shell_error(shell, "Missing required arguments");
+		print_usage(shell);
+		return -EINVAL;
+	}
+	if (tmo_parse_uint(shell, argv[optind], &val)) {
+		return -EINVAL;
+	}
+	cfg.iface = val;
+	if (net_if_get_by_index(cfg.iface) == NULL) {
+		shell_error(shell, "Interface %d not found", cfg.iface);
+		return -EINVAL;
+	}
+	if (!cfg.server) {
+		cfg.host = argv[optind + 1];
+	}
+
+	return cfg.server ? run_server(&cfg) : run_client(&cfg);
+}
@@ -0,0 +1,13 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TMO_IPERF_H
+#define TMO_IPERF_H
+#include <zephyr/shell/shell.h>
+
+int cmd_iperf(const struct shell *shell, size_t argc, char **argv);
+
+#endif
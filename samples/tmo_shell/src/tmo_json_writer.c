@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/sys/util.h>
+
+#include "tmo_json_writer.h"
+
+void tmo_json_init(struct tmo_json_writer *w, char *buf, size_t size,
+		tmo_json_sink_t sink, void *ctx)
+{
+	memset(w, 0, sizeof(*w));
+	w->buf = buf;
+	/* Keep a byte for the terminator when writing to a plain buffer */
+	w->size = sink ? size : size - 1;
+	w->sink = sink;
+	w->ctx = ctx;
+}
+
+static void flush(struct tmo_json_writer *w)
+{
+	int ret;
+
+	if (w->err || w->len == 0) {
+		return;
+	}
+	ret = w->sink(w->ctx, w->buf, w->len);
+	if (ret < 0) {
+		w->err = ret;
+	}
+	w->len = 0;
+}
+
+static void put(struct tmo_json_writer *w, const char *data, size_t len)
+{
+	while (!w->err && len) {
+		size_t n;
+
+		if (w->len == w->size) {
+			if (!w->sink) {
+				w->err = -ENOMEM;
+				return;
+			}
+			flush(w);
+			continue;
+		}
+		n = MIN(len, w->size - w->len);
+		memcpy(w->buf + w->len, data, n);
+		w->len += n;
+		w->total += n;
+		data += n;
+		len -= n;
+	}
+}
+
+static void put_c(struct tmo_json_writer *w, char c)
+{
+	put(w, &c, 1);
+}
+
+static void put_str(struct tmo_json_writer *w, const char *str)
+{
+	put_c(w, '"');
+	/* Only escape what can appear in our own keys and enum strings */
+	for (const char *p = str; *p; p++) {
+		if (*p == '"' || *p == '\\') {
+			put_c(w, '\\');
+		}
+		put_c(w, *p);
+	}
+	put_c(w, '"');
+}
+
+/* Separator and key in front of every value */
+static void put_key(struct tmo_json_writer *w, const char *key)
+{
+	if (w->comma) {
+		put_c(w, ',');
+	}
+	if (key) {
+		put_str(w, key);
+		put_c(w, ':');
+	}
+}
+
+void tmo_json_obj_begin(struct tmo_json_writer *w, const char *key)
+{
+	put_key(w, key);
+	put_c(w, '{');
+	w->comma = false;
+}
+
+void tmo_json_obj_end(struct tmo_json_writer *w)
+{
+	put_c(w, '}');
+	w->comma = true;
+}
+
+void tmo_json_arr_begin(struct tmo_json_writer *w, const char *key)
+{
+	put_key(w, key);
+	put_c(w, '[');
+	w->comma = false;
+}
+
+void tmo_json_arr_end(struct tmo_json_writer *w)
+{
+	put_c(w, ']');
+	w->comma = true;
+}
+
+static void put_uint(struct tmo_json_writer *w, uint64_t val, int min_digits)
+{
+	char tmp[20];
+	int i = sizeof(tmp);
+
+	do {
+		tmp[--i] = '0' + val % 10;
+		val /= 10;
+		min_digits--;
+	} while (val || min_digits > 0);
+	put(w, &tmp[i], sizeof(tmp) - i);
+}
+
+void tmo_json_int(struct tmo_json_writer *w, const char *key, int64_t val)
+{
+	put_key(w, key);
+	if (val < 0) {
+		put_c(w, '-');
+		put_uint(w, -(uint64_t)val, 1);
+	} else {
+		put_uint(w, val, 1);
+	}
+	w->comma = true;
+}
+
+void tmo_json_fixed(struct tmo_json_writer *w, const char *key, int64_t mantissa, int digits)
+{
+	uint64_t mag = mantissa < 0 ? -(uint64_t)mantissa : mantissa;
+	uint64_t scale = 1;
+
+	for (int i = 0; i < digits; i++) {
+		scale *= 10;
+	}
+	put_key(w, key);
+	if (mantissa < 0) {
+		put_c(w, '-');
+	}
+	put_uint(w, mag / scale, 1);
+	if (digits > 0) {
+		put_c(w, '.');
+		put_uint(w, mag % scale, digits);
+	}
+	w->comma = true;
+}
+
+int64_t tmo_sensor_value_to_fixed(const struct sensor_value *val, int digits)
+{
+	int32_t div = 1000000;
+	int32_t frac = val->val2;
+
+	for (int i = 0; i < digits; i++) {
+		div /= 10;
+	}
+	/* val1 and val2 carry the same sign, round half away from zero */
+	frac += frac < 0 ? -div / 2 : div / 2;
+	return (int64_t)val->val1 * (1000000 / div) + frac / div;
+}
+
+void tmo_json_sensor(struct tmo_json_writer *w, const char *key,
+		const struct sensor_value *val, int digits)
+{
+	tmo_json_fixed(w, key, tmo_sensor_value_to_fixed(val, digits), digits);
+}
+
+void tmo_json_str(struct tmo_json_writer *w, const char *key, const char *str)
+{
+	put_key(w, key);
+	put_str(w, str);
+	w->comma = true;
+}
+
+void tmo_json_null(struct tmo_json_writer *w, const char *key)
+{
+	put_key(w, key);
+	put(w, "null", 4);
+	w->comma = true;
+}
+
+int tmo_json_finish(struct tmo_json_writer *w)
+{
+	if (w->sink) {
+		flush(w);
+	} else if (!w->err) {
+		w->buf[w->len] = '\0';
+	}
+	return w->err ? w->err : (int)w->total;
+}
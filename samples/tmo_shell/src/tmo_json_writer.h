@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TMO_JSON_WRITER_H
+#define TMO_JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/drivers/sensor.h>
+
+/**
+ * @brief Receives each filled chunk of output
+ *
+ * @return int 0 on success, -err to abort the document
+ */
+typedef int (*tmo_json_sink_t)(void *ctx, const char *data, size_t len);
+
+/*
+ * Streaming JSON writer. Output goes into a small chunk buffer which is handed
+ * to the sink whenever it fills, so a document of any size can be written
+ * straight to a socket. Without a sink the buffer must hold the whole
+ * document and is NUL terminated on finish. Numbers are printed from fixed
+ * point, no float formatting is involved. Errors are sticky.
+ */
+struct tmo_json_writer {
+	char *buf;
+	size_t size;
+	size_t len;
+	size_t total;
+	tmo_json_sink_t sink;
+	void *ctx;
+	int err;
+	bool comma;
+};
+
+void tmo_json_init(struct tmo_json_writer *w, char *buf, size_t size,
+		tmo_json_sink_t sink, void *ctx);
+
+/**
+ * @brief Open an object or array. key is NULL for array members and the
+ * top-level value
+ */
+void tmo_json_obj_begin(struct tmo_json_writer *w, const char *key);
+void tmo_json_obj_end(struct tmo_json_writer *w);
+void tmo_json_arr_begin(struct tmo_json_writer *w, const char *key);
+void tmo_json_arr_end(struct tmo_json_writer *w);
+
+void tmo_json_int(struct tmo_json_writer *w, const char *key, int64_t val);
+void tmo_json_str(struct tmo_json_writer *w, const char *key, const char *str);
+void tmo_json_null(struct tmo_json_writer *w, const char *key);
+
+/**
+ * @brief Write mantissa / 10^digits with exactly digits decimals
+ */
+void tmo_json_fixed(struct tmo_json_writer *w, const char *key, int64_t mantissa, int digits);
+
+/**
+ * @brief Write a sensor_value rounded to digits decimals
+ */
+void tmo_json_sensor(struct tmo_json_writer *w, const char *key,
+		const struct sensor_value *val, int digits);
+
+/**
+ * @brief Round a sensor_value to a fixed point mantissa with digits decimals
+ * (0 to 6)
+ */
+int64_t tmo_sensor_value_to_fixed(const struct sensor_value *val, int digits);
+
+/**
+ * @brief Flush any buffered output to the sink
+ *
+ * @return int Total bytes written, -err on failure
+ */
+int tmo_json_finish(struct tmo_json_writer *w);
+
+#endif
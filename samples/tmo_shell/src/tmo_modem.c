@@ -1,13 +1,20 @@
 #include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 #include <zephyr/posix/fcntl.h>
 #include <zephyr/kernel.h>
 #include <zephyr/drivers/modem/murata-1sc.h>
 #include <zephyr/net/socket.h>
+#include <zephyr/net/net_mgmt.h>
+#include <zephyr/net/net_event.h>
+
+#include "tmo_modem.h"
+#include "tmo_histogram.h"
 
 /* Hardcoded for now */
 #define TMO_MODEM_IFACE_NUMBER 1
 
-#ifdef CONFIG_SOC_SERIES_EFM32PG12B
+#if defined(CONFIG_SOC_SERIES_EFM32PG12B) || defined(CONFIG_TMO_MODEM_MOCK)
 
 /**
  * @brief Passes a pointers data to fnctl which requires int.
@@ -56,6 +63,124 @@ char cmd_io_buf[MAX_CMD_BUF_SIZE] = {0};
 /* The resp buffer must be "owned" by whoever is making the call */
 K_MUTEX_DEFINE(ioctl_lock);
 
+/*
+ * Latency accounting. Every GET_ATCMD_RESP issued through tmo_modem_atcmd(), and
+ * every ioctl issued through tmo_modem_ioctl(), is timed into a per-request
+ * histogram, and every ioctl_lock acquisition records how long the caller waited
+ * for the lock and how long it then held it.
+ */
+struct modem_cmd_stats {
+	char cmd[TMO_MODEM_STATS_CMD_LEN];
+	struct tmo_histogram lat;
+};
+
+static struct modem_cmd_stats cmd_stats[CONFIG_TMO_MODEM_STATS_CMDS];
+static struct tmo_histogram lock_wait;
+static struct tmo_histogram lock_hold;
+static struct tmo_histogram queue_wait[TMO_MODEM_PRIO_COUNT];
+static uint32_t lock_taken;
+
+K_MUTEX_DEFINE(stats_lock);
+
+static void modem_lock(void)
+{
+	uint32_t start = k_cycle_get_32();
+
+	k_mutex_lock(&ioctl_lock, K_FOREVER);
+	lock_taken = k_cycle_get_32();
+
+	k_mutex_lock(&stats_lock, K_FOREVER);
+	tmo_histogram_add(&lock_wait, k_cyc_to_us_floor32(lock_taken - start));
+	k_mutex_unlock(&stats_lock);
+}
+
+static void modem_unlock(void)
+{
+	uint32_t held = k_cyc_to_us_floor32(k_cycle_get_32() - lock_taken);
+
+	k_mutex_unlock(&ioctl_lock);
+
+	k_mutex_lock(&stats_lock, K_FOREVER);
+	tmo_histogram_add(&lock_hold, held);
+	k_mutex_unlock(&stats_lock);
+}
+
+static void modem_cmd_record(const char *cmd, uint32_t us)
+{
+	struct modem_cmd_stats *slot = NULL;
+	int i;
+
+	k_mutex_lock(&stats_lock, K_FOREVER);
+	/* The last slot is kept for "other" so no command's stats get mixed in */
+	for (i = 0; i < ARRAY_SIZE(cmd_stats) - 1; i++) {
+		if (cmd_stats[i].cmd[0] == '\0' || !strcmp(cmd_stats[i].cmd, cmd)) {
+			slot = &cmd_stats[i];
+			break;
+		}
+	}
+	if (slot == NULL) {
+		slot = &cmd_stats[ARRAY_SIZE(cmd_stats) - 1];
+		strcpy(slot->cmd, "other");
+	} else if (slot->cmd[0] == '\0') {
+		strncpy(slot->cmd, cmd, sizeof(slot->cmd) - 1);
+	}
+	tmo_histogram_add(&slot->lat, us);
+	k_mutex_unlock(&stats_lock);
+}
+
+int tmo_modem_atcmd(int sd, char *buf)
+{
+	char cmd[TMO_MODEM_STATS_CMD_LEN];
+	uint32_t start;
+	int ret;
+
+	/* The response overwrites the request, keep its name for the stats */
+	strncpy(cmd, buf, sizeof(cmd) - 1);
+	cmd[sizeof(cmd) - 1] = '\0';
+
+	start = k_cycle_get_32();
+	ret = fcntl_ptr(sd, GET_ATCMD_RESP, buf);
+	modem_cmd_record(cmd, k_cyc_to_us_floor32(k_cycle_get_32() - start));
+
+	return ret;
+}
+
+int tmo_modem_get_stats(struct tmo_modem_cmd_stats *stats, int max)
+{
+	int n = 0;
+
+	k_mutex_lock(&stats_lock, K_FOREVER);
+	for (int i = 0; i < ARRAY_SIZE(cmd_stats) && n < max; i++) {
+		if (cmd_stats[i].cmd[0] == '\0') {
+			continue;
+		}
+		strcpy(stats[n].cmd, cmd_stats[i].cmd);
+		stats[n].lat = cmd_stats[i].lat;
+		n++;
+	}
+	k_mutex_unlock(&stats_lock);
+
+	return n;
+}
+
+void tmo_modem_get_lock_stats(struct tmo_histogram *wait, struct tmo_histogram *hold)
+{
+	k_mutex_lock(&stats_lock, K_FOREVER);
+	*wait = lock_wait;
+	*hold = lock_hold;
+	k_mutex_unlock(&stats_lock);
+}
+
+void tmo_modem_reset_stats(void)
+{
+	k_mutex_lock(&stats_lock, K_FOREVER);
+	memset(cmd_stats, 0, sizeof(cmd_stats));
+	tmo_histogram_reset(&lock_wait);
+	tmo_histogram_reset(&lock_hold);
+	memset(queue_wait, 0, sizeof(queue_wait));
+	k_mutex_unlock(&stats_lock);
+}
+
 /**
  * @brief A helper to use an offload socket like a normal one
  *
@@ -82,6 +207,14 @@ static inline int zsock_socket_ext(int family, int type, int proto, struct net_i
  * @param idx The index to use to find the modem
  * @return int Sock on success, -err on failure
  */
+#ifdef CONFIG_TMO_MODEM_MOCK
+static int tmo_modem_get_sock(int idx)
+{
+	ARG_UNUSED(idx);
+
+	return tmo_modem_mock_socket_create();
+}
+#else
 static int tmo_modem_get_sock(int idx)
 {
 	struct net_if *iface = net_if_get_by_index(idx);
@@ -97,31 +230,24 @@ static int tmo_modem_get_sock(int idx)
 
 	return sd;
 }
+#endif
 
-static int tmo_modem_get_atcmd_resp(enum mdmdata_e cmd)
+static const char *modem_cmd_str(enum mdmdata_e cmd)
 {
 	int idx = 0;
-	const char *cmd_str = NULL;
-	int sd;
-	int ret;
 
 	while (cmd_pool[idx].str != NULL) {
 		if (cmd_pool[idx].atcmd == cmd) {
-			cmd_str = cmd_pool[idx].str;
-			break;
+			return cmd_pool[idx].str;
 		}
 		++idx;
 	}
-	strncpy(cmd_io_buf, cmd_str, sizeof(cmd_io_buf));
-
-	/* The handler expects a non const ptr that it will sometimes write a response into */
-	sd = tmo_modem_get_sock(TMO_MODEM_IFACE_NUMBER);
-	ret = fcntl_ptr(sd, GET_ATCMD_RESP, cmd_io_buf);
-	zsock_close(sd);
-
-	return ret;
+	return NULL;
 }
 
+static int modem_cmd_sync(enum mdmdata_e type, char *res, int res_len,
+			  enum tmo_modem_prio prio);
+
 /**
  * @brief A number of modem calls return a string of a known length. This function
  * abstracts the convention of checking the result length, making the call and copying
@@ -166,71 +292,533 @@ static int tmo_modem_atcmd_str_get(char *res, int res_len, enum mdmdata_e type)
 		return -EINVAL;
 	}
 
-	k_mutex_lock(&ioctl_lock, K_FOREVER);
-	ret = tmo_modem_get_atcmd_resp(type);
+	ret = modem_cmd_sync(type, res, res_len, TMO_MODEM_PRIO_NORMAL);
+
+	return ret;
+}
+
+static int modem_query_exec(struct tmo_modem_query *q, size_t cnt)
+{
+	int sd;
+	int done = 0;
+
+	/* One socket and one lock acquisition for the whole batch */
+	modem_lock();
+	sd = tmo_modem_get_sock(TMO_MODEM_IFACE_NUMBER);
+	if (sd < 0) {
+		modem_unlock();
+		return sd;
+	}
+	for (size_t i = 0; i < cnt; i++) {
+		if (q[i].arg) {
+			uint32_t start = k_cycle_get_32();
+
+			q[i].rc = fcntl_ptr(sd, q[i].ioctl, q[i].arg);
+			modem_cmd_record(q[i].cmd, k_cyc_to_us_floor32(k_cycle_get_32() - start));
+			/* errno belongs to this thread, hand it back in the result */
+			if (q[i].rc == -1) {
+				q[i].rc = -errno;
+			}
+			if (q[i].rc >= 0) {
+				done++;
+			}
+			continue;
+		}
+		strncpy(cmd_io_buf, q[i].cmd, sizeof(cmd_io_buf));
+		q[i].rc = tmo_modem_atcmd(sd, cmd_io_buf);
+		/* Requests that expect a response treat an empty one as not ready */
+		if (q[i].rc == 0 && (q[i].res || q[i].num) && cmd_io_buf[0] == '\0') {
+			q[i].rc = -EAGAIN;
+		}
+		if (q[i].rc == 0 && q[i].res) {
+			if (strlen(cmd_io_buf) >= q[i].res_len) {
+				q[i].rc = -EINVAL;
+			} else {
+				strcpy(q[i].res, cmd_io_buf);
+			}
+		}
+		if (q[i].rc == 0 && q[i].num) {
+			*q[i].num = atoi(cmd_io_buf);
+		}
+		if (q[i].rc == 0) {
+			done++;
+		}
+	}
+	zsock_close(sd);
+	modem_unlock();
+
+	return done;
+}
+
+/*
+ * Request queue
+ *
+ * Requests are queued per priority and executed one at a time by the modem
+ * worker, highest priority first, so an interactive request never waits
+ * behind more than the request currently on the UART. Completion is reported
+ * through the request callback and/or a k_poll_signal. The synchronous API is
+ * a thin wrapper that submits and waits on a semaphore.
+ */
+K_FIFO_DEFINE(req_fifo_high);
+K_FIFO_DEFINE(req_fifo_normal);
+K_FIFO_DEFINE(req_fifo_low);
+
+static struct k_fifo *const req_fifo[TMO_MODEM_PRIO_COUNT] = {
+	[TMO_MODEM_PRIO_HIGH] = &req_fifo_high,
+	[TMO_MODEM_PRIO_NORMAL] = &req_fifo_normal,
+	[TMO_MODEM_PRIO_LOW] = &req_fifo_low,
+};
+K_SEM_DEFINE(req_sem, 0, K_SEM_MAX_LIMIT);
+
+static void modem_worker(void *a, void *b, void *c);
+
+#define MODEM_WORKER_STACK_SIZE 1536
+#define MODEM_WORKER_PRIORITY CONFIG_MAIN_THREAD_PRIORITY
+
+K_THREAD_DEFINE(modem_worker_tid, MODEM_WORKER_STACK_SIZE,
+		modem_worker, NULL, NULL, NULL,
+		MODEM_WORKER_PRIORITY, 0, 0);
+
+static void modem_worker(void *a, void *b, void *c)
+{
+	ARG_UNUSED(a);
+	ARG_UNUSED(b);
+	ARG_UNUSED(c);
+
+	while (1) {
+		struct tmo_modem_req *req = NULL;
+		uint32_t waited;
+
+		k_sem_take(&req_sem, K_FOREVER);
+		for (int i = 0; i < TMO_MODEM_PRIO_COUNT && req == NULL; i++) {
+			req = k_fifo_get(req_fifo[i], K_NO_WAIT);
+		}
+		if (req == NULL) {
+			continue;
+		}
+
+		waited = k_cyc_to_us_floor32(k_cycle_get_32() - req->queued_at);
+		k_mutex_lock(&stats_lock, K_FOREVER);
+		tmo_histogram_add(&queue_wait[req->prio], waited);
+		k_mutex_unlock(&stats_lock);
+
+		req->rc = modem_query_exec(req->q, req->cnt);
+		if (req->cb) {
+			req->cb(req);
+		}
+		if (req->signal) {
+			k_poll_signal_raise(req->signal, req->rc);
+		}
+	}
+}
+
+int tmo_modem_submit(struct tmo_modem_req *req)
+{
+	if (req == NULL || req->q == NULL || req->cnt == 0 ||
+	    req->prio >= TMO_MODEM_PRIO_COUNT) {
+		return -EINVAL;
+	}
+	req->queued_at = k_cycle_get_32();
+	k_fifo_put(req_fifo[req->prio], req);
+	k_sem_give(&req_sem);
+
+	return 0;
+}
+
+static void modem_req_done(struct tmo_modem_req *req)
+{
+	k_sem_give((struct k_sem *)req->user_data);
+}
+
+int tmo_modem_query_prio(struct tmo_modem_query *q, size_t cnt, enum tmo_modem_prio prio)
+{
+	struct k_sem done;
+	struct tmo_modem_req req = {
+		.q = q,
+		.cnt = cnt,
+		.prio = prio,
+		.cb = modem_req_done,
+		.user_data = &done,
+	};
+	int ret;
+
+	/* A completion callback issuing a synchronous request must not wait on itself */
+	if (k_current_get() == modem_worker_tid) {
+		return modem_query_exec(q, cnt);
+	}
+
+	k_sem_init(&done, 0, 1);
+	ret = tmo_modem_submit(&req);
 	if (ret == 0) {
-		strcpy(res, cmd_io_buf);
+		k_sem_take(&done, K_FOREVER);
+		ret = req.rc;
 	}
-	k_mutex_unlock(&ioctl_lock);
+	return ret;
+}
 
+int tmo_modem_query_batch(struct tmo_modem_query *q, size_t cnt)
+{
+	return tmo_modem_query_prio(q, cnt, TMO_MODEM_PRIO_NORMAL);
+}
+
+int tmo_modem_ioctl(const char *name, int cmd, const void *arg)
+{
+	struct tmo_modem_query q = {
+		.cmd = name,
+		.ioctl = cmd,
+		.arg = arg,
+	};
+	int ret;
+
+	if (arg == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	ret = tmo_modem_query_prio(&q, 1, TMO_MODEM_PRIO_HIGH);
+	if (ret >= 0) {
+		ret = q.rc;
+	}
+	if (ret < 0) {
+		errno = -ret;
+		return -1;
+	}
 	return ret;
 }
 
+void tmo_modem_get_queue_stats(struct tmo_histogram wait[TMO_MODEM_PRIO_COUNT])
+{
+	k_mutex_lock(&stats_lock, K_FOREVER);
+	memcpy(wait, queue_wait, sizeof(queue_wait));
+	k_mutex_unlock(&stats_lock);
+}
+
+static int modem_cmd_sync(enum mdmdata_e type, char *res, int res_len,
+			  enum tmo_modem_prio prio)
+{
+	struct tmo_modem_query q = {
+		.cmd = modem_cmd_str(type),
+		.res = res,
+		.res_len = res_len,
+	};
+	int ret;
+
+	if (q.cmd == NULL) {
+		return -EINVAL;
+	}
+	ret = tmo_modem_query_prio(&q, 1, prio);
+
+	return ret < 0 ? ret : q.rc;
+}
+
 int tmo_modem_wake()
 {
+	return modem_cmd_sync(wake_e, NULL, 0, TMO_MODEM_PRIO_HIGH);
+}
+
+int tmo_modem_sleep()
+{
+	return modem_cmd_sync(sleep_e, NULL, 0, TMO_MODEM_PRIO_HIGH);
+}
+
+int tmo_modem_get_state()
+{
+	/* The response provides no more information than the return code */
+	return modem_cmd_sync(awake_e, NULL, 0, TMO_MODEM_PRIO_NORMAL);
+}
+
+/*
+ * Modem status cache
+ *
+ * Identity values are read once and then served from RAM, the signal strength
+ * is refreshed by a background thread every CONFIG_TMO_MODEM_STATUS_REFRESH_SECS
+ * and whenever the modem interface connects. Polling does not depend on L4
+ * events, which may have fired before the callback was registered. Readers
+ * take status_lock only, so a cache hit never waits behind a UART round trip
+ * on ioctl_lock, and a stale signal is returned with its age while a refresh
+ * is scheduled. Only the very first signal read queries the modem directly.
+ */
+#define MODEM_ID_BUF_SIZE 32
+
+struct modem_status_field {
+	const char *name;
+	const char *cmd;
+	enum mdmdata_e type;
+	char val[MODEM_ID_BUF_SIZE];
+	int64_t ts;
+};
+
+static struct modem_status_field id_fields[TMO_MODEM_ID_COUNT] = {
+	[TMO_MODEM_ID_IMEI] = { .name = "imei", .cmd = "IMEI", .type = imei_e },
+	[TMO_MODEM_ID_ICCID] = { .name = "iccid", .cmd = "ICCID", .type = iccid_e },
+	[TMO_MODEM_ID_IMSI] = { .name = "imsi", .cmd = "IMSI", .type = imsi_e },
+	[TMO_MODEM_ID_MSISDN] = { .name = "msisdn", .cmd = "MSISDN", .type = msisdn_e },
+};
+
+static int signal_dbm;
+static int64_t signal_ts;
+static struct tmo_modem_cache_stats cache_stats;
+
+K_MUTEX_DEFINE(status_lock);
+K_SEM_DEFINE(status_refresh_sem, 0, 1);
+
+static int modem_id_fetch(enum tmo_modem_id id)
+{
+	struct modem_status_field *f = &id_fields[id];
+	char val[MODEM_ID_BUF_SIZE];
 	int ret;
 
-	k_mutex_lock(&ioctl_lock, K_FOREVER);
-	ret = tmo_modem_get_atcmd_resp(wake_e);
-	k_mutex_unlock(&ioctl_lock);
+	ret = tmo_modem_atcmd_str_get(val, sizeof(val), f->type);
+
+	k_mutex_lock(&status_lock, K_FOREVER);
+	cache_stats.refreshes++;
+	/* An empty response (no SIM, modem still booting) is not worth caching */
+	if (ret == 0 && val[0] != '\0') {
+		strncpy(f->val, val, sizeof(f->val) - 1);
+		f->ts = k_uptime_get();
+	} else {
+		cache_stats.errors++;
+		ret = ret ? ret : -EAGAIN;
+	}
+	k_mutex_unlock(&status_lock);
 
 	return ret;
 }
 
-int tmo_modem_sleep()
+static int modem_signal_fetch(void)
 {
 	int ret;
+	int dbm = 0;
+	struct tmo_modem_query q = {
+		.cmd = "SSI",
+		.num = &dbm,
+	};
 
-	k_mutex_lock(&ioctl_lock, K_FOREVER);
-	ret = tmo_modem_get_atcmd_resp(sleep_e);
-	k_mutex_unlock(&ioctl_lock);
+	ret = tmo_modem_query_prio(&q, 1, TMO_MODEM_PRIO_NORMAL);
+	ret = ret < 0 ? ret : q.rc;
+
+	k_mutex_lock(&status_lock, K_FOREVER);
+	cache_stats.refreshes++;
+	if (ret == 0) {
+		signal_dbm = dbm;
+		signal_ts = k_uptime_get();
+	} else {
+		cache_stats.errors++;
+	}
+	k_mutex_unlock(&status_lock);
 
 	return ret;
 }
 
-int tmo_modem_get_state()
+int tmo_modem_get_id(enum tmo_modem_id id, char *res, int res_len)
 {
-	int ret = -1;
+	struct modem_status_field *f;
+	int ret = 0;
 
-	k_mutex_lock(&ioctl_lock, K_FOREVER);
-	/* This call will set cmd_io_buf, but that provides no more information than the return code
-	 */
-	ret = tmo_modem_get_atcmd_resp(awake_e);
-	k_mutex_unlock(&ioctl_lock);
+	if (id >= TMO_MODEM_ID_COUNT || res == NULL) {
+		return -EINVAL;
+	}
+	f = &id_fields[id];
+
+	k_mutex_lock(&status_lock, K_FOREVER);
+	if (f->ts) {
+		cache_stats.hits++;
+	} else {
+		cache_stats.misses++;
+	}
+	k_mutex_unlock(&status_lock);
+
+	if (!f->ts) {
+		ret = modem_id_fetch(id);
+	}
+	if (ret == 0) {
+		k_mutex_lock(&status_lock, K_FOREVER);
+		if (strlen(f->val) >= res_len) {
+			ret = -EINVAL;
+		} else {
+			strcpy(res, f->val);
+		}
+		k_mutex_unlock(&status_lock);
+	}
 
 	return ret;
 }
 
 int tmo_modem_get_imei(char *res, int res_len)
 {
-	return tmo_modem_atcmd_str_get(res, res_len, imei_e);
+	return tmo_modem_get_id(TMO_MODEM_ID_IMEI, res, res_len);
 }
 
 int tmo_modem_get_iccid(char *res, int res_len)
 {
-	return tmo_modem_atcmd_str_get(res, res_len, iccid_e);
+	return tmo_modem_get_id(TMO_MODEM_ID_ICCID, res, res_len);
 }
 
 int tmo_modem_get_imsi(char *res, int res_len)
 {
-	return tmo_modem_atcmd_str_get(res, res_len, imsi_e);
+	return tmo_modem_get_id(TMO_MODEM_ID_IMSI, res, res_len);
 }
 
 int tmo_modem_get_msisdn(char *res, int res_len)
 {
-	return tmo_modem_atcmd_str_get(res, res_len, msisdn_e);
+	return tmo_modem_get_id(TMO_MODEM_ID_MSISDN, res, res_len);
+}
+
+int tmo_modem_get_signal(int *dbm, int64_t *age_ms)
+{
+	int64_t age;
+	int ret = 0;
+
+	k_mutex_lock(&status_lock, K_FOREVER);
+	age = k_uptime_get() - signal_ts;
+	if (!signal_ts) {
+		cache_stats.misses++;
+		age = -1;
+	} else if (age < CONFIG_TMO_MODEM_STATUS_MAX_AGE_SECS * MSEC_PER_SEC) {
+		cache_stats.hits++;
+	} else {
+		/* Serve the old value rather than block, the thread refreshes it */
+		cache_stats.stale++;
+		k_sem_give(&status_refresh_sem);
+	}
+	k_mutex_unlock(&status_lock);
+
+	if (age < 0) {
+		ret = modem_signal_fetch();
+		age = 0;
+	}
+	if (ret == 0) {
+		k_mutex_lock(&status_lock, K_FOREVER);
+		*dbm = signal_dbm;
+		k_mutex_unlock(&status_lock);
+		if (age_ms) {
+			*age_ms = age;
+		}
+	}
+
+	return ret;
+}
+
+void tmo_modem_cache_invalidate(void)
+{
+	k_mutex_lock(&status_lock, K_FOREVER);
+	for (int i = 0; i < TMO_MODEM_ID_COUNT; i++) {
+		id_fields[i].ts = 0;
+	}
+	signal_ts = 0;
+	k_mutex_unlock(&status_lock);
+	k_sem_give(&status_refresh_sem);
 }
 
+void tmo_modem_cache_get_stats(struct tmo_modem_cache_stats *stats)
+{
+	k_mutex_lock(&status_lock, K_FOREVER);
+	*stats = cache_stats;
+	k_mutex_unlock(&status_lock);
+}
+
+void tmo_modem_cache_reset_stats(void)
+{
+	k_mutex_lock(&status_lock, K_FOREVER);
+	memset(&cache_stats, 0, sizeof(cache_stats));
+	k_mutex_unlock(&status_lock);
+}
+
+const char *tmo_modem_id_name(enum tmo_modem_id id)
+{
+	return id < TMO_MODEM_ID_COUNT ? id_fields[id].name : NULL;
+}
+
+int64_t tmo_modem_id_age(enum tmo_modem_id id)
+{
+	int64_t ts = id < TMO_MODEM_ID_COUNT ? id_fields[id].ts : 0;
+
+	return ts ? k_uptime_get() - ts : -1;
+}
+
+static struct net_mgmt_event_callback modem_status_mgmt_cb;
+
+static void modem_status_event_handler(struct net_mgmt_event_callback *cb,
+				       uint32_t mgmt_event, struct net_if *iface)
+{
+	if (net_if_get_by_iface(iface) != TMO_MODEM_IFACE_NUMBER) {
+		return;
+	}
+	/* Registration: fill identity and signal from the status thread */
+	k_sem_give(&status_refresh_sem);
+}
+
+/* Refreshes every missing identity value and the signal in a single batched query */
+static void modem_status_refresh(bool identity)
+{
+	struct tmo_modem_query q[TMO_MODEM_ID_COUNT + 1] = {0};
+	char vals[TMO_MODEM_ID_COUNT][MODEM_ID_BUF_SIZE];
+	int ids[TMO_MODEM_ID_COUNT];
+	int cnt = 0;
+	int dbm;
+
+	for (int i = 0; identity && i < TMO_MODEM_ID_COUNT; i++) {
+		if (!id_fields[i].ts) {
+			ids[cnt] = i;
+			q[cnt].cmd = id_fields[i].cmd;
+			q[cnt].res = vals[i];
+			q[cnt].res_len = sizeof(vals[i]);
+			cnt++;
+		}
+	}
+	q[cnt].cmd = "SSI";
+	q[cnt].num = &dbm;
+
+	if (tmo_modem_query_prio(q, cnt + 1, TMO_MODEM_PRIO_LOW) < 0) {
+		return;
+	}
+
+	k_mutex_lock(&status_lock, K_FOREVER);
+	for (int i = 0; i <= cnt; i++) {
+		cache_stats.refreshes++;
+		if (q[i].rc) {
+			cache_stats.errors++;
+		} else if (i < cnt) {
+			strcpy(id_fields[ids[i]].val, q[i].res);
+			id_fields[ids[i]].ts = k_uptime_get();
+		} else {
+			signal_dbm = dbm;
+			signal_ts = k_uptime_get();
+		}
+	}
+	k_mutex_unlock(&status_lock);
+}
+
+static void modem_status_thread(void *a, void *b, void *c)
+{
+	ARG_UNUSED(a);
+	ARG_UNUSED(b);
+	ARG_UNUSED(c);
+
+	net_mgmt_init_event_callback(&modem_status_mgmt_cb, modem_status_event_handler,
+				     NET_EVENT_L4_CONNECTED);
+	net_mgmt_add_event_callback(&modem_status_mgmt_cb);
+
+	while (1) {
+		k_timeout_t period = CONFIG_TMO_MODEM_STATUS_REFRESH_SECS ?
+			K_SECONDS(CONFIG_TMO_MODEM_STATUS_REFRESH_SECS) : K_FOREVER;
+		bool kicked = k_sem_take(&status_refresh_sem, period) == 0;
+
+		/*
+		 * Kicked by registration or a stale read, or polling when a
+		 * period is set; a failed query only costs an error count and
+		 * the cached value keeps its age.
+		 */
+		modem_status_refresh(kicked);
+	}
+}
+
+#define MODEM_STATUS_THREAD_STACK_SIZE 1024
+#define MODEM_STATUS_THREAD_PRIORITY K_LOWEST_APPLICATION_THREAD_PRIO
+
+K_THREAD_DEFINE(modem_status_tid, MODEM_STATUS_THREAD_STACK_SIZE,
+		modem_status_thread, NULL, NULL, NULL,
+		MODEM_STATUS_THREAD_PRIORITY, 0, 0);
+
 #if CONFIG_MODEM_SMS && CONFIG_TMO_SHELL_ASYNC_SMS
 #include <zephyr/drivers/modem/sms.h>
 #include <zephyr/shell/shell.h>
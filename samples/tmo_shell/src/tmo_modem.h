@@ -1,8 +1,132 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
 #include <zephyr/drivers/modem/murata-1sc.h>
 
+#include "tmo_histogram.h"
+
 int fcntl_ptr(int sock, int cmd, const void* ptr);
 
-int tmo_modem_get_atcmd_resp(enum mdmdata_e cmd);
+#define TMO_MODEM_STATS_CMD_LEN 12
+
+struct tmo_modem_cmd_stats {
+	char cmd[TMO_MODEM_STATS_CMD_LEN];
+	/* Round trip latency in us */
+	struct tmo_histogram lat;
+};
+
+/**
+ * @brief Issues a GET_ATCMD_RESP on sd and records its latency under the request name
+ *
+ * @param sd A modem socket
+ * @param buf Holds the request on entry and the response on return
+ * @return int The fcntl result
+ */
+int tmo_modem_atcmd(int sd, char *buf);
+
+/**
+ * @brief Copies the per-request latency histograms
+ *
+ * @param stats Array to fill
+ * @param max Size of the array
+ * @return int Number of entries filled
+ */
+int tmo_modem_get_stats(struct tmo_modem_cmd_stats *stats, int max);
+
+/**
+ * @brief Copies the ioctl_lock wait and hold time histograms (us)
+ */
+void tmo_modem_get_lock_stats(struct tmo_histogram *wait, struct tmo_histogram *hold);
+
+void tmo_modem_reset_stats(void);
+
+struct tmo_modem_query {
+	/* Request string, e.g. "IMEI" or "SSI", or the stats name of an ioctl */
+	const char *cmd;
+	/* Optional, issue this ioctl with arg instead of GET_ATCMD_RESP on cmd */
+	int ioctl;
+	const void *arg;
+	/* Optional, receives the response as a string */
+	char *res;
+	int res_len;
+	/* Optional, receives the response parsed as an integer */
+	int *num;
+	/* Result of this request, -EAGAIN on an empty response */
+	int rc;
+};
+
+/**
+ * @brief Issues several modem requests over one socket under a single lock
+ * acquisition, at normal priority. Each entry gets its own result code.
+ *
+ * @param q The requests
+ * @param cnt Number of requests
+ * @return int Number of requests that succeeded, -err if no socket could be opened
+ */
+int tmo_modem_query_batch(struct tmo_modem_query *q, size_t cnt);
+
+enum tmo_modem_prio {
+	/* Interactive (shell) requests */
+	TMO_MODEM_PRIO_HIGH,
+	/* Application requests, e.g. a cache miss */
+	TMO_MODEM_PRIO_NORMAL,
+	/* Background polling */
+	TMO_MODEM_PRIO_LOW,
+	TMO_MODEM_PRIO_COUNT
+};
+
+struct tmo_modem_req;
+
+typedef void (*tmo_modem_cb_t)(struct tmo_modem_req *req);
+
+struct tmo_modem_req {
+	/* Reserved for the queue */
+	void *fifo_reserved;
+	struct tmo_modem_query *q;
+	size_t cnt;
+	enum tmo_modem_prio prio;
+	/* Optional, called from the modem worker on completion */
+	tmo_modem_cb_t cb;
+	void *user_data;
+	/* Optional, raised with the result on completion */
+	struct k_poll_signal *signal;
+	/* Number of queries that succeeded, or -err */
+	int rc;
+	uint32_t queued_at;
+};
+
+/**
+ * @brief Queues a request for the modem worker and returns immediately.
+ * The request and its queries must stay valid until completion.
+ *
+ * @param req The request
+ * @return int 0 if queued, -EINVAL on a malformed request
+ */
+int tmo_modem_submit(struct tmo_modem_req *req);
+
+/**
+ * @brief Queues a batch at the given priority and waits for it to complete
+ *
+ * @return int Number of queries that succeeded, -err on failure
+ */
+int tmo_modem_query_prio(struct tmo_modem_query *q, size_t cnt, enum tmo_modem_prio prio);
+
+/**
+ * @brief Issues a driver ioctl (e.g. AT_MODEM_EDRX_SET) through the modem worker at
+ * high priority, so it is serialised with every other request and timed under name.
+ * Returns like fcntl: the ioctl result, or -1 with errno set on failure.
+ *
+ * @param name Stats name, at most TMO_MODEM_STATS_CMD_LEN - 1 characters are kept
+ * @param cmd The ioctl
+ * @param arg The ioctl argument, must not be NULL
+ * @return int The ioctl result, -1 on failure
+ */
+int tmo_modem_ioctl(const char *name, int cmd, const void *arg);
+
+/**
+ * @brief Copies the per-priority queue wait histograms (us)
+ */
+void tmo_modem_get_queue_stats(struct tmo_histogram wait[TMO_MODEM_PRIO_COUNT]);
 
 /**
  * @brief Wakes the modem up
@@ -60,3 +184,83 @@ int tmo_modem_get_imsi(char* res, int res_len);
  * @return int
  */
 int tmo_modem_get_msisdn(char* res, int res_len);
+
+enum tmo_modem_id {
+	TMO_MODEM_ID_IMEI,
+	TMO_MODEM_ID_ICCID,
+	TMO_MODEM_ID_IMSI,
+	TMO_MODEM_ID_MSISDN,
+	TMO_MODEM_ID_COUNT
+};
+
+struct tmo_modem_cache_stats {
+	uint32_t hits;
+	uint32_t misses;
+	/* Reads served a value older than CONFIG_TMO_MODEM_STATUS_MAX_AGE_SECS */
+	uint32_t stale;
+	uint32_t refreshes;
+	uint32_t errors;
+};
+
+/**
+ * @brief Gets an identity value from the status cache, querying the modem on a miss
+ *
+ * @param id The value to get
+ * @param res A buffer to write into
+ * @param res_len The length of the buffer
+ * @return int 0 on success, -err on failure
+ */
+int tmo_modem_get_id(enum tmo_modem_id id, char* res, int res_len);
+
+/**
+ * @brief Gets the signal strength (dBm) from the status cache. The modem is only
+ * queried if nothing was ever cached. A value older than
+ * CONFIG_TMO_MODEM_STATUS_MAX_AGE_SECS is still returned, with its age, and a
+ * background refresh is scheduled.
+ *
+ * @param dbm Receives the signal strength
+ * @param age_ms Optional, receives the age of the value
+ * @return int 0 on success, -err on failure
+ */
+int tmo_modem_get_signal(int* dbm, int64_t* age_ms);
+
+/**
+ * @brief Drops all cached values and schedules a refresh
+ */
+void tmo_modem_cache_invalidate(void);
+
+void tmo_modem_cache_get_stats(struct tmo_modem_cache_stats* stats);
+void tmo_modem_cache_reset_stats(void);
+const char* tmo_modem_id_name(enum tmo_modem_id id);
+
+/**
+ * @brief Age of a cached identity value in ms, -1 if it is not cached
+ */
+int64_t tmo_modem_id_age(enum tmo_modem_id id);
+
+#ifdef CONFIG_TMO_MODEM_MOCK
+/* Responses of the mock modem socket */
+#define TMO_MODEM_MOCK_IMEI "490154203237518"
+#define TMO_MODEM_MOCK_SSI "-85"
+
+/**
+ * @brief Creates a mock modem socket, used in place of the Murata one
+ */
+int tmo_modem_mock_socket_create(void);
+
+/**
+ * @brief Clears the request log and sets the simulated round trip time
+ */
+void tmo_modem_mock_reset(int delay_ms);
+
+/**
+ * @brief Waits for a "HOLD" request to reach the mock, which then blocks until released
+ */
+int tmo_modem_mock_wait_held(k_timeout_t timeout);
+void tmo_modem_mock_release(void);
+
+/**
+ * @brief Copies the idx-th request the mock served, -ENOENT past the end
+ */
+int tmo_modem_mock_log(char *buf, int idx);
+#endif
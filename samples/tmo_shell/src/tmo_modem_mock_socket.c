@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/socket_offload.h>
+#include <zephyr/drivers/modem/murata-1sc.h>
+#include "sockets_internal.h"
+
+#include "tmo_modem.h"
+
+#define MOCK_LOG_LEN 16
+
+static const struct {
+	const char *cmd;
+	const char *res;
+} mock_resp[] = {
+	{ "IMEI", TMO_MODEM_MOCK_IMEI },
+	{ "ICCID", "89012604211234567890" },
+	{ "IMSI", "310260123456789" },
+	{ "MSISDN", "12065550100" },
+	{ "SSI", TMO_MODEM_MOCK_SSI },
+	{ "EMPTY", "" },
+};
+
+static struct {
+	char log[MOCK_LOG_LEN][TMO_MODEM_STATS_CMD_LEN];
+	int log_cnt;
+	int delay_ms;
+	int ptw;
+} mock;
+
+K_MUTEX_DEFINE(mock_lock);
+K_SEM_DEFINE(mock_held, 0, 1);
+K_SEM_DEFINE(mock_release, 0, 1);
+
+static void mock_log(const char *cmd)
+{
+	k_mutex_lock(&mock_lock, K_FOREVER);
+	if (mock.log_cnt < MOCK_LOG_LEN) {
+		strncpy(mock.log[mock.log_cnt], cmd, TMO_MODEM_STATS_CMD_LEN - 1);
+		mock.log_cnt++;
+	}
+	k_mutex_unlock(&mock_lock);
+}
+
+static int mock_atcmd(char *buf)
+{
+	const char *res = "OK";
+
+	mock_log(buf);
+	if (!strcmp(buf, "HOLD")) {
+		/* Stands in for a slow UART round trip the test controls */
+		k_sem_give(&mock_held);
+		k_sem_take(&mock_release, K_FOREVER);
+	} else if (mock.delay_ms) {
+		k_msleep(mock.delay_ms);
+	}
+	for (int i = 0; i < ARRAY_SIZE(mock_resp); i++) {
+		if (!strcmp(buf, mock_resp[i].cmd)) {
+			res = mock_resp[i].res;
+			break;
+		}
+	}
+	strcpy(buf, res);
+	return 0;
+}
+
+static int m_ioctl(void *obj, unsigned int request, va_list args)
+{
+	void *arg;
+
+	if (request == ZFD_IOCTL_SET_LOCK) {
+		return 0;
+	}
+	/* fcntl_ptr() passes the pointer as an int */
+	arg = (void *)(uintptr_t)va_arg(args, int);
+
+	switch (request) {
+	case GET_ATCMD_RESP:
+		return mock_atcmd(arg);
+	case AT_MODEM_EDRX_PTW_SET:
+		mock_log("PTW_SET");
+		mock.ptw = *(const int *)arg;
+		return 0;
+	case AT_MODEM_EDRX_PTW_GET:
+		mock_log("PTW_GET");
+		*(int *)arg = mock.ptw;
+		return 0;
+	default:
+		errno = ENOTSUP;
+		return -1;
+	}
+}
+
+static ssize_t m_read(void *obj, void *buffer, size_t count)
+{
+	errno = ENOTSUP;
+	return -1;
+}
+
+static ssize_t m_write(void *obj, const void *buffer, size_t count)
+{
+	errno = ENOTSUP;
+	return -1;
+}
+
+static int m_close(void *obj) { return 0; }
+
+static const struct socket_op_vtable modem_mock_op_vtable = {
+	.fd_vtable =
+	{
+		.read = m_read,
+		.write = m_write,
+		.close = m_close,
+		.ioctl = m_ioctl,
+	},
+};
+
+int tmo_modem_mock_socket_create(void)
+{
+	int fd = z_reserve_fd();
+
+	if (fd < 0) {
+		return -1;
+	}
+	z_finalize_fd(fd, &mock, (const struct fd_op_vtable *)&modem_mock_op_vtable);
+
+	return fd;
+}
+
+void tmo_modem_mock_reset(int delay_ms)
+{
+	k_mutex_lock(&mock_lock, K_FOREVER);
+	memset(mock.log, 0, sizeof(mock.log));
+	mock.log_cnt = 0;
+	mock.delay_ms = delay_ms;
+	k_mutex_unlock(&mock_lock);
+	k_sem_reset(&mock_held);
+	k_sem_reset(&mock_release);
+}
+
+int tmo_modem_mock_wait_held(k_timeout_t timeout)
+{
+	return k_sem_take(&mock_held, timeout);
+}
+
+void tmo_modem_mock_release(void)
+{
+	k_sem_give(&mock_release);
+}
+
+int tmo_modem_mock_log(char *buf, int idx)
+{
+	int ret = -ENOENT;
+
+	k_mutex_lock(&mock_lock, K_FOREVER);
+	if (idx < mock.log_cnt) {
+		strcpy(buf, mock.log[idx]);
+		ret = 0;
+	}
+	k_mutex_unlock(&mock_lock);
+
+	return ret;
+}
@@ -11,21 +11,55 @@
 #include <zephyr/net/ping.h>
 #include <zephyr/net/socket.h>
 #include "tmo_shell.h"
+#include "tmo_histogram.h"
 #include "tmo_ping.h"
 
-int ping_rxd;
-char host_addr[NET_IPV6_ADDR_LEN];
+#define PING_MAX_HOSTS	  4
+#define PING_MAX_INFLIGHT 8
 
-K_SEM_DEFINE(ping_sem, 0, 1);
+struct ping_host {
+	const char *name;
+	struct sockaddr dst;
+	char addr[NET_IPV6_ADDR_LEN];
+	uint32_t sent;
+	uint32_t rxd;
+	uint32_t timeouts;
+	uint64_t sum_sq;
+	struct tmo_histogram hist;
+};
+
+struct ping_req {
+	struct ping_host *host;
+	uint32_t seq;
+	int64_t deadline;
+};
+
+static struct ping_host hosts[PING_MAX_HOSTS];
+
+/*
+ * Outstanding requests in send order. The ping callback only reports a round
+ * trip time, so each reply is matched to the oldest outstanding request. That
+ * only identifies the right host if all outstanding requests go to one host,
+ * so with several hosts the window is limited to one request.
+ */
+static struct ping_req inflight[PING_MAX_INFLIGHT];
+static int inflight_head, inflight_cnt;
+
+K_MSGQ_DEFINE(ping_replies, sizeof(uint32_t), PING_MAX_INFLIGHT, 4);
+K_SEM_DEFINE(ping_evt, 0, K_SEM_MAX_LIMIT);
+
+static void ping_tick(struct k_timer *timer)
+{
+	k_sem_give(&ping_evt);
+}
+
+K_TIMER_DEFINE(ping_timer, ping_tick, NULL);
 
-const static struct shell* sh;
-void ping_cb(uint32_t ms)
+static void ping_cb(uint32_t ms)
 {
-	
-	// shell_print("Request %d ");
-    shell_print(sh, "Reply from %s; time = %dms", host_addr, ms);
-    ping_rxd++;
-	k_sem_give(&ping_sem);
+	/* Driver context, hand the result over to the shell thread */
+	k_msgq_put(&ping_replies, &ms, K_NO_WAIT);
+	k_sem_give(&ping_evt);
 }
 
 static struct net_ping_handler ping_handler = {
@@ -34,92 +68,269 @@ static struct net_ping_handler ping_handler = {
 
 static inline void print_usage(const struct shell *shell)
 {
-    shell_print(shell, "usage: ping [-c count] [-s packetsize] [-t timeout] iface host");
+	shell_print(shell, "usage: ping [-c count] [-i interval ms] [-s packetsize] [-t timeout ms]\n"
+			   "            [-w max in flight, single host only] iface host [host...]");
+}
+
+static int ping_resolve(const struct shell *shell, int if_idx, struct ping_host *h)
+{
+	if (!net_ipaddr_parse(h->name, strlen(h->name), &h->dst)) {
+		struct zsock_addrinfo *res;
+
+		tmo_offload_init(if_idx);
+		if (zsock_getaddrinfo(h->name, "1", NULL, &res)) {
+			shell_error(shell, "Cannot resolve %s: Unknown host", h->name);
+			return -EHOSTUNREACH;
+		}
+		memcpy(&h->dst, res->ai_addr, sizeof(struct sockaddr));
+		zsock_freeaddrinfo(res);
+	}
+	net_addr_ntop(h->dst.sa_family,
+		      ((h->dst.sa_family == AF_INET) ? (void *)&net_sin(&h->dst)->sin_addr
+						     : (void *)&net_sin6(&h->dst)->sin6_addr),
+		      h->addr, sizeof(h->addr));
+	return 0;
+}
+
+/* Returns the number of requests retired */
+static int ping_reply(const struct shell *shell, uint32_t ms, uint32_t timeout_ms)
+{
+	struct ping_req *req;
+
+	/* A reply slower than the timeout belongs to a request already given up on */
+	if (inflight_cnt == 0 || ms > timeout_ms) {
+		shell_print(shell, "Late reply, time = %ums", ms);
+		return 0;
+	}
+	req = &inflight[inflight_head];
+	inflight_head = (inflight_head + 1) % PING_MAX_INFLIGHT;
+	inflight_cnt--;
+
+	req->host->rxd++;
+	req->host->sum_sq += (uint64_t)ms * ms;
+	tmo_histogram_add(&req->host->hist, ms);
+	shell_print(shell, "Reply from %s: seq=%u time=%ums", req->host->addr, req->seq, ms);
+	return 1;
+}
+
+static int ping_expire(const struct shell *shell)
+{
+	int64_t now = k_uptime_get();
+	int n = 0;
+
+	while (inflight_cnt && inflight[inflight_head].deadline <= now) {
+		struct ping_req *req = &inflight[inflight_head];
+
+		req->host->timeouts++;
+		shell_print(shell, "Request timeout for %s seq=%u", req->host->addr, req->seq);
+		inflight_head = (inflight_head + 1) % PING_MAX_INFLIGHT;
+		inflight_cnt--;
+		n++;
+	}
+	return n;
+}
+
+static uint32_t isqrt(uint64_t v)
+{
+	uint64_t r = 0, bit = 1ULL << 62;
+
+	while (bit > v) {
+		bit >>= 2;
+	}
+	while (bit) {
+		if (v >= r + bit) {
+			v -= r + bit;
+			r = (r >> 1) + bit;
+		} else {
+			r >>= 1;
+		}
+		bit >>= 2;
+	}
+	return r;
+}
+
+static void ping_summary(const struct shell *shell, struct ping_host *h)
+{
+	const struct tmo_histogram *hist = &h->hist;
+
+	shell_print(shell, "--- %s ping statistics ---", h->name);
+	shell_print(shell, "%u packets transmitted, %u packets received, %u%% packet loss", h->sent,
+		    h->rxd, h->sent ? (100 * (h->sent - h->rxd)) / h->sent : 0);
+	if (h->rxd == 0) {
+		return;
+	}
+	uint32_t avg = tmo_histogram_avg(hist);
+	uint64_t mean_sq = h->sum_sq / h->rxd;
+
+	shell_print(shell, "round-trip min/avg/max/mdev = %u/%u/%u/%u ms", hist->min, avg, hist->max,
+		    mean_sq > (uint64_t)avg * avg ? isqrt(mean_sq - (uint64_t)avg * avg) : 0);
+	for (int b = 0; b < TMO_HISTOGRAM_BUCKETS; b++) {
+		if (hist->buckets[b]) {
+			shell_print(shell, "  < %6u ms: %u", b ? (1U << b) : 1, hist->buckets[b]);
+		}
+	}
 }
 
 int cmd_ping(const struct shell *shell, size_t argc, char **argv)
 {
-    int ping_cnt = 1, ret = 0;
-    uint32_t timeout_ms = 5000;
-    uint16_t sz = 64;
-    int8_t c;
-    ping_rxd = 0;
-    sh = shell;
+	uint32_t ping_cnt = 1;
+	uint32_t timeout_ms = 5000, interval_ms = 1000;
+	uint32_t max_inflight = 1;
+	uint32_t sz = 64;
+	uint32_t if_idx;
+	int nhosts, next_host = 0, pending = 0;
+	uint32_t total = 0, done = 0;
+	int ret = 0;
+	int8_t c;
+
+	if (argc < 3) {
+		print_usage(shell);
+		return -EINVAL;
+	}
+	while ((c = getopt(argc, argv, "ht:s:c:i:w:")) != -1) {
+		switch (c) {
+		case 'h':
+			print_usage(shell);
+			return 0;
+		case 't':
+			ret = tmo_parse_uint(shell, optarg, &timeout_ms);
+			break;
+		case 's':
+			ret = tmo_parse_uint(shell, optarg, &sz);
+			break;
+		case 'c':
+			ret = tmo_parse_uint(shell, optarg, &ping_cnt);
+			break;
+		case 'i':
+			ret = tmo_parse_uint(shell, optarg, &interval_ms);
+			break;
+		case 'w':
+			ret = tmo_parse_uint(shell, optarg, &max_inflight);
+			break;
+		case '?':
+			shell_error(shell, "Illegal option -- %c", (char)optopt);
+			print_usage(shell);
+			return -EINVAL;
+		default:
+			break;
+		}
+		if (ret) {
+			print_usage(shell);
+			return ret;
+		}
+	}
+	if (optind + 1 >= argc) {
+		print_usage(shell);
+		return -EINVAL;
+	}
+	if (tmo_parse_uint(shell, argv[optind], &if_idx)) {
+		print_usage(shell);
+		return -EINVAL;
+	}
+	if (if_idx > 2) {
+		shell_error(shell, "Unknown iface %u", if_idx);
+		print_usage(shell);
+		return -EINVAL;
+	}
+	if (ping_cnt == 0) {
+		shell_error(shell, "Invalid ping count %u", ping_cnt);
+		print_usage(shell);
+		return -EINVAL;
+	}
+	if (interval_ms == 0 || timeout_ms == 0) {
+		shell_error(shell, "Interval and timeout must be non-zero");
+		return -EINVAL;
+	}
+	if (sz > UINT16_MAX) {
+		shell_error(shell, "Invalid packet size %u", sz);
+		return -EINVAL;
+	}
+	if (max_inflight == 0 || max_inflight > PING_MAX_INFLIGHT) {
+		shell_error(shell, "Max in flight must be 1 to %d", PING_MAX_INFLIGHT);
+		return -EINVAL;
+	}
+	nhosts = MIN(argc - optind - 1, PING_MAX_HOSTS);
+	if (argc - optind - 1 > PING_MAX_HOSTS) {
+		shell_warn(shell, "Only the first %d hosts are pinged", PING_MAX_HOSTS);
+	}
+	/* Replies carry no host, see inflight */
+	if (nhosts > 1 && max_inflight > 1) {
+		shell_error(shell, "-w %u needs a single host, replies cannot be told apart",
+			    max_inflight);
+		return -EINVAL;
+	}
+
+	struct net_if *iface = net_if_get_by_index(if_idx);
+
+	memset(hosts, 0, sizeof(hosts));
+	for (int i = 0; i < nhosts; i++) {
+		hosts[i].name = argv[optind + 1 + i];
+		tmo_histogram_reset(&hosts[i].hist);
+		if (ping_resolve(shell, if_idx, &hosts[i])) {
+			print_usage(shell);
+			return -EHOSTUNREACH;
+		}
+		shell_print(shell, "PING %s (%s): %u data bytes", hosts[i].name, hosts[i].addr, sz);
+	}
+
+	inflight_head = inflight_cnt = 0;
+	k_msgq_purge(&ping_replies);
+	k_sem_reset(&ping_evt);
 	net_ping_cb_register(&ping_handler);
-    if (argc < 3) {
-        print_usage(shell);
-        ret = -EINVAL;
-        goto exit;
-    }
-    while ((c = getopt(argc - 2, argv, "ht:s:c:")) != -1) {
-        switch (c) {
-        case 'h':
-            print_usage(shell);
-            goto exit;
-        case 't':
-            timeout_ms = strtol(optarg, NULL, 10);
-            break;
-        case 's':
-            sz = strtol(optarg, NULL, 10);
-            break;
-        case 'c':
-            ping_cnt = strtol(optarg, NULL, 10);
-            break;
-        case '?':
-            shell_error(shell, "Illegal option -- %c", (char)optopt);
-            ret = -EINVAL;
-            print_usage(shell);
-            goto exit;
-        default:
-            break;
-        }
-    }
-    int if_idx = strtol(argv[argc - 2], NULL, 10);
-    if (if_idx < 0 || if_idx > 2) {
-        shell_error(shell, "Unknown iface %d", if_idx);
-        print_usage(shell);
-        goto exit;
-    }
-    struct net_if* iface = net_if_get_by_index(if_idx);
-    struct sockaddr dst;
-    char *host = argv[argc - 1];
-    if (ping_cnt <= 0) {
-        shell_error(shell, "Invalid ping count %d", ping_cnt);
-        print_usage(shell);
-        return EINVAL;
-    }
-    if (!net_ipaddr_parse(host, strlen(host), &dst)) 
-    {
-        tmo_offload_init(if_idx);
-        struct zsock_addrinfo *res;
-        if (zsock_getaddrinfo(host, "1", NULL, &res)){
-            shell_error(shell, "Cannot resolve %s: Unknown host", host);
-            print_usage(shell);
-            goto exit;
-        }
-        memcpy(&dst, res->ai_addr, sizeof(struct sockaddr));
-        zsock_freeaddrinfo(res);
-    }
-    net_addr_ntop(dst.sa_family,
-         ((dst.sa_family == AF_INET) ? (void*)&net_sin(&dst)->sin_addr : (void*)&net_sin6(&dst)->sin6_addr),
-         host_addr, sizeof(host_addr));
-    shell_print(shell, "PING %s (%s): %d data bytes", host, host_addr, sz);
-    k_sem_reset(&ping_sem);
-    for (int i = 0; i < ping_cnt; i++) {
-        ret = net_ping(iface, &dst, sz);
-        if (ret) {
-            shell_error(shell, "Failed to initiate ping, err = %d", ret);
-            goto exit;
-        }
-        if (k_sem_take(&ping_sem, K_MSEC(timeout_ms))) {
-            shell_print(shell, "Request timeout");
-        }
-        k_msleep(1000);
-    }
-    shell_print(shell, "%d packets transmitted, %d packets received, %.1d%% packet loss",
-         ping_cnt, ping_rxd, (100 * (ping_cnt - ping_rxd)) / ping_cnt);
-    exit:
-    k_sem_give(&ping_sem);
-    net_ping_cb_unregister(&ping_handler);
-    return ret;
+
+	/* Requests go out on the timer, one per host per interval */
+	total = ping_cnt * nhosts;
+	pending = 1;
+	k_timer_start(&ping_timer, K_MSEC(interval_ms), K_MSEC(interval_ms));
+
+	while (done < total) {
+		uint32_t ms;
+
+		while (pending && inflight_cnt < max_inflight &&
+		       hosts[next_host].sent < ping_cnt) {
+			struct ping_host *h = &hosts[next_host];
+			struct ping_req *req =
+				&inflight[(inflight_head + inflight_cnt) % PING_MAX_INFLIGHT];
+
+			req->host = h;
+			req->seq = h->sent;
+			req->deadline = k_uptime_get() + timeout_ms;
+			inflight_cnt++;
+			h->sent++;
+			ret = net_ping(iface, &h->dst, sz);
+			if (ret) {
+				shell_error(shell, "Failed to initiate ping, err = %d", ret);
+				goto exit;
+			}
+			next_host = (next_host + 1) % nhosts;
+			if (next_host == 0) {
+				pending--;
+			}
+		}
+
+		k_timeout_t wait = K_FOREVER;
+
+		if (inflight_cnt) {
+			wait = K_MSEC(MAX(inflight[inflight_head].deadline - k_uptime_get(), 0));
+		}
+		k_sem_take(&ping_evt, wait);
+
+		while (k_msgq_get(&ping_replies, &ms, K_NO_WAIT) == 0) {
+			done += ping_reply(shell, ms, timeout_ms);
+		}
+		done += ping_expire(shell);
+		/* Ticks missed while the window was full are dropped, not bunched up */
+		if (k_timer_status_get(&ping_timer)) {
+			pending = 1;
+		}
+	}
+	ret = 0;
+
+exit:
+	k_timer_stop(&ping_timer);
+	net_ping_cb_unregister(&ping_handler);
+	for (int i = 0; i < nhosts; i++) {
+		ping_summary(shell, &hosts[i]);
+	}
+	return ret;
 }
@@ -0,0 +1,346 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * One thread samples every on-board sensor at its own rate and keeps the
+ * latest value of each channel here. The BLE demo, the web demo and the
+ * shell read from this cache, so a sensor is only on the I2C bus once per
+ * period no matter how many consumers there are, and readers never block
+ * on a bus transfer.
+ *
+ * Sampling is driven by use: a sensor nobody has read for
+ * CONFIG_TMO_SENSOR_CACHE_IDLE_MS is no longer polled, to save power and
+ * bus time. The first read after that gets the last cached value (or
+ * -EAGAIN) and wakes the thread, which fetches the sensor right away and
+ * resumes polling. Readers, BLE GATT callbacks among them, never touch the
+ * bus.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/shell/shell.h>
+
+#include "tmo_sensor_cache.h"
+
+struct sensor_entry {
+	const char *name;
+	const struct device *dev;
+	enum sensor_channel chan;
+	/* Entry whose fetch also updates this one (light and IR share a chip) */
+	int fetched_by;
+	uint32_t period_ms;
+	int64_t next;
+	int64_t ts;
+	/* Last read of this entry or of one it fetches, 0 if never read */
+	int64_t last_read;
+	int rc;
+	bool valid;
+	struct sensor_value val[3];
+	uint32_t fetches;
+	uint32_t errors;
+	uint32_t reads;
+	uint32_t max_fetch_us;
+};
+
+static struct sensor_entry sensors[TMO_SENSOR_COUNT] = {
+	[TMO_SENSOR_ACCEL] = {
+		.name = "accel",
+		.dev = DEVICE_DT_GET(DT_NODELABEL(lis2dw12)),
+		.chan = SENSOR_CHAN_ACCEL_XYZ,
+		.fetched_by = -1,
+		.rc = -EAGAIN,
+		.period_ms = CONFIG_TMO_SENSOR_CACHE_ACCEL_PERIOD_MS,
+	},
+	[TMO_SENSOR_TEMP] = {
+		.name = "temp",
+		.dev = DEVICE_DT_GET(DT_NODELABEL(as6212)),
+		.chan = SENSOR_CHAN_AMBIENT_TEMP,
+		.fetched_by = -1,
+		.rc = -EAGAIN,
+		.period_ms = CONFIG_TMO_SENSOR_CACHE_ENV_PERIOD_MS,
+	},
+	[TMO_SENSOR_PRESS] = {
+		.name = "press",
+#if CONFIG_LPS22HH
+		.dev = DEVICE_DT_GET(DT_NODELABEL(lps22hh)),
+#endif
+		.chan = SENSOR_CHAN_PRESS,
+		.fetched_by = -1,
+		.rc = -EAGAIN,
+		.period_ms = CONFIG_TMO_SENSOR_CACHE_ENV_PERIOD_MS,
+	},
+	[TMO_SENSOR_LIGHT] = {
+		.name = "light",
+		.dev = DEVICE_DT_GET(DT_NODELABEL(tsl2540)),
+		.chan = SENSOR_CHAN_LIGHT,
+		.fetched_by = -1,
+		.rc = -EAGAIN,
+		.period_ms = CONFIG_TMO_SENSOR_CACHE_ENV_PERIOD_MS,
+	},
+	[TMO_SENSOR_IR] = {
+		.name = "ir",
+		.dev = DEVICE_DT_GET(DT_NODELABEL(tsl2540)),
+		.chan = SENSOR_CHAN_IR,
+		.fetched_by = TMO_SENSOR_LIGHT,
+		.rc = -EAGAIN,
+	},
+};
+
+K_MUTEX_DEFINE(sensor_cache_lock);
+/* Given when a reader wakes an idle sensor or a period changes */
+K_SEM_DEFINE(sensor_cache_wake, 0, 1);
+
+static bool sensor_idle(const struct sensor_entry *e, int64_t now)
+{
+	return CONFIG_TMO_SENSOR_CACHE_IDLE_MS &&
+	       (!e->last_read || now - e->last_read > CONFIG_TMO_SENSOR_CACHE_IDLE_MS);
+}
+
+static void sample_sensor(int id)
+{
+	struct sensor_entry *e = &sensors[id];
+	struct sensor_value val[TMO_SENSOR_COUNT][3];
+	uint32_t start = k_cycle_get_32();
+	uint32_t us;
+	int rc;
+
+	/* Bus access happens outside the lock so readers never wait on I2C */
+	rc = sensor_sample_fetch(e->dev);
+	if (rc == 0) {
+		for (int i = 0; i < TMO_SENSOR_COUNT; i++) {
+			if (i == id || sensors[i].fetched_by == id) {
+				int r = sensor_channel_get(sensors[i].dev, sensors[i].chan,
+						val[i]);
+				if (i == id) {
+					rc = r;
+				}
+			}
+		}
+	}
+	us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+
+	k_mutex_lock(&sensor_cache_lock, K_FOREVER);
+	e->fetches++;
+	e->max_fetch_us = MAX(e->max_fetch_us, us);
+	if (rc) {
+		e->errors++;
+	}
+	for (int i = 0; i < TMO_SENSOR_COUNT; i++) {
+		if (i == id || sensors[i].fetched_by == id) {
+			sensors[i].rc = rc;
+			sensors[i].ts = k_uptime_get();
+			if (rc == 0) {
+				sensors[i].valid = true;
+				memcpy(sensors[i].val, val[i], sizeof(sensors[i].val));
+			}
+		}
+	}
+	k_mutex_unlock(&sensor_cache_lock);
+}
+
+static void sensor_cache_thread(void *a, void *b, void *c)
+{
+	ARG_UNUSED(a);
+	ARG_UNUSED(b);
+	ARG_UNUSED(c);
+
+	for (int i = 0; i < TMO_SENSOR_COUNT; i++) {
+		if (sensors[i].dev && !device_is_ready(sensors[i].dev)) {
+			printf("Sensor %s not ready\n", sensors[i].name);
+			sensors[i].dev = NULL;
+		}
+	}
+	if (sensors[TMO_SENSOR_PRESS].dev) {
+		struct sensor_value attr = {
+			.val1 = 1,
+		};
+		if (sensor_attr_set(sensors[TMO_SENSOR_PRESS].dev, SENSOR_CHAN_ALL,
+					SENSOR_ATTR_SAMPLING_FREQUENCY, &attr) < 0) {
+			printf("Cannot configure sampling rate\n");
+		}
+	}
+
+	while (1) {
+		int64_t now = k_uptime_get();
+		int64_t wake = now + MSEC_PER_SEC;
+
+		for (int i = 0; i < TMO_SENSOR_COUNT; i++) {
+			struct sensor_entry *e = &sensors[i];
+			bool due;
+
+			k_mutex_lock(&sensor_cache_lock, K_FOREVER);
+			if (!e->dev || !e->period_ms || e->fetched_by >= 0 ||
+			    sensor_idle(e, now)) {
+				k_mutex_unlock(&sensor_cache_lock);
+				continue;
+			}
+			due = e->next <= now;
+			k_mutex_unlock(&sensor_cache_lock);
+			if (due) {
+				sample_sensor(i);
+			}
+			k_mutex_lock(&sensor_cache_lock, K_FOREVER);
+			if (due) {
+				e->next = now + e->period_ms;
+			}
+			wake = MIN(wake, e->next);
+			k_mutex_unlock(&sensor_cache_lock);
+		}
+		now = k_uptime_get();
+		if (wake > now) {
+			k_sem_take(&sensor_cache_wake, K_MSEC(wake - now));
+		}
+	}
+}
+
+#define SENSOR_CACHE_THREAD_STACK_SIZE 1024
+#define SENSOR_CACHE_THREAD_PRIORITY CONFIG_MAIN_THREAD_PRIORITY
+
+K_THREAD_DEFINE(sensor_cache_tid, SENSOR_CACHE_THREAD_STACK_SIZE,
+		sensor_cache_thread, NULL, NULL, NULL,
+		SENSOR_CACHE_THREAD_PRIORITY, 0, 0);
+
+int tmo_sensor_cache_get(enum tmo_sensor_id id, struct sensor_value *val, int64_t *age_ms)
+{
+	struct sensor_entry *e;
+	int src = id;
+	int64_t now = k_uptime_get();
+	int rc;
+
+	if (id >= TMO_SENSOR_COUNT) {
+		return -EINVAL;
+	}
+	e = &sensors[id];
+	if (!e->dev) {
+		return -ENODEV;
+	}
+	if (e->fetched_by >= 0) {
+		src = e->fetched_by;
+	}
+	k_mutex_lock(&sensor_cache_lock, K_FOREVER);
+	if (sensor_idle(&sensors[src], now) && sensors[src].period_ms) {
+		/* Not polled while unused, have the thread fetch it right away */
+		sensors[src].next = 0;
+		k_sem_give(&sensor_cache_wake);
+	}
+	sensors[src].last_read = now;
+	e->reads++;
+	rc = e->rc;
+	if (e->valid) {
+		/* On a failed fetch hand back the last good value */
+		memcpy(val, e->val, id == TMO_SENSOR_ACCEL ? sizeof(e->val) : sizeof(e->val[0]));
+		rc = 0;
+	}
+	if (age_ms) {
+		*age_ms = k_uptime_get() - e->ts;
+	}
+	k_mutex_unlock(&sensor_cache_lock);
+	return rc;
+}
+
+int tmo_sensor_cache_set_period(enum tmo_sensor_id id, uint32_t period_ms)
+{
+	if (id >= TMO_SENSOR_COUNT) {
+		return -EINVAL;
+	}
+	if (sensors[id].fetched_by >= 0) {
+		id = sensors[id].fetched_by;
+	}
+	k_mutex_lock(&sensor_cache_lock, K_FOREVER);
+	sensors[id].period_ms = period_ms;
+	sensors[id].next = 0;
+	k_mutex_unlock(&sensor_cache_lock);
+	k_sem_give(&sensor_cache_wake);
+	return 0;
+}
+
+int tmo_sensor_cache_get_stats(enum tmo_sensor_id id, struct tmo_sensor_stats *stats)
+{
+	struct sensor_entry *e;
+	int src = id;
+
+	if (id >= TMO_SENSOR_COUNT) {
+		return -EINVAL;
+	}
+	e = &sensors[id];
+	if (e->fetched_by >= 0) {
+		src = e->fetched_by;
+	}
+	k_mutex_lock(&sensor_cache_lock, K_FOREVER);
+	stats->period_ms = sensors[src].period_ms;
+	stats->fetches = sensors[src].fetches;
+	stats->errors = sensors[src].errors;
+	stats->max_fetch_us = sensors[src].max_fetch_us;
+	stats->reads = e->reads;
+	stats->age_ms = e->ts ? k_uptime_get() - e->ts : -1;
+	stats->idle = sensor_idle(&sensors[src], k_uptime_get());
+	k_mutex_unlock(&sensor_cache_lock);
+	return e->dev ? 0 : -ENODEV;
+}
+
+void tmo_sensor_cache_reset_stats(void)
+{
+	k_mutex_lock(&sensor_cache_lock, K_FOREVER);
+	for (int i = 0; i < TMO_SENSOR_COUNT; i++) {
+		sensors[i].fetches = 0;
+		sensors[i].errors = 0;
+		sensors[i].reads = 0;
+		sensors[i].max_fetch_us = 0;
+	}
+	k_mutex_unlock(&sensor_cache_lock);
+}
+
+const char *tmo_sensor_name(enum tmo_sensor_id id)
+{
+	return id < TMO_SENSOR_COUNT ? sensors[id].name : NULL;
+}
+
+int cmd_sensors(const struct shell *shell, size_t argc, char **argv)
+{
+	struct tmo_sensor_stats st;
+
+	if (argc > 1 && !strcmp(argv[1], "reset")) {
+		tmo_sensor_cache_reset_stats();
+	} else if (argc > 1) {
+		int id;
+		long period;
+		char *end;
+
+		for (id = 0; id < TMO_SENSOR_COUNT; id++) {
+			if (!strcmp(argv[1], sensors[id].name)) {
+				break;
+			}
+		}
+		if (id == TMO_SENSOR_COUNT || argc != 3) {
+			shell_error(shell, "Usage: tmo sensors [reset | <sensor> <period ms>]");
+			return -EINVAL;
+		}
+		errno = 0;
+		period = strtol(argv[2], &end, 10);
+		if (errno != 0 || *end != '\0' || period < 0) {
+			shell_error(shell, "Input argument %s is invalid", argv[2]);
+			return -EINVAL;
+		}
+		tmo_sensor_cache_set_period(id, period);
+	}
+
+	shell_print(shell, "Sensor  Period(ms)  Fetches  Errors  Reads  Max fetch(us)  Age(ms)");
+	for (int i = 0; i < TMO_SENSOR_COUNT; i++) {
+		if (tmo_sensor_cache_get_stats(i, &st)) {
+			shell_print(shell, "%-6s  not present", sensors[i].name);
+			continue;
+		}
+		shell_print(shell, "%-6s  %10u  %7u  %6u  %5u  %13u  %7d%s", sensors[i].name,
+			    st.period_ms, st.fetches, st.errors, st.reads, st.max_fetch_us,
+			    (int)st.age_ms, st.idle ? "  idle" : "");
+	}
+	return 0;
+}
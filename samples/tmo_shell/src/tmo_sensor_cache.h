@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TMO_SENSOR_CACHE_H
+#define TMO_SENSOR_CACHE_H
+
+#include <stdint.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/shell/shell.h>
+
+enum tmo_sensor_id {
+	TMO_SENSOR_ACCEL,
+	TMO_SENSOR_TEMP,
+	TMO_SENSOR_PRESS,
+	TMO_SENSOR_LIGHT,
+	TMO_SENSOR_IR,
+	TMO_SENSOR_COUNT
+};
+
+struct tmo_sensor_stats {
+	uint32_t period_ms;
+	uint32_t fetches;
+	uint32_t errors;
+	uint32_t reads;
+	uint32_t max_fetch_us;
+	int64_t age_ms;
+	/* Not polled because nothing has read it lately */
+	bool idle;
+};
+
+/**
+ * @brief Copies the latest cached value of a sensor. Never touches the bus;
+ * reading an idle sensor (see CONFIG_TMO_SENSOR_CACHE_IDLE_MS) wakes the
+ * sampling thread and returns the value cached before it went idle.
+ *
+ * @param id The sensor
+ * @param val Receives the value, 3 elements for the accelerometer
+ * @param age_ms Optional, receives how old the value is
+ * @return int 0 on success, -ENODEV if the sensor is absent, -EAGAIN if it
+ * has not been sampled yet, or the error of the last fetch
+ */
+int tmo_sensor_cache_get(enum tmo_sensor_id id, struct sensor_value *val, int64_t *age_ms);
+
+/**
+ * @brief Sets how often a sensor is sampled, 0 stops sampling it
+ */
+int tmo_sensor_cache_set_period(enum tmo_sensor_id id, uint32_t period_ms);
+
+int tmo_sensor_cache_get_stats(enum tmo_sensor_id id, struct tmo_sensor_stats *stats);
+void tmo_sensor_cache_reset_stats(void);
+const char *tmo_sensor_name(enum tmo_sensor_id id);
+
+int cmd_sensors(const struct shell *shell, size_t argc, char **argv);
+
+#endif
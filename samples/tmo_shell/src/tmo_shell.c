@@ -13,6 +13,7 @@
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(tmo_shell, LOG_LEVEL_INF);
 
+#include <ctype.h>
 #include <stdio.h>
 #include <zephyr/fs/fs.h>
 #include <zephyr/kernel.h>
@@ -30,6 +31,7 @@ LOG_MODULE_REGISTER(tmo_shell, LOG_LEVEL_INF);
 #include "tls_internal.h"
 #include <zephyr/net/tls_credentials.h>
 #include "ca_certificate.h"
+#include "tmo_tls_creds.h"
 typedef int sec_tag_t;
 #endif
 
@@ -45,6 +47,7 @@ typedef int sec_tag_t;
 #include "tmo_buzzer.h"
 #include "tmo_gnss.h"
 #include "tmo_web_demo.h"
+#include "tmo_tlm_queue.h"
 #include "tmo_wifi.h"
 #include "tmo_dfu_download.h"
 #include "tmo_file.h"
@@ -67,6 +70,21 @@ typedef int sec_tag_t;
 #include "tmo_ping.h"
 #endif
 
+#if CONFIG_TMO_IPERF
+#include "tmo_iperf.h"
+#endif
+
+#include "tmo_sensor_cache.h"
+#include "tmo_udp_burst.h"
+#include "tmo_sock_rtt.h"
+#include "tmo_sock_file.h"
+#if defined(CONFIG_NET_SOCKETS_ENABLE_DTLS)
+#include "tmo_dtls_session.h"
+#endif
+#if CONFIG_TMO_SOCK_RX
+#include "tmo_sock_rx.h"
+#endif
+
 #if CONFIG_PM_DEVICE
 #include "tmo_pm.h"
 #endif
@@ -101,6 +119,15 @@ extern uint32_t getData;
 extern int buzzer_test();
 extern int led_test();
 extern int misc_test();
+#if defined(CONFIG_NET_SOCKETS_SOCKOPT_TLS)
+extern int cert_store_test(const struct shell *shell, size_t argc, char **argv);
+#endif
+extern int digest_test(const struct shell *shell, size_t argc, char **argv);
+extern int file_bench_test(const struct shell *shell, size_t argc, char **argv);
+extern int udp_burst_test(const struct shell *shell, size_t argc, char **argv);
+#if CONFIG_TMO_MODEM_MOCK
+extern int modem_test(const struct shell *shell, size_t argc, char **argv);
+#endif
 extern int fw_test();
 extern int ac_test();
 
@@ -122,6 +149,16 @@ int process_cli_cmd_modem_edrx_ptw(const struct shell *shell, size_t argc, char
 
 struct sock_rec_s socks[MAX_SOCK_REC] = {0};
 
+struct sock_rec_s *tmo_sock_find(int sd)
+{
+	for (int i = 0; i < MAX_SOCK_REC; i++) {
+		if (socks[i].sd == sd && socks[i].flags & BIT(sock_open)) {
+			return &socks[i];
+		}
+	}
+	return NULL;
+}
+
 #if defined(CONFIG_NET_SOCKETS_ENABLE_DTLS)
 // int udp_cert_dtls(const struct shell *shell, size_t argc, char **argv);
 // int udp_key_dtls(const struct shell *shell, size_t argc, char **argv);
@@ -155,11 +192,51 @@ static long tmo_strtol(const char *nptr)
 	return 0;
 }
 
+int tmo_parse_uint(const struct shell *shell, const char *arg, uint32_t *val)
+{
+	char *end;
+	long v;
+
+	errno = 0;
+	v = strtol(arg, &end, 10);
+	if (errno != 0 || *end != '\0' || v < 0) {
+		shell_error(shell, "Input argument %s is invalid", arg);
+		return -EINVAL;
+	}
+	*val = v;
+	return 0;
+}
+
+static const char *modem_ioctl_name(enum murata_1sc_io_ctl cmd)
+{
+	switch (cmd) {
+	case STORE_CERT:
+		return "STORE_CERT";
+	case DEL_CERT:
+		return "DEL_CERT";
+	case CREATE_CERT_PROFILE:
+		return "PROF_ADD";
+	case DELETE_CERT_PROFILE:
+		return "PROF_DEL";
+	case AT_MODEM_PSM_SET:
+		return "PSM_SET";
+	case AT_MODEM_PSM_GET:
+		return "PSM_GET";
+	case AT_MODEM_EDRX_SET:
+		return "EDRX_SET";
+	case AT_MODEM_EDRX_GET:
+		return "EDRX_GET";
+	default:
+		return "ioctl";
+	}
+}
+
+/* sd only identifies the caller's socket, the modem worker issues the ioctl on its own */
 int tmo_set_modem(enum murata_1sc_io_ctl cmd, union params_cmd *params, int sd)
 {
-	int res = -1;
-	res = fcntl_ptr(sd, cmd, params);
-	return res;
+	ARG_UNUSED(sd);
+
+	return tmo_modem_ioctl(modem_ioctl_name(cmd), cmd, params);
 }
 
 int tmo_offload_init(int devid)
@@ -383,8 +460,6 @@ int udp_createv6(const struct shell *shell, size_t argc, char **argv)
 
 #if defined(CONFIG_NET_SOCKETS_ENABLE_DTLS)
 #define DTLS_ECHO_SERVER_CLIENT_PROFILE_ID 1
-static bool cert_credential_added = false;
-static bool key_credential_added = false;
 static bool create_profile_done = false;
 int udp_create_dtls_core(const struct shell *shell, size_t argc, char **argv, int family)
 {
@@ -395,30 +470,6 @@ int udp_create_dtls_core(const struct shell *shell, size_t argc, char **argv, in
 		return -EINVAL;
 	}
 
-	if (!cert_credential_added) {
-		ret = tls_credential_add(CLIENT_CERTIFICATE_TAG, TLS_CREDENTIAL_SERVER_CERTIFICATE,
-					 dev_certificate, sizeof(dev_certificate));
-		if (ret < 0) {
-			shell_error(shell, "<<< Failed to register public certificate: %d >>>\n",
-				    ret);
-		} else {
-			shell_info(shell, "===== Added DTLS ca_cert! =========\n");
-			cert_credential_added = true;
-		}
-	}
-
-	if (!key_credential_added) {
-		ret = tls_credential_add(CLIENT_KEY_TAG, TLS_CREDENTIAL_PRIVATE_KEY,
-					 dev_private_key, sizeof(dev_private_key));
-		if (ret < 0) {
-			shell_error(shell, "<<< Failed to register dev private key  %d >>>\n", ret);
-		} else {
-			shell_info(shell,
-				   "===== Added DTLS dev private key credential! =========\n");
-			key_credential_added = true;
-		}
-	}
-
 	int idx = tmo_strtol(argv[1]);
 	if (errno != 0) {
 		shell_error(shell, "Input argument %s is invalid, errno = %d; %s", argv[1], errno,
@@ -469,6 +520,7 @@ int udp_create_dtls_core(const struct shell *shell, size_t argc, char **argv, in
 			ret = -errno;
 		}
 	}
+	tmo_dtls_session_setup(shell, sd);
 	socks[idx].flags |= BIT(sock_dtls);
 
 	return ret;
@@ -608,6 +660,28 @@ int udp_create_dtlsv6(const struct shell *shell, size_t argc, char **argv)
 
 int sock_cmd_parent_bm;
 
+/*
+ * Non-blocking receive for the shell commands. Reads what the background
+ * receive engine has queued, or the socket itself when the engine does not
+ * own it. Follows the zsock_recvfrom() return and errno convention.
+ */
+static int shell_sock_recv(int sd, void *buf, size_t len, struct sockaddr *from,
+			   socklen_t *fromlen)
+{
+#if CONFIG_TMO_SOCK_RX
+	int ret = tmo_sock_rx_recvfrom(sd, buf, len, from);
+
+	if (ret != -ENOENT) {
+		if (ret < 0) {
+			errno = -ret;
+			return -1;
+		}
+		return ret;
+	}
+#endif
+	return zsock_recvfrom(sd, buf, len, ZSOCK_MSG_DONTWAIT, from, fromlen);
+}
+
 int sock_connect(const struct shell *shell, size_t argc, char **argv)
 {
 	if (argc < 4) {
@@ -618,6 +692,7 @@ int sock_connect(const struct shell *shell, size_t argc, char **argv)
 	int ret;
 	char *host;
 	struct sockaddr target;
+	int64_t connect_start;
 	int sd = tmo_strtol(argv[1]);
 	if (errno != 0) {
 		shell_error(shell, "Input argument %s is invalid, errno = %d; %s", argv[1], errno,
@@ -706,6 +781,8 @@ int sock_connect(const struct shell *shell, size_t argc, char **argv)
 			ret = setsockopt(sd, SOL_TLS, TLS_HOSTNAME, host, strlen(host));
 		}
 
+		memcpy(&target, res->ai_addr, MIN(res->ai_addrlen, sizeof(target)));
+		connect_start = k_uptime_get();
 		ret = zsock_connect(sd, res->ai_addr, res->ai_addrlen);
 		zsock_freeaddrinfo(res);
 	} else {
@@ -731,16 +808,27 @@ int sock_connect(const struct shell *shell, size_t argc, char **argv)
 			}
 #endif
 		}
+		connect_start = k_uptime_get();
 		ret = zsock_connect(sd, &target,
 				    target.sa_family == AF_INET6 ? sizeof(struct sockaddr_in6)
 								 : sizeof(struct sockaddr_in));
 	}
 
+#if defined(CONFIG_NET_SOCKETS_ENABLE_DTLS)
+	/* For DTLS the handshake runs inside connect() */
+	if (socks[sock_idx].flags & BIT(sock_dtls)) {
+		tmo_dtls_session_handshake(sd, &target, k_uptime_get() - connect_start, ret == 0);
+	}
+#endif
 	if (ret == -1) {
 		shell_error(shell, "Connection failed, errno = %d", errno);
 		return ret;
 	}
 	socks[sock_idx].flags |= BIT(sock_connected);
+#if CONFIG_TMO_SOCK_RX
+	tmo_sock_rx_add(sd, socks[sock_idx].dev,
+			socks[sock_idx].flags & (BIT(sock_udp) | BIT(sock_dtls)));
+#endif
 	shell_print(shell, "Connected socket %d", sd);
 	return 0;
 }
@@ -784,6 +872,10 @@ int sock_bind(const struct shell *shell, size_t argc, char **argv)
 		return 0;
 	}
 	socks[sock_idx].flags |= BIT(sock_bound);
+#if CONFIG_TMO_SOCK_RX
+	tmo_sock_rx_add(sd, socks[sock_idx].dev,
+			socks[sock_idx].flags & (BIT(sock_udp) | BIT(sock_dtls)));
+#endif
 	return 0;
 }
 
@@ -1075,8 +1167,8 @@ int sock_recvb(const struct shell *shell, size_t argc, char **argv)
 	int stat = 0;
 	bool again = true;
 	while (total < recvsize || recvsize == 0) {
-		stat = zsock_recv(sd, mxfer_buf + total, MIN(recvsize - total, max_fragment),
-				  ZSOCK_MSG_DONTWAIT);
+		stat = shell_sock_recv(sd, mxfer_buf + total, MIN(recvsize - total, max_fragment),
+				       NULL, NULL);
 		if (stat == -1) {
 			if ((total == 0) || (errno != EAGAIN)) {
 				shell_error(shell, "recv failed, errno = %d", errno);
@@ -1128,7 +1220,7 @@ int sock_rcv(const struct shell *shell, size_t argc, char **argv)
 	}
 	int stat = 0;
 	memset(mxfer_buf, 0, XFER_SIZE);
-	stat = zsock_recv(sd, mxfer_buf, XFER_SIZE, ZSOCK_MSG_DONTWAIT);
+	stat = shell_sock_recv(sd, mxfer_buf, XFER_SIZE, NULL, NULL);
 	if (stat > 0) {
 		shell_print(shell, "RECEIVED:\n%s ", (char *)mxfer_buf);
 	} else if (stat == -1 && errno == EWOULDBLOCK) {
@@ -1137,7 +1229,7 @@ int sock_rcv(const struct shell *shell, size_t argc, char **argv)
 	}
 	while (stat == XFER_SIZE) {
 		memset(mxfer_buf, 0, XFER_SIZE);
-		stat = zsock_recv(sd, mxfer_buf, XFER_SIZE, ZSOCK_MSG_DONTWAIT);
+		stat = shell_sock_recv(sd, mxfer_buf, XFER_SIZE, NULL, NULL);
 		shell_print(shell, "%s", (char *)mxfer_buf);
 	}
 	if (stat == -1) {
@@ -1172,15 +1264,14 @@ int sock_rcvfrom(const struct shell *shell, size_t argc, char **argv)
 		return -EINVAL;
 	}
 	struct sockaddr target;
-	int addrLen;
+	socklen_t addrLen;
 	int stat = 0;
 	int ai_family = (socks[sock_idx].flags & BIT(sock_v6)) ? AF_INET6 : AF_INET;
 	addrLen =
 		(ai_family == AF_INET6) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
 	memset(mxfer_buf, 0, XFER_SIZE);
 	char addrbuf[NET_IPV6_ADDR_LEN];
-	stat = zsock_recvfrom(sd, mxfer_buf, XFER_SIZE, ZSOCK_MSG_DONTWAIT,
-			      (struct sockaddr *)&target, &addrLen);
+	stat = shell_sock_recv(sd, mxfer_buf, XFER_SIZE, (struct sockaddr *)&target, &addrLen);
 #if IS_ENABLED(CONFIG_NET_IPV6)
 	void *addr = (ai_family == AF_INET6) ? (void *)&net_sin6(&target)->sin6_addr
 					     : (void *)&net_sin(&target)->sin_addr;
@@ -1199,7 +1290,7 @@ int sock_rcvfrom(const struct shell *shell, size_t argc, char **argv)
 	}
 	while (stat == XFER_SIZE) {
 		memset(mxfer_buf, 0, XFER_SIZE);
-		stat = zsock_recv(sd, mxfer_buf, XFER_SIZE, ZSOCK_MSG_DONTWAIT);
+		stat = shell_sock_recv(sd, mxfer_buf, XFER_SIZE, NULL, NULL);
 		shell_print(shell, "%s", (char *)mxfer_buf);
 	}
 	if (stat == -1) {
@@ -1236,12 +1327,21 @@ int sock_close(const struct shell *shell, size_t argc, char **argv)
 			shell, "Warning: Socket %d is a %s socket", sd,
 			(socks[sock_idx].flags & (BIT(sock_udp) | BIT(sock_dtls)) ? "UDP" : "TCP"));
 	}
+#if CONFIG_TMO_SOCK_RX
+	tmo_sock_rx_claim(sd, true);
+#endif
 	int stat = zsock_close(sd);
 	if (stat < 0) {
 		shell_error(shell, "Close failed, errno = %d", errno);
+#if CONFIG_TMO_SOCK_RX
+		tmo_sock_rx_release(sd);
+#endif
 		return stat;
 	}
 	socks[sock_idx].flags &= ~BIT(sock_open);
+#if CONFIG_TMO_SOCK_RX
+	tmo_sock_rx_close(sd);
+#endif
 	return stat;
 }
 
@@ -1279,7 +1379,7 @@ int sock_sendsms(const struct shell *shell, size_t argc, char **argv)
 	}
 	strncpy(sms.phone, argv[2], SMS_PHONE_MAX_LEN);
 	strncpy(sms.msg, argv[3], CONFIG_MODEM_SMS_OUT_MSG_MAX_LEN + 1);
-	ret = fcntl_ptr(sock_idx, SMS_SEND, &sms);
+	ret = tmo_modem_ioctl("SMS_SEND", SMS_SEND, &sms);
 	return ret;
 }
 
@@ -1317,7 +1417,8 @@ int sock_recvsms(const struct shell *shell, size_t argc, char **argv)
 		return -EINVAL;
 	}
 	sms.timeout = K_SECONDS(wait);
-	ret = fcntl_ptr(sock_idx, SMS_RECV, &sms);
+	/* Other modem requests queue behind this one for up to wait seconds */
+	ret = tmo_modem_ioctl("SMS_RECV", SMS_RECV, &sms);
 	if (ret > 0) {
 		shell_print(shell, "Received SMS from %s at %s: %s\n", sms.phone, sms.time,
 			    sms.msg);
@@ -1386,7 +1487,143 @@ void shell_help_modem(const struct shell *shell)
 			   "                  <cmd_str>: apn | awake | conn_sts | edrx | golden | "
 			   "iccid | imei | imsi |\n"
 			   "                             ip | ip6 | msisdn | psm | ptw | sim | "
-			   "sleep | ssi | version | wake");
+			   "sleep | ssi | version | wake\n"
+			   "tmo modem cache [flush | reset]\n"
+			   "tmo modem bench [rounds]\n"
+			   "tmo modem stats [reset]");
+}
+
+static void modem_hist_print(const struct shell *shell, const char *name,
+			     const struct tmo_histogram *h)
+{
+	shell_print(shell, "%-12s %6u %8u %8u %8u %8u %8u %8u", name, h->count, h->min,
+		    tmo_histogram_avg(h), h->max, tmo_histogram_percentile(h, 50),
+		    tmo_histogram_percentile(h, 95), tmo_histogram_percentile(h, 99));
+}
+
+static int cmd_modem_stats(const struct shell *shell, size_t argc, char **argv)
+{
+	static struct tmo_modem_cmd_stats st[CONFIG_TMO_MODEM_STATS_CMDS];
+	struct tmo_histogram wait, hold;
+	struct tmo_histogram qwait[TMO_MODEM_PRIO_COUNT];
+	static const char *const prio_names[] = {"[q high]", "[q normal]", "[q low]"};
+	int n;
+
+	if (argc > 2 && !strcmp(argv[2], "reset")) {
+		tmo_modem_reset_stats();
+		shell_print(shell, "Modem stats reset");
+		return 0;
+	} else if (argc > 2) {
+		shell_help_modem(shell);
+		return -EINVAL;
+	}
+
+	n = tmo_modem_get_stats(st, ARRAY_SIZE(st));
+	tmo_modem_get_lock_stats(&wait, &hold);
+	shell_print(shell, "%-12s %6s %8s %8s %8s %8s %8s %8s (us)", "request", "count", "min",
+		    "avg", "max", "p50", "p95", "p99");
+	for (int i = 0; i < n; i++) {
+		modem_hist_print(shell, st[i].cmd, &st[i].lat);
+	}
+	modem_hist_print(shell, "[lock wait]", &wait);
+	modem_hist_print(shell, "[lock hold]", &hold);
+
+	tmo_modem_get_queue_stats(qwait);
+	for (int i = 0; i < TMO_MODEM_PRIO_COUNT; i++) {
+		modem_hist_print(shell, prio_names[i], &qwait[i]);
+	}
+	return 0;
+}
+
+static int cmd_modem_bench(const struct shell *shell, size_t argc, char **argv)
+{
+	static const char *const cmds[] = {"SSI", "IMEI", "ICCID", "IMSI", "MSISDN"};
+	struct tmo_modem_query q[ARRAY_SIZE(cmds)];
+	char res[ARRAY_SIZE(cmds)][32];
+	uint32_t seq_us = 0, batch_us = 0;
+	uint32_t seq_max = 0, batch_max = 0;
+	int rounds = 10;
+
+	if (argc > 2) {
+		rounds = (int)tmo_strtol(argv[2]);
+		if (errno != 0 || rounds <= 0) {
+			shell_error(shell, "Input argument %s is invalid, errno = %d; %s", argv[2],
+				    errno, strerror(errno));
+			return -EINVAL;
+		}
+	}
+	for (int i = 0; i < ARRAY_SIZE(cmds); i++) {
+		q[i] = (struct tmo_modem_query){.cmd = cmds[i], .res = res[i], .res_len = 32};
+	}
+
+	for (int r = 0; r < rounds; r++) {
+		uint32_t start = k_cycle_get_32();
+		uint32_t us;
+
+		/* A batch of one costs what each of the existing helpers costs */
+		for (int i = 0; i < ARRAY_SIZE(cmds); i++) {
+			tmo_modem_query_prio(&q[i], 1, TMO_MODEM_PRIO_HIGH);
+		}
+		us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+		seq_us += us;
+		seq_max = MAX(seq_max, us);
+
+		start = k_cycle_get_32();
+		if (tmo_modem_query_prio(q, ARRAY_SIZE(q), TMO_MODEM_PRIO_HIGH) < 0) {
+			shell_error(shell, "Modem not available");
+			return -ENODEV;
+		}
+		us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+		batch_us += us;
+		batch_max = MAX(batch_max, us);
+	}
+
+	for (int i = 0; i < ARRAY_SIZE(cmds); i++) {
+		shell_print(shell, "%-7s rc %d: %s", cmds[i], q[i].rc, q[i].rc ? "" : res[i]);
+	}
+	shell_print(shell, "%d queries x %d rounds", ARRAY_SIZE(cmds), rounds);
+	shell_print(shell, "sequential: avg %u us, max %u us", seq_us / rounds, seq_max);
+	shell_print(shell, "batched:    avg %u us, max %u us", batch_us / rounds, batch_max);
+	return 0;
+}
+
+static int cmd_modem_cache(const struct shell *shell, size_t argc, char **argv)
+{
+	struct tmo_modem_cache_stats st;
+	char val[32];
+	int dbm;
+	int64_t age;
+
+	if (argc > 2 && !strcmp(argv[2], "flush")) {
+		tmo_modem_cache_invalidate();
+		shell_print(shell, "Modem status cache flushed");
+		return 0;
+	} else if (argc > 2 && !strcmp(argv[2], "reset")) {
+		tmo_modem_cache_reset_stats();
+	} else if (argc > 2) {
+		shell_help_modem(shell);
+		return -EINVAL;
+	}
+
+	for (int i = 0; i < TMO_MODEM_ID_COUNT; i++) {
+		age = tmo_modem_id_age(i);
+		if (age < 0) {
+			shell_print(shell, "%-7s <not cached>", tmo_modem_id_name(i));
+			continue;
+		}
+		tmo_modem_get_id(i, val, sizeof(val));
+		shell_print(shell, "%-7s %s (age %lld s)", tmo_modem_id_name(i), val,
+			    age / MSEC_PER_SEC);
+	}
+	if (tmo_modem_get_signal(&dbm, &age) == 0) {
+		shell_print(shell, "%-7s %d dBm (age %lld s)", "signal", dbm, age / MSEC_PER_SEC);
+	} else {
+		shell_print(shell, "%-7s <unavailable>", "signal");
+	}
+	tmo_modem_cache_get_stats(&st);
+	shell_print(shell, "hits: %u, misses: %u, stale: %u, refreshes: %u, errors: %u", st.hits,
+		    st.misses, st.stale, st.refreshes, st.errors);
+	return 0;
 }
 
 #define MAX_CMD_BUF_SIZE 256
@@ -1405,6 +1642,15 @@ static inline void strupper(char *p)
 
 int cmd_modem(const struct shell *shell, size_t argc, char **argv)
 {
+	if (argc > 1 && !strcmp(argv[1], "bench")) {
+		return cmd_modem_bench(shell, argc, argv);
+	}
+	if (argc > 1 && !strcmp(argv[1], "cache")) {
+		return cmd_modem_cache(shell, argc, argv);
+	}
+	if (argc > 1 && !strcmp(argv[1], "stats")) {
+		return cmd_modem_stats(shell, argc, argv);
+	}
 	if (argc < 3) {
 		shell_error(shell, "Missing required arguments");
 		shell_help_modem(shell);
@@ -1426,6 +1672,32 @@ int cmd_modem(const struct shell *shell, size_t argc, char **argv)
 			    iface->if_dev->dev->name);
 		return -EINVAL;
 	}
+	if (strcmp(argv[2], "edrx") && strcmp(argv[2], "ptw") && strcmp(argv[2], "psm")) {
+		/* Plain requests go through the modem worker like everyone else's */
+		char req[MAX_CMD_BUF_SIZE];
+		struct tmo_modem_query q = {
+			.cmd = req,
+			.res = cmd_buf,
+			.res_len = sizeof(cmd_buf),
+		};
+		int res;
+
+		strncpy(req, argv[2], sizeof(req) - 1);
+		req[sizeof(req) - 1] = '\0';
+		strupper(req);
+		cmd_buf[0] = '\0';
+		res = tmo_modem_query_prio(&q, 1, TMO_MODEM_PRIO_HIGH);
+		res = res < 0 ? res : q.rc;
+		if (res == -EAGAIN) {
+			shell_error(shell, "request: %s, response: <none>\n", argv[2]);
+		} else if (res < 0) {
+			shell_error(shell, "request: %s failed, error: %d\n", argv[2], res);
+		} else {
+			shell_print(shell, "request: %s, response: %s\n", argv[2], cmd_buf);
+		}
+		return res < 0 ? -1 : 0;
+	}
+
 	int sd = zsock_socket_ext(AF_INET, SOCK_STREAM, IPPROTO_TCP, iface);
 	if (sd == -1) {
 		shell_error(shell, "No sockets available, errno = %d", errno);
@@ -1436,19 +1708,8 @@ int cmd_modem(const struct shell *shell, size_t argc, char **argv)
 		process_cli_cmd_modem_edrx(shell, argc, argv, sd);
 	} else if (!strcmp(argv[2], "ptw")) {
 		process_cli_cmd_modem_edrx_ptw(shell, argc, argv, sd);
-	} else if (!strcmp(argv[2], "psm")) {
-		process_cli_cmd_modem_psm(shell, argc, argv, sd);
 	} else {
-		strcpy(cmd_buf, argv[2]);
-		strupper(cmd_buf);
-		int res = fcntl_ptr(sd, GET_ATCMD_RESP, cmd_buf);
-		if (res < 0) {
-			shell_error(shell, "request: %s failed, error: %d\n", argv[2], res);
-		} else if (cmd_buf[0] == 0) {
-			shell_error(shell, "request: %s, response: <none>\n", argv[2]);
-		} else {
-			shell_print(shell, "request: %s, response: %s\n", argv[2], cmd_buf);
-		}
+		process_cli_cmd_modem_psm(shell, argc, argv, sd);
 	}
 
 	int stat = zsock_close(sd);
@@ -1456,7 +1717,7 @@ int cmd_modem(const struct shell *shell, size_t argc, char **argv)
 		shell_error(shell, "Close failed, errno = %d", errno);
 		return stat;
 	}
-	return (cmd_buf[0] ? 0 : -1);
+	return 0;
 }
 
 #endif /* CONFIG_MODEM */
@@ -1506,9 +1767,11 @@ SHELL_STATIC_SUBCMD_SET_CREATE(
 #endif
 	SHELL_CMD(recv, NULL, "<socket>", tcp_rcv),
 	SHELL_CMD(recvb, NULL, "<socket> <size>", tcp_recvb),
+	SHELL_CMD(recvfile, NULL, "<socket> <file> [idle timeout (seconds)]", sock_recvfile),
 #if CONFIG_MODEM && CONFIG_MODEM_SMS
 	SHELL_CMD(recvsms, NULL, "<socket> <wait time (seconds)>", sock_recvsms),
 #endif /* CONFIG_MODEM && CONFIG_MODEM_SMS */
+	SHELL_CMD(rtt, NULL, "<socket> <count> <size> [timeout ms]", sock_rtt),
 #if defined(CONFIG_NET_SOCKETS_SOCKOPT_TLS)
 	SHELL_CMD(secure_create, NULL, "<iface>", tcp_create_tls),
 #if IS_ENABLED(CONFIG_NET_IPV6)
@@ -1517,6 +1780,7 @@ SHELL_STATIC_SUBCMD_SET_CREATE(
 #endif
 	SHELL_CMD(send, NULL, "<socket> <payload>", tcp_send),
 	SHELL_CMD(sendb, NULL, "<socket> <size>", tcp_sendb),
+	SHELL_CMD(sendfile, NULL, "<socket> <file>", sock_sendfile),
 #if CONFIG_MODEM && CONFIG_MODEM_SMS
 	SHELL_CMD(sendsms, NULL, "<socket> <phone number> <message>", sock_sendsms),
 #endif /* CONFIG_MODEM && CONFIG_MODEM_SMS */
@@ -1560,7 +1824,8 @@ int udp_close(const struct shell *shell, size_t argc, char **argv)
 
 SHELL_STATIC_SUBCMD_SET_CREATE(
 	tmo_udp_sub,
-
+	SHELL_CMD(burst, NULL, "<socket> <count> <size> <packets/s>", udp_burst_send),
+	SHELL_CMD(burstrx, NULL, "<socket> [wait time (seconds)]", udp_burst_recv),
 #if defined(CONFIG_NET_SOCKETS_ENABLE_DTLS)
 	SHELL_CMD(cert, NULL, "<w or d>  <socket>", udp_cred_dtls),
 	SHELL_CMD(ca, NULL, "<w or d>  <socket>", udp_cred_dtls),
@@ -1573,6 +1838,7 @@ SHELL_STATIC_SUBCMD_SET_CREATE(
 #endif
 // SHELL_CMD(bind, NULL, "<socket> <ip> <port>", sock_bind),
 #if defined(CONFIG_NET_SOCKETS_ENABLE_DTLS)
+	SHELL_CMD(dtlsstats, NULL, "DTLS handshake stats, [reset]", cmd_dtls_stats),
 	SHELL_CMD(key, NULL, "<w or d>  <socket>", udp_cred_dtls),
 	SHELL_CMD(profile, NULL, "<a or d>  <socket>", udp_profile_dtls),
 	SHELL_CMD(secure_create, NULL, "<iface>", udp_create_dtls),
@@ -1582,12 +1848,15 @@ SHELL_STATIC_SUBCMD_SET_CREATE(
 #endif
 	SHELL_CMD(recv, NULL, "<socket>", udp_rcv),
 	SHELL_CMD(recvb, NULL, "<socket> <size>", udp_recvb),
+	SHELL_CMD(recvfile, NULL, "<socket> <file> [idle timeout (seconds)]", sock_recvfile),
 	SHELL_CMD(recvfrom, NULL, "<socket> <ip> <port>", sock_rcvfrom),
 #if CONFIG_MODEM
 	SHELL_CMD(recvsms, NULL, "<socket> <wait time (seconds)>", sock_recvsms),
 #endif /* CONFIG_MODEM */
+	SHELL_CMD(rtt, NULL, "<socket> <count> <size> [timeout ms]", sock_rtt),
 	SHELL_CMD(send, NULL, "<socket> <payload>", udp_send),
 	SHELL_CMD(sendb, NULL, "<socket> <size>", udp_sendb),
+	SHELL_CMD(sendfile, NULL, "<socket> <file>", sock_sendfile),
 #if CONFIG_MODEM && CONFIG_MODEM_SMS
 	SHELL_CMD(sendsms, NULL, "<socket> <phone number> <message>", sock_sendsms),
 #endif /* CONFIG_MODEM && CONFIG_MODEM_SMS */
@@ -1676,32 +1945,14 @@ int cmd_http(const struct shell *shell, size_t argc, char **argv)
 		return -EINVAL;
 	}
 
-#if defined(CONFIG_NET_SOCKETS_SOCKOPT_TLS)
-	if (!ca_cert_sz) {
-		tls_credential_delete(CA_CERTIFICATE_TAG, TLS_CREDENTIAL_CA_CERTIFICATE);
-		tls_credential_add(CA_CERTIFICATE_TAG, TLS_CREDENTIAL_CA_CERTIFICATE,
-				   dev_certificate, sizeof(dev_certificate));
-	}
-	// else {
-	// 	tls_credential_add(CA_CERTIFICATE_TAG, TLS_CREDENTIAL_CA_CERTIFICATE,
-	// 			ca_cert, ca_cert_sz);
-	// }
-#endif
-
-	/*
-#if defined(CONFIG_NET_SOCKETS_SOCKOPT_TLS)
-tls_credential_delete(CA_CERTIFICATE_TAG, TLS_CREDENTIAL_CA_CERTIFICATE);
-tls_credential_add(CA_CERTIFICATE_TAG, TLS_CREDENTIAL_CA_CERTIFICATE,
-digicert_ca, sizeof(digicert_ca));
-#endif
-*/
 	int devid = tmo_strtol(argv[1]);
 	if (errno != 0) {
 		shell_error(shell, "Input argument %s is invalid, errno = %d; %s", argv[1], errno,
 			    strerror(errno));
 		return -errno;
 	}
-	ret = tmo_http_download(devid, argv[2], (argc == 4) ? argv[3] : NULL, NULL);
+	ret = tmo_http_download(devid, argv[2], (argc == 4) ? argv[3] : NULL, NULL,
+				TMO_TLS_USE_HTTP);
 	if (ret < 0) {
 		shell_error(shell, "tmo_http_download returned %d", ret);
 	}
@@ -1907,13 +2158,13 @@ int process_cli_cmd_modem_edrx_ptw(const struct shell *shell, size_t argc, char
 		}
 		if (ptw >= 0 && ptw <= 15) {
 			shell_print(shell, "Set eDRX PTW: %d", ptw);
-			fcntl_ptr(sd, AT_MODEM_EDRX_PTW_SET, (const void *)&ptw);
+			tmo_modem_ioctl("PTW_SET", AT_MODEM_EDRX_PTW_SET, &ptw);
 		} else {
 			shell_print(shell, "Invalid eDRX PTW value");
 			shell_print(shell, "tmo modem <iface> ptw [ptw_value]");
 		}
 	} else if (argc == 3) {
-		fcntl_ptr(sd, AT_MODEM_EDRX_PTW_GET, (const void *)&ptw);
+		tmo_modem_ioctl("PTW_GET", AT_MODEM_EDRX_PTW_GET, &ptw);
 		shell_print(shell, "PTW: %d", ptw);
 	} else {
 		shell_print(shell, "tmo modem <iface> ptw [ptw_value]");
@@ -2526,12 +2777,14 @@ int udp_profile_dtls(const struct shell *shell, size_t argc, char **argv)
 int golden_check()
 {
 	char cmd_buf[64];
-	struct net_if *iface = net_if_get_by_index(MODEM_ID);
-	int sd = zsock_socket_ext(AF_INET, SOCK_STREAM, IPPROTO_TCP, iface);
-	strcpy(cmd_buf, "golden");
-	strupper(cmd_buf);
-	int res = fcntl(sd, GET_ATCMD_RESP, cmd_buf);
-	zsock_close(sd);
+	struct tmo_modem_query q = {
+		.cmd = "GOLDEN",
+		.res = cmd_buf,
+		.res_len = sizeof(cmd_buf),
+	};
+	int res = tmo_modem_query_prio(&q, 1, TMO_MODEM_PRIO_HIGH);
+
+	res = res < 0 ? res : q.rc;
 	if (res < 0) {
 		printf("Modem firmware type detect failed (%d)\n", res);
 		return 1;
@@ -2678,6 +2931,8 @@ int cmd_json_transmit_disable(const struct shell *shell, size_t argc, char **arg
 
 int cmd_json_print_payload(const struct shell *shell, size_t argc, char **argv)
 {
+	/* Encoded on demand, the telemetry thread only keeps samples */
+	create_json();
 	printf("\n%s\n", get_json_payload_pointer());
 	return 0;
 }
@@ -2712,6 +2967,301 @@ int cmd_json_path(const struct shell *shell, size_t argc, char **argv)
 	return set_json_path(argv[1]);
 }
 
+int cmd_json_keepalive(const struct shell *shell, size_t argc, char **argv)
+{
+	int idle_secs;
+	bool enable = tmo_http_json_get_keepalive(&idle_secs);
+
+	if (argc > 1) {
+		if (!strcmp(argv[1], "on")) {
+			enable = true;
+		} else if (!strcmp(argv[1], "off")) {
+			enable = false;
+		} else {
+			shell_error(shell, "Usage: tmo json keepalive [on|off] [idle secs]");
+			return -EINVAL;
+		}
+	}
+	if (argc > 2) {
+		idle_secs = tmo_strtol(argv[2]);
+		if (errno != 0) {
+			shell_error(shell, "Input argument %s is invalid, errno = %d; %s", argv[2],
+				    errno, strerror(errno));
+			return -errno;
+		}
+	}
+	tmo_http_json_set_keepalive(enable, idle_secs);
+	shell_print(shell, "Keep-alive: %s, dropped when interval > %d secs",
+		    enable ? "ENABLED" : "DISABLED", idle_secs);
+	return 0;
+}
+
+int cmd_json_stats(const struct shell *shell, size_t argc, char **argv)
+{
+	struct tmo_http_json_stats st;
+	struct web_demo_batch_stats bs;
+
+	if (argc > 1 && !strcmp(argv[1], "reset")) {
+		tmo_http_json_reset_stats();
+		reset_web_demo_batch_stats();
+		return 0;
+	}
+	tmo_http_json_get_stats(&st);
+	shell_print(shell, "Posts: %u, failures: %u, bytes: %u", st.posts, st.failures, st.bytes);
+	shell_print(shell, "Connects: %u, reconnects: %u, connection %s", st.connects,
+		    st.reconnects, st.connected ? "OPEN" : "CLOSED");
+	if (st.posts) {
+		shell_print(shell, "Post latency (ms): last %u, min %u, avg %u, max %u", st.last_ms,
+			    st.min_ms, (uint32_t)(st.total_ms / st.posts), st.max_ms);
+	}
+
+	get_web_demo_batch_stats(&bs);
+	shell_print(shell, "Samples: %u, uploads: %u, upload bytes: %u", bs.samples, bs.posts,
+		    bs.bytes);
+	shell_print(shell, "Queued: %u, spilled: %u, dropped: %u", bs.queued, bs.spilled,
+		    bs.dropped);
+	shell_print(shell, "Deadband suppressed: %u samples, %u bytes", bs.suppressed,
+		    bs.suppressed_bytes);
+	if (bs.elapsed_ms > 0) {
+		shell_print(shell, "Per hour: %u samples, %u uploads, %u bytes",
+			    (uint32_t)((uint64_t)bs.samples * 3600000 / bs.elapsed_ms),
+			    (uint32_t)((uint64_t)bs.posts * 3600000 / bs.elapsed_ms),
+			    (uint32_t)((uint64_t)bs.bytes * 3600000 / bs.elapsed_ms));
+	}
+	return 0;
+}
+
+int cmd_json_batch(const struct shell *shell, size_t argc, char **argv)
+{
+	if (argc > 1) {
+		int n = tmo_strtol(argv[1]);
+
+		if (errno != 0) {
+			shell_error(shell, "Input argument %s is invalid, errno = %d; %s", argv[1],
+				    errno, strerror(errno));
+			return -errno;
+		}
+		if (set_batch_size(n)) {
+			shell_error(shell, "Batch size must be 1 to %d",
+				    CONFIG_TMO_WEB_DEMO_BATCH_SIZE_MAX);
+			return -EINVAL;
+		}
+	}
+	shell_print(shell, "Samples per upload: %d", get_batch_size());
+	return 0;
+}
+
+int cmd_json_format(const struct shell *shell, size_t argc, char **argv)
+{
+	if (argc > 1) {
+		if (!strcmp(argv[1], "json")) {
+			set_json_format(TMO_HTTP_FMT_JSON);
+		} else if (!strcmp(argv[1], "cbor")) {
+			set_json_format(TMO_HTTP_FMT_CBOR);
+		} else {
+			shell_error(shell, "Usage: tmo json format [json|cbor]");
+			return -EINVAL;
+		}
+	}
+	shell_print(shell, "Payload format for %s%s: %s", get_json_base_url(), get_json_path(),
+		    get_json_format() == TMO_HTTP_FMT_CBOR ? "CBOR" : "JSON");
+	shell_print(shell, "CBOR rejected by server (415): %u", get_json_cbor_rejected());
+	return 0;
+}
+
+int cmd_json_bench(const struct shell *shell, size_t argc, char **argv)
+{
+	struct web_demo_bench res;
+	int iterations = 100;
+
+	if (argc > 1) {
+		iterations = tmo_strtol(argv[1]);
+		if (errno != 0) {
+			shell_error(shell, "Input argument %s is invalid, errno = %d; %s", argv[1],
+				    errno, strerror(errno));
+			return -errno;
+		}
+	}
+	if (web_demo_encode_bench(iterations, &res)) {
+		shell_error(shell, "Iterations must be positive");
+		return -EINVAL;
+	}
+	shell_print(shell, "Encoder  bytes  us/sample");
+	shell_print(shell, "JSON     %5d  %9u", res.json_len, res.json_us);
+#if CONFIG_TMO_WEB_DEMO_JSON_LEGACY
+	shell_print(shell, "snprintf %5d  %9u", res.legacy_len, res.legacy_us);
+#endif
+	shell_print(shell, "CBOR     %5d  %9u", res.cbor_len, res.cbor_us);
+	return 0;
+}
+
+/* Parse a decimal such as "0.25" into micro-units */
+static int parse_micro(const char *str, int64_t *out)
+{
+	int64_t val = 0;
+	int64_t scale = 1000000;
+	bool neg = false;
+	bool frac = false;
+
+	if (*str == '-') {
+		neg = true;
+		str++;
+	}
+	if (!*str) {
+		return -EINVAL;
+	}
+	for (; *str; str++) {
+		if (*str == '.' && !frac) {
+			frac = true;
+		} else if (isdigit((unsigned char)*str)) {
+			if (!frac) {
+				val = val * 10 + (*str - '0');
+			} else if (scale > 1) {
+				scale /= 10;
+				val = val * 10 + (*str - '0');
+			}
+		} else {
+			return -EINVAL;
+		}
+	}
+	*out = (neg ? -val : val) * scale;
+	return 0;
+}
+
+int cmd_json_deadband(const struct shell *shell, size_t argc, char **argv)
+{
+	struct web_demo_deadband db;
+	bool skip;
+	bool enable = get_deadband_mode(&skip);
+
+	if (argc == 2) {
+		if (!strcmp(argv[1], "on")) {
+			set_deadband_mode(true, false);
+		} else if (!strcmp(argv[1], "skip")) {
+			set_deadband_mode(true, true);
+		} else if (!strcmp(argv[1], "off")) {
+			set_deadband_mode(false, false);
+		} else {
+			shell_error(shell, "Usage: tmo json deadband [on|skip|off]");
+			return -EINVAL;
+		}
+		enable = get_deadband_mode(&skip);
+	} else if (argc > 2) {
+		int f = web_demo_field_by_name(argv[1]);
+		int64_t abs;
+		int rel = 0;
+
+		if (f < 0) {
+			shell_error(shell, "Unknown field %s", argv[1]);
+			return -EINVAL;
+		}
+		if (parse_micro(argv[2], &abs) || abs < 0) {
+			shell_error(shell, "Input argument %s is invalid", argv[2]);
+			return -EINVAL;
+		}
+		if (argc > 3) {
+			rel = tmo_strtol(argv[3]);
+			if (errno != 0 || rel < 0 || rel > 255) {
+				shell_error(shell, "Input argument %s is invalid", argv[3]);
+				return -EINVAL;
+			}
+		}
+		if (argc > 4) {
+			int64_t alt;
+
+			if (f != WEB_DEMO_FIELD_MAP || parse_micro(argv[4], &alt) || alt < 0) {
+				shell_error(shell, "Input argument %s is invalid", argv[4]);
+				return -EINVAL;
+			}
+			set_deadband_alt(alt);
+		}
+		set_deadband(f, abs, rel);
+	}
+
+	shell_print(shell, "Deadband reporting: %s%s", enable ? "ENABLED" : "DISABLED",
+		    enable && skip ? ", unchanged samples skipped" : "");
+	shell_print(shell, "Field     abs          rel%%");
+	for (int f = 0; f < WEB_DEMO_FIELD_COUNT; f++) {
+		get_deadband(f, &db);
+		shell_print(shell, "%-9s %5d.%06d %4d", web_demo_field_name(f),
+			    (int)(db.abs / 1000000), (int)(db.abs % 1000000), db.rel_pct);
+		if (f == WEB_DEMO_FIELD_MAP) {
+			shell_print(shell, "%-9s %5d.%06d (m)", "altitude",
+				    (int)(db.alt / 1000000), (int)(db.alt % 1000000));
+		}
+	}
+	return 0;
+}
+
+int cmd_json_heartbeat(const struct shell *shell, size_t argc, char **argv)
+{
+	if (argc > 1) {
+		int secs = tmo_strtol(argv[1]);
+
+		if (errno != 0) {
+			shell_error(shell, "Input argument %s is invalid, errno = %d; %s", argv[1],
+				    errno, strerror(errno));
+			return -errno;
+		}
+		set_heartbeat_interval(secs);
+	}
+	shell_print(shell, "Full report at least every %d secs (0 = never)",
+		    get_heartbeat_interval());
+	return 0;
+}
+
+#if CONFIG_TMO_TLM_QUEUE
+int cmd_json_queue(const struct shell *shell, size_t argc, char **argv)
+{
+	struct tmo_tlm_queue_stats st;
+
+	if (argc > 1 && !strcmp(argv[1], "clear")) {
+		tmo_tlm_queue_clear();
+	} else if (argc > 2 && !strcmp(argv[1], "rate")) {
+		int batches = tmo_strtol(argv[2]);
+
+		if (errno != 0 || batches < 1) {
+			shell_error(shell, "Input argument %s is invalid", argv[2]);
+			return -EINVAL;
+		}
+		set_drain_rate(batches);
+	} else if (argc > 1) {
+		shell_error(shell, "Usage: tmo json queue [clear | rate <batches>]");
+		return -EINVAL;
+	}
+
+	tmo_tlm_queue_get_stats(&st);
+	shell_print(shell, "Queued: %u in %u segments, drained: %u, dropped: %u", st.queued,
+		    st.segments, st.drained, st.dropped);
+	if (st.discarded) {
+		shell_print(shell, "Discarded %u segments of an older record format",
+			    st.discarded);
+	}
+	if (st.oldest_age_ms >= 0) {
+		shell_print(shell, "Oldest: %u secs", (uint32_t)(st.oldest_age_ms / MSEC_PER_SEC));
+	}
+	shell_print(shell, "Drain rate: %d batches per upload", get_drain_rate());
+	return 0;
+}
+#endif
+
+int cmd_json_flush(const struct shell *shell, size_t argc, char **argv)
+{
+	if (argc > 1) {
+		int secs = tmo_strtol(argv[1]);
+
+		if (errno != 0) {
+			shell_error(shell, "Input argument %s is invalid, errno = %d; %s", argv[1],
+				    errno, strerror(errno));
+			return -errno;
+		}
+		set_flush_interval(secs);
+	}
+	shell_print(shell, "Flush interval: %d secs (0 = only when batch is full)",
+		    get_flush_interval());
+	return 0;
+}
+
 /* LITTLEFS */
 #ifdef CONFIG_FILE_SYSTEM_LITTLEFS
 #include <zephyr/fs/littlefs.h>
@@ -2784,13 +3334,28 @@ int cmd_play_tone(const struct shell *shell, size_t argc, char **argv)
 
 SHELL_STATIC_SUBCMD_SET_CREATE(
 	tmo_json_sub, SHELL_CMD(base_url, NULL, "Set JSON base URL", cmd_json_base_url),
+	SHELL_CMD(batch, NULL, "Set samples per upload [n]", cmd_json_batch),
+	SHELL_CMD(bench, NULL, "Compare payload encoders [iterations]", cmd_json_bench),
+	SHELL_CMD(deadband, NULL,
+		  "Report only changed fields [on|skip|off] | <field> <abs> [rel%] [map alt m]",
+		  cmd_json_deadband),
 	SHELL_CMD(disable, NULL, "Disable JSON transmission", cmd_json_transmit_disable),
 	SHELL_CMD(enable, NULL, "Enable JSON transmission", cmd_json_transmit_enable),
+	SHELL_CMD(flush, NULL, "Set max secs between uploads [secs]", cmd_json_flush),
+	SHELL_CMD(format, NULL, "Set payload format for this endpoint [json|cbor]",
+		  cmd_json_format),
+	SHELL_CMD(heartbeat, NULL, "Set max secs between full reports [secs]",
+		  cmd_json_heartbeat),
 	SHELL_CMD(iface, NULL, "Set JSON iface", cmd_json_set_iface),
 	SHELL_CMD(interval, NULL, "Set transmit interval (secs)", cmd_json_transmit_interval),
+	SHELL_CMD(keepalive, NULL, "Set HTTP keep-alive [on|off] [idle secs]", cmd_json_keepalive),
 	SHELL_CMD(path, NULL, "Set JSON path part of URL", cmd_json_path),
 	SHELL_CMD(payload, NULL, "Print JSON data", cmd_json_print_payload),
+#if CONFIG_TMO_TLM_QUEUE
+	SHELL_CMD(queue, NULL, "Stored telemetry [clear | rate <batches>]", cmd_json_queue),
+#endif
 	SHELL_CMD(settings, NULL, "Print JSON settings", cmd_json_print_settings),
+	SHELL_CMD(stats, NULL, "Print post latency stats [reset]", cmd_json_stats),
 	SHELL_SUBCMD_SET_END);
 
 SHELL_STATIC_SUBCMD_SET_CREATE(tmo_mfg_sub, SHELL_CMD(all, NULL, "Run all MFG tests", cmd_mfg_test),
@@ -2800,7 +3365,19 @@ SHELL_STATIC_SUBCMD_SET_CREATE(tmo_mfg_sub, SHELL_CMD(all, NULL, "Run all MFG te
 			       SHELL_SUBCMD_SET_END);
 
 SHELL_STATIC_SUBCMD_SET_CREATE(tmo_test_sub, SHELL_CMD(mfg, &tmo_mfg_sub, "Manufacturing", NULL),
+#if defined(CONFIG_NET_SOCKETS_SOCKOPT_TLS)
+			       SHELL_CMD(certstore, NULL, "Cert store index, delete and compaction",
+					 cert_store_test),
+#endif
+			       SHELL_CMD(digest, NULL, "Digest known answer vectors", digest_test),
+			       SHELL_CMD(fsbench, NULL, "File bench workloads and cleanup",
+					 file_bench_test),
+#if CONFIG_TMO_MODEM_MOCK
+			       SHELL_CMD(modem, NULL, "Modem request queue (mock modem)", modem_test),
+#endif
 			       SHELL_CMD(qa, NULL, "Quality Assurance (TBD)", cmd_qa_test),
+			       SHELL_CMD(udpburst, NULL, "UDP burst accounting and loopback",
+					 udp_burst_test),
 			       SHELL_SUBCMD_SET_END);
 
 SHELL_STATIC_SUBCMD_SET_CREATE(
@@ -2881,23 +3458,15 @@ int cmd_tmo_cert_modem_load(const struct shell *shell, int argc, char **argv)
 	cert.type = TLS_CREDENTIAL_CA_CERTIFICATE;
 	cparams.filename = name;
 	cparams.cert = &cert;
-	int sock =
-		zsock_socket_ext(AF_INET, SOCK_STREAM, IPPROTO_TCP, net_if_get_by_index(MODEM_ID));
-	if (sock == -1) {
-		shell_error(shell, "Unable to open modem socket!");
-		return EIO;
-	}
 
-	if (fcntl_ptr(sock, CHECK_CERT, name) == 0) {
+	if (tmo_modem_ioctl("CHECK_CERT", CHECK_CERT, name) == 0) {
 		if (!force) {
 			shell_error(shell, "Cert already loaded!");
-			zsock_close(sock);
 			return EIO;
 		}
-		fcntl_ptr(sock, DEL_CERT, name);
+		tmo_modem_ioctl("DEL_CERT", DEL_CERT, name);
 	}
-	fcntl_ptr(sock, STORE_CERT, &cparams);
-	zsock_close(sock);
+	tmo_modem_ioctl("STORE_CERT", STORE_CERT, &cparams);
 
 	return 0;
 }
@@ -2910,10 +3479,19 @@ int cmd_hwid(const struct shell *shell, int argc, char **argv)
 }
 
 SHELL_STATIC_SUBCMD_SET_CREATE(certs_sub,
+			       SHELL_CMD(bench, NULL, "Benchmark certificate lookup",
+					 cmd_tmo_cert_bench),
+			       SHELL_CMD(compact, NULL, "Reclaim space of deleted certificates",
+					 cmd_tmo_cert_compact),
+			       SHELL_CMD(creds, NULL, "Registered TLS credentials and footprint",
+					 cmd_tls_creds),
+			       SHELL_CMD(delete, NULL, "Delete certificate", cmd_tmo_cert_delete),
 			       SHELL_CMD(dld, NULL, "Download certificates", cmd_tmo_cert_dld),
 			       SHELL_CMD(info, NULL, "Print certificate", cmd_tmo_cert_info),
-			       SHELL_CMD(list, NULL, "List certificates", cmd_tmo_cert_list),
-			       SHELL_CMD(load, NULL, "Load certificate", cmd_tmo_cert_load),
+			       SHELL_CMD(list, NULL, "List certificates [-l] [filter]",
+					 cmd_tmo_cert_list),
+			       SHELL_CMD(load, NULL, "Load certificate by number or CN",
+					 cmd_tmo_cert_load),
 #if CONFIG_MODEM
 			       SHELL_CMD(modem_load, NULL, "Send loaded certificate to modem",
 					 cmd_tmo_cert_modem_load),
@@ -2965,7 +3543,14 @@ SHELL_STATIC_SUBCMD_SET_CREATE(
 	SHELL_SUBCMD_SET_END);
 #endif
 
-SHELL_STATIC_SUBCMD_SET_CREATE(tmo_file_sub, SHELL_CMD(cp, NULL, "Copy a file", tmo_cp),
+SHELL_STATIC_SUBCMD_SET_CREATE(tmo_file_sub,
+			       SHELL_CMD(bench, NULL, "littlefs benchmark, [directory] [file size KB]",
+					 tmo_file_bench),
+			       SHELL_CMD(cp, NULL, "Copy a file, [-v] <source> <destination>",
+					 tmo_cp),
+			       SHELL_CMD(hash, NULL,
+					 "Hash a file, [--bench] [-a sha1,sha256,crc32,mcrc32] <file>",
+					 cmd_hash),
 			       SHELL_CMD(ll, NULL, "Detailed file list", tmo_ll),
 			       SHELL_CMD(mv, NULL, "Move a file", tmo_mv),
 			       SHELL_CMD(sha1, NULL, "Compute a file SHA1", cmd_sha1),
@@ -2988,6 +3573,9 @@ SHELL_STATIC_SUBCMD_SET_CREATE(
 	SHELL_CMD(http, NULL, "Get http URL", cmd_http),
 	SHELL_CMD(hwid, NULL, "Read the HWID divider voltage", cmd_hwid),
 	SHELL_CMD(ifaces, NULL, "List network interfaces", cmd_list_ifaces),
+#if CONFIG_TMO_IPERF
+	SHELL_CMD(iperf, NULL, "TCP/UDP throughput test", cmd_iperf),
+#endif
 	SHELL_CMD(json, &tmo_json_sub, "JSON data options", NULL),
 #if CONFIG_TMO_SHELL_BUILD_EK
 	SHELL_CMD(kermit, NULL, "Embedded kermit", cmd_ekermit),
@@ -3002,8 +3590,13 @@ SHELL_STATIC_SUBCMD_SET_CREATE(
 #if CONFIG_PM_DEVICE
 	SHELL_CMD(pm, &sub_pm, "Device power management controls", NULL),
 #endif
+	SHELL_CMD(sensors, NULL, "Sensor cache status, <sensor> <period ms> | reset",
+		  cmd_sensors),
 	SHELL_CMD(sntp, NULL, "Retrieve the current time", cmd_sntp),
 	SHELL_CMD(sockets, NULL, "List open sockets", cmd_list_socks),
+#if CONFIG_TMO_SOCK_RX
+	SHELL_CMD(sockrx, NULL, "Background receive stats, [reset]", cmd_sock_rx),
+#endif
 #if CONFIG_PM
 	SHELL_CMD(sys_pm, &sub_sys_pm, "System power management controls", NULL),
 #endif
@@ -3047,6 +3640,10 @@ void tmo_shell_main(void)
 
 	// mount the flash file system
 	mountfs();
+#if CONFIG_TMO_TLM_QUEUE
+	/* Pick up telemetry queued before the reboot */
+	web_demo_queue_init();
+#endif
 
 	cxd5605_init();
 	initADC();
@@ -10,6 +10,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <zephyr/net/net_if.h>
+#include <zephyr/shell/shell.h>
 #include <errno.h>
 
 #define MAX_MODEM_SOCKS	5
@@ -83,4 +84,24 @@ int show_enabled(const struct shell *shell, size_t argc, char *argv[]);
 void tmo_shell_main(void);
 int tmo_offload_init(int devid);
 
+/**
+ * @brief Finds an open socket created through the shell
+ *
+ * @param sd The socket descriptor
+ * @return struct sock_rec_s* The socket record or NULL if not found
+ */
+struct sock_rec_s *tmo_sock_find(int sd);
+
+/**
+ * @brief Parses a non-negative decimal shell argument, reporting a bad one
+ *
+ * @param shell Shell to report errors on
+ * @param arg The argument
+ * @param val Receives the value
+ * @return int 0 on success, -EINVAL if arg is not a non-negative integer
+ */
+int tmo_parse_uint(const struct shell *shell, const char *arg, uint32_t *val);
+
+extern struct sock_rec_s socks[MAX_SOCK_REC];
+
 #endif
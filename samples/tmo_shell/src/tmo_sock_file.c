@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * File transfer over the shell sockets. sendfile streams the file through
+ * the file copy engine, so the next flash read overlaps the current socket
+ * send. recvfile gathers socket data into a large buffer and only writes it
+ * to flash when it is full, keeping littlefs writes few and block sized.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fs.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/net/socket.h>
+
+#include "tmo_shell.h"
+#include "tmo_sock_file.h"
+#include "tmo_file_copy.h"
+#if CONFIG_TMO_SOCK_RX
+#include "tmo_sock_rx.h"
+#endif
+
+#define SOCK_FILE_CHUNK	    2048
+#define SOCK_FILE_IDLE_SECS 5
+
+extern uint8_t mxfer_buf[];
+extern int max_fragment;
+
+static int file_sock(const struct shell *shell, const char *arg, struct sock_rec_s **rec)
+{
+	uint32_t sd;
+
+	if (tmo_parse_uint(shell, arg, &sd)) {
+		return -EINVAL;
+	}
+	*rec = tmo_sock_find(sd);
+	if (*rec == NULL) {
+		shell_error(shell, "Socket %d not found", sd);
+		return -EINVAL;
+	}
+	if (!((*rec)->flags & BIT(sock_connected))) {
+		shell_error(shell, "Socket %d is not connected", sd);
+		return -EINVAL;
+	}
+	return sd;
+}
+
+static void print_rate(const struct shell *shell, const char *what, uint32_t bytes,
+		       int64_t elapsed_ms)
+{
+	shell_print(shell, "%s %u bytes in %lld ms (%u kbit/s)", what, bytes, elapsed_ms,
+		    elapsed_ms > 0 ? (uint32_t)((uint64_t)bytes * 8 / elapsed_ms) : 0);
+}
+
+static int send_all(int sd, const uint8_t *buf, int len, int frag)
+{
+	int sent = 0;
+
+	while (sent < len) {
+		int ret = zsock_send(sd, buf + sent, MIN(len - sent, frag), 0);
+
+		if (ret < 0) {
+			return -errno;
+		}
+		sent += ret;
+	}
+	return sent;
+}
+
+struct send_ctx {
+	int sd;
+	int frag;
+};
+
+static int send_sink(void *ctx, const uint8_t *buf, size_t len)
+{
+	struct send_ctx *send = ctx;
+
+	return send_all(send->sd, buf, len, send->frag);
+}
+
+int sock_sendfile(const struct shell *shell, size_t argc, char **argv)
+{
+	struct sock_rec_s *rec;
+	struct fs_dirent entry;
+	struct tmo_file_xfer st;
+	struct send_ctx send;
+	int ret;
+
+	if (argc < 3) {
+		shell_error(shell, "Missing required arguments");
+		shell_print(shell, "Usage: <socket> <file>");
+		return -EINVAL;
+	}
+	send.sd = file_sock(shell, argv[1], &rec);
+	if (send.sd < 0) {
+		return send.sd;
+	}
+	if (fs_stat(argv[2], &entry) || entry.type != FS_DIR_ENTRY_FILE) {
+		shell_error(shell, "%s is not a file", argv[2]);
+		return -ENOENT;
+	}
+	/* Datagram sockets send the file in xfersz sized datagrams */
+	send.frag = (rec->flags & (BIT(sock_udp) | BIT(sock_dtls))) ? max_fragment
+								     : CONFIG_TMO_FILE_COPY_BUF_SIZE;
+	shell_print(shell, "Sending %s, %u bytes", argv[2], (uint32_t)entry.size);
+
+	ret = tmo_file_stream(argv[2], send_sink, &send, &st);
+	if (ret < 0) {
+		shell_error(shell, "sendfile failed, err = %d", ret);
+	}
+	print_rate(shell, "Sent", st.bytes, st.elapsed_ms);
+	return ret;
+}
+
+/* Waits up to idle_ms for data, preferring what the receive engine queued */
+static int recv_wait(int sd, uint8_t *buf, size_t len, int idle_ms)
+{
+	struct zsock_pollfd pfd = {.fd = sd, .events = ZSOCK_POLLIN};
+	int ret;
+
+#if CONFIG_TMO_SOCK_RX
+	ret = tmo_sock_rx_recvfrom(sd, buf, len, NULL);
+	if (ret != -ENOENT && ret != -EAGAIN) {
+		return ret;
+	}
+#endif
+	ret = zsock_poll(&pfd, 1, idle_ms);
+	if (ret <= 0) {
+		return ret < 0 ? -errno : -ETIMEDOUT;
+	}
+	ret = zsock_recv(sd, buf, len, 0);
+	return ret < 0 ? -errno : ret;
+}
+
+static int flush_buf(const struct shell *shell, struct fs_file_t *file, int len)
+{
+	int ret = fs_write(file, mxfer_buf, len);
+
+	if (ret != len) {
+		shell_error(shell, "file write failed, err = %d", ret);
+		return ret < 0 ? ret : -ENOSPC;
+	}
+	return 0;
+}
+
+int sock_recvfile(const struct shell *shell, size_t argc, char **argv)
+{
+	struct sock_rec_s *rec;
+	struct fs_file_t file;
+	uint32_t total = 0, writes = 0;
+	uint32_t idle_s = SOCK_FILE_IDLE_SECS;
+	int64_t start = 0, last = 0;
+	int fill = 0;
+	int sd, ret = 0;
+
+	if (argc < 3) {
+		shell_error(shell, "Missing required arguments");
+		shell_print(shell, "Usage: <socket> <file> [idle timeout (seconds)]");
+		return -EINVAL;
+	}
+	sd = file_sock(shell, argv[1], &rec);
+	if (sd < 0) {
+		return sd;
+	}
+	if (argc > 3 && tmo_parse_uint(shell, argv[3], &idle_s)) {
+		return -EINVAL;
+	}
+	if (idle_s == 0) {
+		shell_error(shell, "Idle timeout must be at least 1 s");
+		return -EINVAL;
+	}
+	fs_file_t_init(&file);
+	if (fs_open(&file, argv[2], FS_O_CREATE | FS_O_WRITE)) {
+		shell_error(shell, "cannot open %s", argv[2]);
+		return -EIO;
+	}
+	fs_truncate(&file, 0);
+	shell_print(shell, "Receiving into %s, stops after %u s without data", argv[2], idle_s);
+
+#if CONFIG_TMO_SOCK_RX
+	/* Keep what already arrived, read the rest straight from the socket */
+	tmo_sock_rx_claim(sd, false);
+#endif
+	while (true) {
+		ret = recv_wait(sd, mxfer_buf + fill, SOCK_FILE_CHUNK * 2 - fill,
+				idle_s * MSEC_PER_SEC);
+		if (ret <= 0) {
+			break;
+		}
+		last = k_uptime_get();
+		if (!start) {
+			start = last;
+		}
+		fill += ret;
+		total += ret;
+		/* Coalesce reads into writes of at least a chunk, leaving room for a
+		 * whole datagram in the buffer
+		 */
+		if (fill >= SOCK_FILE_CHUNK) {
+			ret = flush_buf(shell, &file, fill);
+			if (ret) {
+				break;
+			}
+			writes++;
+			fill = 0;
+		}
+	}
+#if CONFIG_TMO_SOCK_RX
+	tmo_sock_rx_release(sd);
+#endif
+	if (fill && flush_buf(shell, &file, fill) == 0) {
+		writes++;
+	}
+	fs_close(&file);
+
+	if (ret < 0 && ret != -ETIMEDOUT) {
+		shell_error(shell, "recv failed, err = %d", ret);
+	}
+	print_rate(shell, "Received", total, last - start);
+	shell_print(shell, "%u file writes", writes);
+	return (ret < 0 && ret != -ETIMEDOUT) ? ret : 0;
+}
@@ -0,0 +1,14 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TMO_SOCK_FILE_H
+#define TMO_SOCK_FILE_H
+#include <zephyr/shell/shell.h>
+
+int sock_sendfile(const struct shell *shell, size_t argc, char **argv);
+int sock_recvfile(const struct shell *shell, size_t argc, char **argv);
+
+#endif
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Application level round trip time against an echo server, over any
+ * connected shell socket (TCP, TLS, UDP or DTLS). Each exchange carries its
+ * sequence number so late UDP replies are not matched to the wrong request.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "tmo_shell.h"
+#include "tmo_histogram.h"
+#include "tmo_sock_rtt.h"
+#if CONFIG_TMO_SOCK_RX
+#include "tmo_sock_rx.h"
+#endif
+
+#define RTT_MAX_SIZE	       1400
+#define RTT_DEFAULT_TIMEOUT_MS 5000
+
+static uint8_t rtt_tx[RTT_MAX_SIZE];
+static uint8_t rtt_rx[RTT_MAX_SIZE];
+
+/* Waits for the echo of request seq. Returns 0, -ETIMEDOUT or -errno */
+static int rtt_wait_echo(int sd, bool stream, uint32_t seq, size_t size, int64_t deadline,
+			 uint32_t *stale)
+{
+	struct zsock_pollfd pfd = {.fd = sd, .events = ZSOCK_POLLIN};
+	size_t got = 0;
+
+	while (got < size) {
+		int64_t left = deadline - k_uptime_get();
+		int ret;
+
+		if (left <= 0 || zsock_poll(&pfd, 1, left) <= 0) {
+			return -ETIMEDOUT;
+		}
+		ret = zsock_recv(sd, rtt_rx + (stream ? got : 0), stream ? size - got : size, 0);
+		if (ret <= 0) {
+			return ret < 0 ? -errno : -ECONNRESET;
+		}
+		if (stream) {
+			got += ret;
+		} else if (ret >= sizeof(seq) && sys_get_be32(rtt_rx) == seq) {
+			got = size;
+		} else {
+			/* Reply to an earlier, timed out request */
+			(*stale)++;
+		}
+	}
+	return 0;
+}
+
+int sock_rtt(const struct shell *shell, size_t argc, char **argv)
+{
+	static struct tmo_histogram hist;
+	struct sock_rec_s *rec;
+	uint32_t count, size, timeout_ms = RTT_DEFAULT_TIMEOUT_MS;
+	uint32_t timeouts = 0, stale = 0;
+	bool stream;
+	int sd;
+
+	if (argc < 4) {
+		shell_error(shell, "Missing required arguments");
+		shell_print(shell, "Usage: <socket> <count> <size> [timeout ms]\n"
+				   "       socket must be connected to an echo server");
+		return -EINVAL;
+	}
+	sd = strtol(argv[1], NULL, 10);
+	rec = tmo_sock_find(sd);
+	if (rec == NULL) {
+		shell_error(shell, "Socket %d not found", sd);
+		return -EINVAL;
+	}
+	if (!(rec->flags & BIT(sock_connected))) {
+		shell_error(shell, "Socket %d is not connected", sd);
+		return -EINVAL;
+	}
+	if (tmo_parse_uint(shell, argv[2], &count) || tmo_parse_uint(shell, argv[3], &size) ||
+	    (argc > 4 && tmo_parse_uint(shell, argv[4], &timeout_ms))) {
+		return -EINVAL;
+	}
+	size = CLAMP(size, sizeof(uint32_t), sizeof(rtt_tx));
+	stream = rec->flags & (BIT(sock_tcp) | BIT(sock_tls));
+
+#if CONFIG_TMO_SOCK_RX
+	tmo_sock_rx_claim(sd, true);
+#endif
+	/* Drop anything left over from earlier commands */
+	while (zsock_recv(sd, rtt_rx, sizeof(rtt_rx), ZSOCK_MSG_DONTWAIT) > 0) {
+	}
+
+	tmo_histogram_reset(&hist);
+	gen_payload(rtt_tx, size);
+	for (uint32_t seq = 0; seq < count; seq++) {
+		uint32_t start;
+		int ret;
+
+		sys_put_be32(seq, rtt_tx);
+		start = k_cycle_get_32();
+		if (zsock_send(sd, rtt_tx, size, 0) != size) {
+			shell_error(shell, "send failed, errno = %d", errno);
+			break;
+		}
+		ret = rtt_wait_echo(sd, stream, seq, size, k_uptime_get() + timeout_ms, &stale);
+		if (ret == -ETIMEDOUT) {
+			timeouts++;
+			if (stream) {
+				/* The late echo would be taken for the reply to the next request */
+				shell_error(shell, "No echo of %u within %u ms, stopping", seq,
+					    timeout_ms);
+				break;
+			}
+			continue;
+		} else if (ret < 0) {
+			shell_error(shell, "recv failed, err = %d", ret);
+			break;
+		}
+		tmo_histogram_add(&hist, k_cyc_to_us_floor32(k_cycle_get_32() - start));
+		if (stream && memcmp(rtt_tx, rtt_rx, size)) {
+			shell_warn(shell, "Echo %u does not match the request", seq);
+		}
+	}
+#if CONFIG_TMO_SOCK_RX
+	tmo_sock_rx_release(sd);
+#endif
+
+	shell_print(shell, "%u exchanges of %u bytes, %u replies, %u timeouts, %u stale", count,
+		    size, hist.count, timeouts, stale);
+	if (hist.count) {
+		shell_print(shell, "rtt min/avg/max = %u/%u/%u us", hist.min,
+			    tmo_histogram_avg(&hist), hist.max);
+		shell_print(shell, "p50 %u us, p90 %u us, p95 %u us, p99 %u us",
+			    tmo_histogram_percentile(&hist, 50), tmo_histogram_percentile(&hist, 90),
+			    tmo_histogram_percentile(&hist, 95), tmo_histogram_percentile(&hist, 99));
+		for (int b = 0; b < TMO_HISTOGRAM_BUCKETS; b++) {
+			if (hist.buckets[b]) {
+				shell_print(shell, "  < %8u us: %u", b ? (1U << b) : 1,
+					    hist.buckets[b]);
+			}
+		}
+	}
+	return hist.count ? 0 : -ETIMEDOUT;
+}
@@ -0,0 +1,13 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TMO_SOCK_RTT_H
+#define TMO_SOCK_RTT_H
+#include <zephyr/shell/shell.h>
+
+int sock_rtt(const struct shell *shell, size_t argc, char **argv);
+
+#endif
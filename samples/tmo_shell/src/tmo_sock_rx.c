@@ -0,0 +1,374 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Background receive engine for the shell sockets. The shell registers a
+ * socket once it is connected or bound, and a thread polls every registered
+ * socket and drains it into a ring of its own, so data arriving between shell
+ * commands is not left to the small offload driver buffers. Rings come from a
+ * pool of CONFIG_TMO_SOCK_RX_RINGS; sockets registered beyond that are read
+ * directly by the shell as before. Stream data is only read while there is
+ * room in the ring, leaving flow control to TCP. Datagrams are queued whole
+ * with their source address and dropped, and counted, when they do not fit.
+ * Datagrams over CONFIG_TMO_SOCK_RX_DGRAM_MAX are truncated and counted.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/sys/ring_buffer.h>
+
+#include "tmo_shell.h"
+#include "tmo_sock_rx.h"
+
+#define SOCK_RX_STACK_SIZE 2048
+#define SOCK_RX_PRIORITY   CONFIG_MAIN_THREAD_PRIORITY
+#define SOCK_RX_DGRAM_MAX  CONFIG_TMO_SOCK_RX_DGRAM_MAX
+#define SOCK_RX_SLOTS	   CONFIG_TMO_SOCK_RX_RINGS
+
+/* Header queued in front of every datagram */
+struct sock_rx_dgram {
+	uint16_t len;
+	struct sockaddr from;
+};
+
+struct sock_rx_slot {
+	struct ring_buf rb;
+	struct tmo_sock_rx_stats st;
+	struct net_if *dev;
+	bool dgram;
+	bool active;
+};
+
+BUILD_ASSERT(CONFIG_TMO_SOCK_RX_BUF_SIZE >= SOCK_RX_DGRAM_MAX + sizeof(struct sock_rx_dgram),
+	     "Receive ring cannot hold a full size datagram");
+
+static uint8_t rx_mem[SOCK_RX_SLOTS][CONFIG_TMO_SOCK_RX_BUF_SIZE];
+static struct sock_rx_slot rx_slots[SOCK_RX_SLOTS];
+/* One byte over the largest datagram, so a longer one shows as truncated.
+ * Only used by the engine thread.
+ */
+static uint8_t rx_chunk[SOCK_RX_DGRAM_MAX + 1];
+
+/* Guards rx_slots. Not held across the socket calls, so readers do not wait
+ * on the offload driver.
+ */
+K_MUTEX_DEFINE(sock_rx_lock);
+/* Held by the engine across each poll and the reads that follow it. Claiming
+ * or closing a socket takes it first, so once either returns the engine is
+ * not inside a call on that socket and will not start one.
+ */
+K_MUTEX_DEFINE(sock_rx_io_lock);
+
+/* Must be called with sock_rx_lock held */
+static struct sock_rx_slot *slot_find(int sd)
+{
+	for (int i = 0; i < SOCK_RX_SLOTS; i++) {
+		if (rx_slots[i].active && rx_slots[i].st.sd == sd) {
+			return &rx_slots[i];
+		}
+	}
+	return NULL;
+}
+
+/* Must be called with sock_rx_lock held */
+static bool slot_pollable(struct sock_rx_slot *slot)
+{
+	if (!slot->active || slot->st.claimed || slot->st.eof) {
+		return false;
+	}
+	/* Leave stream data in the socket until the reader makes room */
+	return slot->dgram || ring_buf_space_get(&slot->rb) > 0;
+}
+
+/* Called with sock_rx_io_lock held, so the slot cannot be claimed or closed */
+static void slot_drain(struct sock_rx_slot *slot, bool dgram, size_t space)
+{
+	struct sock_rx_dgram hdr = {0};
+	socklen_t fromlen = sizeof(hdr.from);
+	bool truncated = false;
+	int sd = slot->st.sd;
+	int ret;
+
+	if (dgram) {
+		ret = zsock_recvfrom(sd, rx_chunk, sizeof(rx_chunk), ZSOCK_MSG_DONTWAIT,
+				     &hdr.from, &fromlen);
+		if (ret > SOCK_RX_DGRAM_MAX) {
+			truncated = true;
+			ret = SOCK_RX_DGRAM_MAX;
+		}
+	} else {
+		ret = zsock_recv(sd, rx_chunk, MIN(sizeof(rx_chunk), space), ZSOCK_MSG_DONTWAIT);
+	}
+	if (ret < 0) {
+		return;
+	}
+
+	k_mutex_lock(&sock_rx_lock, K_FOREVER);
+	if (dgram) {
+		hdr.len = ret;
+		slot->st.truncated += truncated;
+		if (ring_buf_space_get(&slot->rb) < sizeof(hdr) + ret) {
+			slot->st.drops++;
+			slot->st.drop_bytes += ret;
+			k_mutex_unlock(&sock_rx_lock);
+			return;
+		}
+		ring_buf_put(&slot->rb, (uint8_t *)&hdr, sizeof(hdr));
+		slot->st.datagrams++;
+	} else if (ret == 0) {
+		slot->st.eof = true;
+		k_mutex_unlock(&sock_rx_lock);
+		return;
+	}
+	/* Ring space only grows while unlocked, so stream data always fits */
+	ring_buf_put(&slot->rb, rx_chunk, ret);
+	slot->st.bytes += ret;
+	slot->st.used = ring_buf_size_get(&slot->rb);
+	slot->st.hwm = MAX(slot->st.hwm, slot->st.used);
+	k_mutex_unlock(&sock_rx_lock);
+}
+
+static void sock_rx_thread(void *a, void *b, void *c)
+{
+	struct zsock_pollfd fds[SOCK_RX_SLOTS];
+	struct sock_rx_slot *polled[SOCK_RX_SLOTS];
+
+	for (int i = 0; i < SOCK_RX_SLOTS; i++) {
+		ring_buf_init(&rx_slots[i].rb, sizeof(rx_mem[i]), rx_mem[i]);
+	}
+
+	while (true) {
+		struct net_if *ifaces[SOCK_RX_SLOTS];
+		int niface = 0;
+
+		k_mutex_lock(&sock_rx_lock, K_FOREVER);
+		for (int i = 0; i < SOCK_RX_SLOTS; i++) {
+			if (slot_pollable(&rx_slots[i])) {
+				bool seen = false;
+
+				for (int j = 0; j < niface; j++) {
+					seen |= ifaces[j] == rx_slots[i].dev;
+				}
+				if (!seen) {
+					ifaces[niface++] = rx_slots[i].dev;
+				}
+			}
+		}
+		k_mutex_unlock(&sock_rx_lock);
+
+		/* A poll call can only span sockets of one offload driver */
+		for (int f = 0; f < niface; f++) {
+			int n = 0;
+
+			k_mutex_lock(&sock_rx_io_lock, K_FOREVER);
+			k_mutex_lock(&sock_rx_lock, K_FOREVER);
+			for (int i = 0; i < SOCK_RX_SLOTS; i++) {
+				if (rx_slots[i].dev == ifaces[f] && slot_pollable(&rx_slots[i])) {
+					fds[n].fd = rx_slots[i].st.sd;
+					fds[n].events = ZSOCK_POLLIN;
+					fds[n].revents = 0;
+					polled[n++] = &rx_slots[i];
+				}
+			}
+			k_mutex_unlock(&sock_rx_lock);
+			if (n == 0 ||
+			    zsock_poll(fds, n, CONFIG_TMO_SOCK_RX_POLL_MS / niface) <= 0) {
+				k_mutex_unlock(&sock_rx_io_lock);
+				continue;
+			}
+
+			for (int k = 0; k < n; k++) {
+				struct sock_rx_slot *slot = polled[k];
+				bool dgram;
+				size_t space;
+
+				if (!(fds[k].revents & ZSOCK_POLLIN)) {
+					if (fds[k].revents & (ZSOCK_POLLHUP | ZSOCK_POLLERR |
+							      ZSOCK_POLLNVAL)) {
+						k_mutex_lock(&sock_rx_lock, K_FOREVER);
+						slot->st.eof = true;
+						k_mutex_unlock(&sock_rx_lock);
+					}
+					continue;
+				}
+				k_mutex_lock(&sock_rx_lock, K_FOREVER);
+				dgram = slot->dgram;
+				space = ring_buf_space_get(&slot->rb);
+				k_mutex_unlock(&sock_rx_lock);
+				slot_drain(slot, dgram, space);
+			}
+			k_mutex_unlock(&sock_rx_io_lock);
+		}
+		if (niface == 0) {
+			k_msleep(CONFIG_TMO_SOCK_RX_POLL_MS);
+		}
+	}
+}
+
+K_THREAD_DEFINE(sock_rx_tid, SOCK_RX_STACK_SIZE,
+		sock_rx_thread, NULL, NULL, NULL,
+		SOCK_RX_PRIORITY, 0, 0);
+
+int tmo_sock_rx_add(int sd, struct net_if *dev, bool dgram)
+{
+	struct sock_rx_slot *slot;
+	int ret = 0;
+
+	k_mutex_lock(&sock_rx_lock, K_FOREVER);
+	/* Already registered, e.g. bound and then connected */
+	slot = slot_find(sd);
+	for (int i = 0; i < SOCK_RX_SLOTS && slot == NULL; i++) {
+		if (!rx_slots[i].active) {
+			slot = &rx_slots[i];
+			ring_buf_reset(&slot->rb);
+			memset(&slot->st, 0, sizeof(slot->st));
+			slot->st.sd = sd;
+			slot->dev = dev;
+			slot->dgram = dgram;
+			slot->active = true;
+		}
+	}
+	if (slot == NULL) {
+		ret = -ENOMEM;
+	}
+	k_mutex_unlock(&sock_rx_lock);
+	return ret;
+}
+
+int tmo_sock_rx_recvfrom(int sd, uint8_t *buf, size_t len, struct sockaddr *from)
+{
+	struct sock_rx_slot *slot;
+	int ret;
+
+	k_mutex_lock(&sock_rx_lock, K_FOREVER);
+	slot = slot_find(sd);
+	/* A claimed socket still hands out what was queued before the claim */
+	if (slot == NULL || (slot->st.claimed && ring_buf_is_empty(&slot->rb))) {
+		k_mutex_unlock(&sock_rx_lock);
+		return -ENOENT;
+	}
+	if (ring_buf_is_empty(&slot->rb)) {
+		ret = slot->st.eof ? 0 : -EAGAIN;
+	} else if (slot->dgram) {
+		struct sock_rx_dgram hdr;
+
+		ring_buf_get(&slot->rb, (uint8_t *)&hdr, sizeof(hdr));
+		ret = ring_buf_get(&slot->rb, buf, MIN(len, hdr.len));
+		if (hdr.len > ret) {
+			ring_buf_get(&slot->rb, NULL, hdr.len - ret);
+		}
+		if (from) {
+			memcpy(from, &hdr.from, sizeof(hdr.from));
+		}
+	} else {
+		ret = ring_buf_get(&slot->rb, buf, len);
+	}
+	slot->st.used = ring_buf_size_get(&slot->rb);
+	k_mutex_unlock(&sock_rx_lock);
+	return ret;
+}
+
+void tmo_sock_rx_claim(int sd, bool discard)
+{
+	struct sock_rx_slot *slot;
+
+	k_mutex_lock(&sock_rx_io_lock, K_FOREVER);
+	k_mutex_lock(&sock_rx_lock, K_FOREVER);
+	slot = slot_find(sd);
+	if (slot) {
+		if (discard) {
+			ring_buf_reset(&slot->rb);
+			slot->st.used = 0;
+		}
+		slot->st.claimed = true;
+	}
+	k_mutex_unlock(&sock_rx_lock);
+	k_mutex_unlock(&sock_rx_io_lock);
+}
+
+void tmo_sock_rx_release(int sd)
+{
+	struct sock_rx_slot *slot;
+
+	k_mutex_lock(&sock_rx_lock, K_FOREVER);
+	slot = slot_find(sd);
+	if (slot) {
+		slot->st.claimed = false;
+	}
+	k_mutex_unlock(&sock_rx_lock);
+}
+
+void tmo_sock_rx_close(int sd)
+{
+	struct sock_rx_slot *slot;
+
+	k_mutex_lock(&sock_rx_io_lock, K_FOREVER);
+	k_mutex_lock(&sock_rx_lock, K_FOREVER);
+	slot = slot_find(sd);
+	if (slot) {
+		ring_buf_reset(&slot->rb);
+		slot->active = false;
+	}
+	k_mutex_unlock(&sock_rx_lock);
+	k_mutex_unlock(&sock_rx_io_lock);
+}
+
+int tmo_sock_rx_get_stats(struct tmo_sock_rx_stats *st, int max)
+{
+	int n = 0;
+
+	k_mutex_lock(&sock_rx_lock, K_FOREVER);
+	for (int i = 0; i < SOCK_RX_SLOTS && n < max; i++) {
+		if (rx_slots[i].active) {
+			st[n++] = rx_slots[i].st;
+		}
+	}
+	k_mutex_unlock(&sock_rx_lock);
+	return n;
+}
+
+void tmo_sock_rx_reset_stats(void)
+{
+	k_mutex_lock(&sock_rx_lock, K_FOREVER);
+	for (int i = 0; i < SOCK_RX_SLOTS; i++) {
+		struct tmo_sock_rx_stats *st = &rx_slots[i].st;
+
+		st->bytes = st->datagrams = st->drops = st->drop_bytes = st->truncated = 0;
+		st->hwm = st->used;
+	}
+	k_mutex_unlock(&sock_rx_lock);
+}
+
+int cmd_sock_rx(const struct shell *shell, size_t argc, char **argv)
+{
+	static struct tmo_sock_rx_stats st[SOCK_RX_SLOTS];
+	int n;
+
+	if (argc > 1 && !strcmp(argv[1], "reset")) {
+		tmo_sock_rx_reset_stats();
+		shell_print(shell, "Receive stats reset");
+		return 0;
+	} else if (argc > 1) {
+		shell_error(shell, "Unknown argument %s", argv[1]);
+		return -EINVAL;
+	}
+
+	n = tmo_sock_rx_get_stats(st, ARRAY_SIZE(st));
+	shell_print(shell, "%d rings of %d bytes, datagrams truncated over %d bytes",
+		    SOCK_RX_SLOTS, CONFIG_TMO_SOCK_RX_BUF_SIZE, SOCK_RX_DGRAM_MAX);
+	shell_print(shell, "%4s %10s %8s %6s %10s %6s %6s %6s %s", "sd", "bytes", "dgrams",
+		    "drops", "drop bytes", "trunc", "used", "hwm", "state");
+	for (int i = 0; i < n; i++) {
+		shell_print(shell, "%4d %10u %8u %6u %10u %6u %6u %6u %s", st[i].sd, st[i].bytes,
+			    st[i].datagrams, st[i].drops, st[i].drop_bytes, st[i].truncated,
+			    st[i].used, st[i].hwm,
+			    st[i].claimed ? "claimed" : st[i].eof ? "closed" : "active");
+	}
+	return 0;
+}
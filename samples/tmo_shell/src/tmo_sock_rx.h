@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TMO_SOCK_RX_H
+#define TMO_SOCK_RX_H
+
+#include <stdint.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/shell/shell.h>
+
+struct tmo_sock_rx_stats {
+	int sd;
+	/* Bytes and datagrams moved from the socket into the ring */
+	uint32_t bytes;
+	uint32_t datagrams;
+	/* Datagrams (and their bytes) discarded because the ring was full */
+	uint32_t drops;
+	uint32_t drop_bytes;
+	/* Datagrams cut to CONFIG_TMO_SOCK_RX_DGRAM_MAX */
+	uint32_t truncated;
+	/* Bytes currently queued and the most ever queued */
+	uint32_t used;
+	uint32_t hwm;
+	bool eof;
+	bool claimed;
+};
+
+/**
+ * @brief Hands a connected or bound shell socket to the receive engine
+ *
+ * @param sd The socket descriptor
+ * @param dev The interface the socket belongs to
+ * @param dgram Queue whole datagrams rather than a byte stream
+ * @return int 0 on success (including already registered), -ENOMEM if every
+ * ring is in use, in which case the shell reads the socket directly
+ */
+int tmo_sock_rx_add(int sd, struct net_if *dev, bool dgram);
+
+/**
+ * @brief Reads data the receive engine queued for a shell socket
+ *
+ * Stream sockets return up to len bytes. Datagram sockets return a single
+ * datagram, truncated to len, and its source address when from is not NULL.
+ *
+ * @param sd The socket descriptor
+ * @param buf Destination buffer
+ * @param len Size of buf
+ * @param from Optional source address of the datagram
+ * @return int Bytes read, 0 if the peer closed the socket, -EAGAIN if nothing
+ * is queued, -ENOENT if the engine does not own the socket (read it directly)
+ */
+int tmo_sock_rx_recvfrom(int sd, uint8_t *buf, size_t len, struct sockaddr *from);
+
+/**
+ * @brief Takes a socket away from the receive engine
+ *
+ * For commands that read the socket themselves. Waits for the engine to
+ * finish any poll or read in progress, up to CONFIG_TMO_SOCK_RX_POLL_MS.
+ * Unless discarded, data queued before the claim is still returned by
+ * tmo_sock_rx_recvfrom(), which reports -ENOENT once it is used up.
+ *
+ * @param sd The socket descriptor
+ * @param discard Drop the data already queued
+ */
+void tmo_sock_rx_claim(int sd, bool discard);
+
+/**
+ * @brief Hands a claimed socket back to the receive engine
+ *
+ * @param sd The socket descriptor
+ */
+void tmo_sock_rx_release(int sd);
+
+/**
+ * @brief Drops the ring of a closed socket
+ *
+ * Claim the socket before closing it so the engine is not reading it.
+ *
+ * @param sd The socket descriptor
+ */
+void tmo_sock_rx_close(int sd);
+
+int tmo_sock_rx_get_stats(struct tmo_sock_rx_stats *st, int max);
+
+void tmo_sock_rx_reset_stats(void);
+
+int cmd_sock_rx(const struct shell *shell, size_t argc, char **argv);
+
+#endif
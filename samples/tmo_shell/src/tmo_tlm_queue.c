@@ -0,0 +1,357 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Store-and-forward queue of telemetry records in littlefs. Records are
+ * appended to numbered segment files and consumed from the oldest one; a
+ * segment is only ever appended to and is deleted once drained, so nothing
+ * is rewritten in place. The read position inside the oldest segment is
+ * kept in RAM, so after a reboot a partly drained segment is sent again
+ * (at-least-once delivery). Record timestamps are uptime, so the age of
+ * records left from a previous boot is counted from this boot.
+ *
+ * Every segment starts with a header giving the record size it was written
+ * with. Segments left by an image with a different record layout are
+ * discarded at init rather than read back misaligned.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/fs/fs.h>
+
+#include "tmo_tlm_queue.h"
+
+#define SEG_RECORDS CONFIG_TMO_TLM_QUEUE_SEG_RECORDS
+#define MAX_SEGS    CONFIG_TMO_TLM_QUEUE_MAX_SEGMENTS
+#define QUEUE_DIR   CONFIG_TMO_TLM_QUEUE_DIR
+
+#define SEG_MAGIC   0x544c4d51 /* "TLMQ" */
+#define SEG_VERSION 1
+
+struct seg_hdr {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t rec_size;
+};
+
+K_MUTEX_DEFINE(queue_lock);
+
+static size_t rec_size;
+static bool have_seg;
+static uint32_t tail_seq;
+static uint32_t head_seq;
+static int tail_off;
+static int head_count;
+static int64_t oldest_ts;
+static int64_t init_ts;
+static uint32_t prior_left;
+static struct tmo_tlm_queue_stats stats;
+
+static void seg_name(char *buf, size_t len, uint32_t seq)
+{
+	snprintf(buf, len, "%s/%08x.seg", QUEUE_DIR, seq);
+}
+
+static size_t entry_size(void)
+{
+	return sizeof(int64_t) + rec_size;
+}
+
+static off_t entry_off(int idx)
+{
+	return sizeof(struct seg_hdr) + idx * entry_size();
+}
+
+/* Records in a segment of the given size, the header not counted */
+static int seg_records(size_t size)
+{
+	return size < sizeof(struct seg_hdr) ? 0 : (size - sizeof(struct seg_hdr)) / entry_size();
+}
+
+static bool seg_valid(const char *name)
+{
+	struct fs_file_t file;
+	struct seg_hdr hdr;
+	bool valid = false;
+
+	fs_file_t_init(&file);
+	if (fs_open(&file, name, FS_O_READ) == 0) {
+		valid = fs_read(&file, &hdr, sizeof(hdr)) == sizeof(hdr) &&
+			hdr.magic == SEG_MAGIC && hdr.version == SEG_VERSION &&
+			hdr.rec_size == rec_size;
+		fs_close(&file);
+	}
+	return valid;
+}
+
+int tmo_tlm_queue_init(size_t size)
+{
+	struct fs_dirent entry;
+	struct fs_dir_t dir;
+	int ret;
+
+	k_mutex_lock(&queue_lock, K_FOREVER);
+	if (rec_size) {
+		k_mutex_unlock(&queue_lock);
+		return 0;
+	}
+
+	if (fs_stat(QUEUE_DIR, &entry) == -ENOENT) {
+		ret = fs_mkdir(QUEUE_DIR);
+		if (ret) {
+			k_mutex_unlock(&queue_lock);
+			return ret;
+		}
+	}
+
+	rec_size = size;
+	fs_dir_t_init(&dir);
+	ret = fs_opendir(&dir, QUEUE_DIR);
+	if (ret) {
+		rec_size = 0;
+		k_mutex_unlock(&queue_lock);
+		return ret;
+	}
+	while (fs_readdir(&dir, &entry) == 0 && entry.name[0] != 0) {
+		char name[48];
+		char *end;
+		uint32_t seq = strtoul(entry.name, &end, 16);
+
+		if (entry.type != FS_DIR_ENTRY_FILE || strcmp(end, ".seg")) {
+			continue;
+		}
+		seg_name(name, sizeof(name), seq);
+		if (!seg_valid(name)) {
+			/* Written with another record layout, or torn before the header */
+			fs_unlink(name);
+			stats.discarded++;
+			continue;
+		}
+		if (!have_seg) {
+			tail_seq = head_seq = seq;
+			have_seg = true;
+		}
+		tail_seq = MIN(tail_seq, seq);
+		if (seq >= head_seq) {
+			head_seq = seq;
+			head_count = seg_records(entry.size);
+			/* A torn last record would misalign appends, start a new segment */
+			if ((entry.size - sizeof(struct seg_hdr)) % entry_size()) {
+				head_count = SEG_RECORDS;
+			}
+		}
+		stats.queued += seg_records(entry.size);
+	}
+	fs_closedir(&dir);
+	stats.segments = have_seg ? head_seq - tail_seq + 1 : 0;
+	init_ts = oldest_ts = k_uptime_get();
+	prior_left = stats.queued;
+	k_mutex_unlock(&queue_lock);
+	return 0;
+}
+
+static void drop_tail(void)
+{
+	char name[48];
+
+	seg_name(name, sizeof(name), tail_seq);
+	fs_unlink(name);
+	if (tail_seq == head_seq) {
+		have_seg = false;
+		head_count = 0;
+	} else {
+		tail_seq++;
+	}
+	tail_off = 0;
+	stats.segments = have_seg ? head_seq - tail_seq + 1 : 0;
+}
+
+/* Records still unread in the oldest segment */
+static int tail_records(void)
+{
+	struct fs_dirent entry;
+	char name[48];
+
+	if (tail_seq == head_seq) {
+		return head_count - tail_off;
+	}
+	seg_name(name, sizeof(name), tail_seq);
+	if (fs_stat(name, &entry)) {
+		return 0;
+	}
+	return seg_records(entry.size) - tail_off;
+}
+
+/* Refresh oldest_ts from the first unread record */
+static void read_tail_ts(void)
+{
+	struct fs_file_t file;
+	char name[48];
+	int64_t ts;
+
+	if (prior_left) {
+		/* Uptime stamps from a previous boot mean nothing now */
+		oldest_ts = init_ts;
+		return;
+	}
+	if (!have_seg) {
+		return;
+	}
+	seg_name(name, sizeof(name), tail_seq);
+	fs_file_t_init(&file);
+	if (fs_open(&file, name, FS_O_READ) == 0) {
+		fs_seek(&file, entry_off(tail_off), FS_SEEK_SET);
+		if (fs_read(&file, &ts, sizeof(ts)) == sizeof(ts)) {
+			oldest_ts = ts;
+		}
+		fs_close(&file);
+	}
+}
+
+static void consumed(uint32_t cnt)
+{
+	prior_left -= MIN(cnt, prior_left);
+	stats.queued -= MIN(cnt, stats.queued);
+}
+
+int tmo_tlm_queue_push(const void *rec)
+{
+	struct fs_file_t file;
+	int64_t ts = k_uptime_get();
+	char name[48];
+	int ret;
+
+	if (!rec_size) {
+		return -ENODEV;
+	}
+	k_mutex_lock(&queue_lock, K_FOREVER);
+	if (!have_seg) {
+		head_seq++;
+		tail_seq = head_seq;
+		head_count = 0;
+		have_seg = true;
+		oldest_ts = ts;
+	} else if (head_count >= SEG_RECORDS) {
+		head_seq++;
+		head_count = 0;
+	}
+	stats.segments = head_seq - tail_seq + 1;
+	if (stats.segments > MAX_SEGS) {
+		int lost = MAX(tail_records(), 0);
+
+		stats.dropped += lost;
+		consumed(lost);
+		drop_tail();
+		read_tail_ts();
+	}
+
+	seg_name(name, sizeof(name), head_seq);
+	fs_file_t_init(&file);
+	ret = fs_open(&file, name, FS_O_CREATE | FS_O_APPEND | FS_O_WRITE);
+	if (ret == 0) {
+		struct seg_hdr hdr = {
+			.magic = SEG_MAGIC,
+			.version = SEG_VERSION,
+			.rec_size = rec_size,
+		};
+
+		/* A new segment, drop anything a crash left under its name */
+		if (head_count == 0 && (fs_truncate(&file, 0) ||
+				fs_write(&file, &hdr, sizeof(hdr)) != sizeof(hdr))) {
+			ret = -EIO;
+		} else if (fs_write(&file, &ts, sizeof(ts)) != sizeof(ts) ||
+				fs_write(&file, rec, rec_size) != rec_size) {
+			ret = -EIO;
+		}
+		fs_close(&file);
+	}
+	if (ret == 0) {
+		head_count++;
+		stats.queued++;
+	} else {
+		stats.dropped++;
+	}
+	k_mutex_unlock(&queue_lock);
+	return ret;
+}
+
+int tmo_tlm_queue_peek(void *recs, int max)
+{
+	struct fs_file_t file;
+	char name[48];
+	int cnt = 0;
+
+	if (!rec_size) {
+		return -ENODEV;
+	}
+	k_mutex_lock(&queue_lock, K_FOREVER);
+	/* Skip segments that are already fully drained */
+	while (have_seg && tail_records() <= 0) {
+		drop_tail();
+	}
+	if (!have_seg) {
+		k_mutex_unlock(&queue_lock);
+		return 0;
+	}
+
+	seg_name(name, sizeof(name), tail_seq);
+	fs_file_t_init(&file);
+	if (fs_open(&file, name, FS_O_READ) == 0) {
+		fs_seek(&file, entry_off(tail_off), FS_SEEK_SET);
+		while (cnt < max) {
+			int64_t ts;
+
+			if (fs_read(&file, &ts, sizeof(ts)) != sizeof(ts) ||
+					fs_read(&file, (uint8_t *)recs + cnt * rec_size,
+						rec_size) != rec_size) {
+				break;
+			}
+			cnt++;
+		}
+		fs_close(&file);
+	}
+	k_mutex_unlock(&queue_lock);
+	return cnt;
+}
+
+void tmo_tlm_queue_pop(int cnt)
+{
+	k_mutex_lock(&queue_lock, K_FOREVER);
+	tail_off += cnt;
+	stats.drained += cnt;
+	consumed(cnt);
+	if (have_seg && tail_records() <= 0) {
+		drop_tail();
+	}
+	read_tail_ts();
+	k_mutex_unlock(&queue_lock);
+}
+
+int tmo_tlm_queue_count(void)
+{
+	return stats.queued;
+}
+
+void tmo_tlm_queue_clear(void)
+{
+	k_mutex_lock(&queue_lock, K_FOREVER);
+	while (have_seg) {
+		drop_tail();
+	}
+	stats.dropped += stats.queued;
+	consumed(stats.queued);
+	k_mutex_unlock(&queue_lock);
+}
+
+void tmo_tlm_queue_get_stats(struct tmo_tlm_queue_stats *out)
+{
+	k_mutex_lock(&queue_lock, K_FOREVER);
+	memcpy(out, &stats, sizeof(stats));
+	out->oldest_age_ms = stats.queued ? k_uptime_get() - oldest_ts : -1;
+	k_mutex_unlock(&queue_lock);
+}
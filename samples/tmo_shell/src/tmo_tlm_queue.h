@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TMO_TLM_QUEUE_H
+#define TMO_TLM_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct tmo_tlm_queue_stats {
+	uint32_t queued;
+	uint32_t drained;
+	uint32_t dropped;
+	uint32_t segments;
+	/* Segments left by an image with another record layout */
+	uint32_t discarded;
+	/* Age of the oldest queued record, -1 when empty */
+	int64_t oldest_age_ms;
+};
+
+/**
+ * @brief Opens the queue, picking up segments left from a previous boot
+ *
+ * @param rec_size Size of every record pushed to the queue
+ * @return int 0 on success, -err on failure
+ */
+int tmo_tlm_queue_init(size_t rec_size);
+
+/**
+ * @brief Appends a record, dropping the oldest segment if the queue is full
+ */
+int tmo_tlm_queue_push(const void *rec);
+
+/**
+ * @brief Reads up to max records from the head of the queue without removing
+ * them
+ *
+ * @return int Number of records read, -err on failure
+ */
+int tmo_tlm_queue_peek(void *recs, int max);
+
+/**
+ * @brief Removes cnt records previously returned by tmo_tlm_queue_peek()
+ */
+void tmo_tlm_queue_pop(int cnt);
+
+int tmo_tlm_queue_count(void);
+void tmo_tlm_queue_clear(void);
+void tmo_tlm_queue_get_stats(struct tmo_tlm_queue_stats *stats);
+
+#endif
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * TLS credential manager. Every CA the shell talks to is registered once at
+ * boot under its own sec tag, along with the DTLS client certificate and
+ * key. TLS sockets are given the tags of the CAs their use trusts, so a
+ * connection neither accepts a server it never did before nor parses CAs it
+ * does not need. Downloads no longer delete and re-add a CA under
+ * CA_CERTIFICATE_TAG before each connection; that tag is only used for the
+ * CA loaded with 'tmo certs load'.
+ *
+ * Credentials are referenced, not copied, by the credential pool. The
+ * built in ones live in flash, the user CA in RAM.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/net/tls_credentials.h>
+#include <zephyr/shell/shell.h>
+#include <mbedtls/x509_crt.h>
+
+#include "ca_certificate.h"
+#include "tmo_tls_creds.h"
+
+struct tls_cred_rec {
+	const char *name;
+	sec_tag_t tag;
+	enum tls_credential_type type;
+	const uint8_t *buf;
+	size_t len;
+	/* BIT(enum tmo_tls_use) of the connections trusting this CA */
+	uint8_t uses;
+	bool registered;
+};
+
+#define USE(u) BIT(TMO_TLS_USE_##u)
+
+/* DFU hosts under this domain chain to Entrust, the others to DigiCert */
+#define DFU_TMO_DOMAIN "t-mobile.com"
+
+static struct tls_cred_rec creds[] = {
+	{"entrust_g2", ENTRUST_G2_CA_TAG, TLS_CREDENTIAL_CA_CERTIFICATE, entrust_g2,
+	 sizeof(entrust_g2), USE(JSON) | USE(DFU)},
+	{"digicert_ca", DIGICERT_CA_TAG, TLS_CREDENTIAL_CA_CERTIFICATE, digicert_ca,
+	 sizeof(digicert_ca), USE(DFU) | USE(CERTS)},
+	/* The echo-apps test server certificate */
+	{"dev_cert_ca", DEV_CERT_CA_TAG, TLS_CREDENTIAL_CA_CERTIFICATE, dev_certificate,
+	 sizeof(dev_certificate), USE(HTTP)},
+	{"dev_cert", CLIENT_CERTIFICATE_TAG, TLS_CREDENTIAL_SERVER_CERTIFICATE, dev_certificate,
+	 sizeof(dev_certificate), 0},
+	{"dev_key", CLIENT_KEY_TAG, TLS_CREDENTIAL_PRIVATE_KEY, dev_private_key,
+	 sizeof(dev_private_key), 0},
+	/* Must stay last, see USER_CA */
+	{"user_ca", CA_CERTIFICATE_TAG, TLS_CREDENTIAL_CA_CERTIFICATE, NULL, 0, USE(HTTP)},
+};
+
+static const char *const use_names[] = {"http", "json", "dfu", "certs"};
+
+BUILD_ASSERT(ARRAY_SIZE(use_names) == TMO_TLS_USE_COUNT, "Name every TLS use");
+
+#define USER_CA (&creds[ARRAY_SIZE(creds) - 1])
+
+static uint32_t cred_adds, cred_deletes, cred_failures;
+
+K_MUTEX_DEFINE(creds_lock);
+
+static int cred_add(struct tls_cred_rec *c)
+{
+	int ret = tls_credential_add(c->tag, c->type, c->buf, c->len);
+
+	if (ret == 0) {
+		c->registered = true;
+		cred_adds++;
+	} else {
+		cred_failures++;
+	}
+	return ret;
+}
+
+int tmo_tls_creds_set_user_ca(const uint8_t *buf, size_t len)
+{
+	int ret = 0;
+
+	k_mutex_lock(&creds_lock, K_FOREVER);
+	if (USER_CA->registered) {
+		tls_credential_delete(USER_CA->tag, USER_CA->type);
+		USER_CA->registered = false;
+		cred_deletes++;
+	}
+	USER_CA->buf = buf;
+	USER_CA->len = buf ? len : 0;
+	if (buf && len) {
+		ret = cred_add(USER_CA);
+	}
+	k_mutex_unlock(&creds_lock);
+	return ret;
+}
+
+/* Must be called with creds_lock held */
+static bool cred_trusted(const struct tls_cred_rec *c, enum tmo_tls_use use, const char *host)
+{
+	if (!c->registered || c->type != TLS_CREDENTIAL_CA_CERTIFICATE || !(c->uses & BIT(use))) {
+		return false;
+	}
+	if (use == TMO_TLS_USE_DFU) {
+		bool tmo_host = host && strstr(host, DFU_TMO_DOMAIN);
+
+		return tmo_host == (c->tag == ENTRUST_G2_CA_TAG);
+	}
+	return true;
+}
+
+int tmo_tls_creds_ca_tags(enum tmo_tls_use use, const char *host, sec_tag_t *tags, int max)
+{
+	int n = 0;
+
+	k_mutex_lock(&creds_lock, K_FOREVER);
+	if (cred_trusted(USER_CA, use, host) && n < max) {
+		tags[n++] = USER_CA->tag;
+	}
+	for (int i = 0; i < ARRAY_SIZE(creds) && n < max; i++) {
+		if (&creds[i] != USER_CA && cred_trusted(&creds[i], use, host)) {
+			tags[n++] = creds[i].tag;
+		}
+	}
+	k_mutex_unlock(&creds_lock);
+	return n;
+}
+
+int tmo_tls_creds_set_ca_list(int sock, enum tmo_tls_use use, const char *host)
+{
+	sec_tag_t tags[ARRAY_SIZE(creds)];
+	int n = tmo_tls_creds_ca_tags(use, host, tags, ARRAY_SIZE(tags));
+
+	return zsock_setsockopt(sock, SOL_TLS, TLS_SEC_TAG_LIST, tags, n * sizeof(sec_tag_t));
+}
+
+static const char *cred_type_str(enum tls_credential_type type)
+{
+	switch (type) {
+	case TLS_CREDENTIAL_CA_CERTIFICATE:
+		return "CA";
+	case TLS_CREDENTIAL_SERVER_CERTIFICATE:
+		return "cert";
+	case TLS_CREDENTIAL_PRIVATE_KEY:
+		return "key";
+	default:
+		return "other";
+	}
+}
+
+/* Must be called with creds_lock held */
+static void print_chain(const struct shell *shell, const char *name, enum tmo_tls_use use,
+			const char *host)
+{
+	size_t chain_bytes = 0;
+	int chain = 0;
+
+	for (int i = 0; i < ARRAY_SIZE(creds); i++) {
+		if (cred_trusted(&creds[i], use, host)) {
+			chain++;
+			/* mbedtls_x509_crt_parse_der() keeps a copy of the DER */
+			chain_bytes += creds[i].len + sizeof(mbedtls_x509_crt);
+		}
+	}
+	shell_print(shell, "%-10s %5d %6u", name, chain, chain_bytes);
+}
+
+int cmd_tls_creds(const struct shell *shell, size_t argc, char **argv)
+{
+	size_t flash_bytes = 0, ram_bytes = 0;
+	int used = 0;
+
+	k_mutex_lock(&creds_lock, K_FOREVER);
+	shell_print(shell, "Tag Type   Bytes Where Name");
+	for (int i = 0; i < ARRAY_SIZE(creds); i++) {
+		const struct tls_cred_rec *c = &creds[i];
+		bool ram = c == USER_CA;
+
+		if (!c->registered) {
+			continue;
+		}
+		shell_print(shell, "%3d %-5s %6u %-5s %s", c->tag, cred_type_str(c->type), c->len,
+			    ram ? "RAM" : "flash", c->name);
+		used++;
+		if (ram) {
+			ram_bytes += c->len;
+		} else {
+			flash_bytes += c->len;
+		}
+	}
+	shell_print(shell, "%d of %d credential slots, %u bytes in flash, %u bytes in RAM", used,
+		    CONFIG_TLS_MAX_CREDENTIALS_NUMBER, flash_bytes, ram_bytes);
+	shell_print(shell, "CAs per use, and about the heap they take per native TLS connection");
+	shell_print(shell, "%-10s %5s %6s", "use", "certs", "bytes");
+	for (int u = 0; u < TMO_TLS_USE_COUNT; u++) {
+		if (u == TMO_TLS_USE_DFU) {
+			print_chain(shell, "dfu tmo", u, DFU_TMO_DOMAIN);
+			print_chain(shell, "dfu other", u, NULL);
+		} else {
+			print_chain(shell, use_names[u], u, NULL);
+		}
+	}
+	shell_print(shell, "Since boot: %u adds, %u deletes, %u failures", cred_adds, cred_deletes,
+		    cred_failures);
+	k_mutex_unlock(&creds_lock);
+	return 0;
+}
+
+static int tls_creds_init(const struct device *unused)
+{
+	ARG_UNUSED(unused);
+	for (int i = 0; i < ARRAY_SIZE(creds); i++) {
+		if (&creds[i] != USER_CA && cred_add(&creds[i])) {
+			printk("Failed to register TLS credential %s\n", creds[i].name);
+		}
+	}
+	return 0;
+}
+
+SYS_INIT(tls_creds_init, APPLICATION, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TMO_TLS_CREDS_H
+#define TMO_TLS_CREDS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/net/tls_credentials.h>
+#include <zephyr/shell/shell.h>
+
+/* What a TLS connection is for, which decides the CAs it trusts */
+enum tmo_tls_use {
+	/* 'tmo http': the echo-apps certificate and the CA from 'tmo certs load' */
+	TMO_TLS_USE_HTTP,
+	/* JSON telemetry */
+	TMO_TLS_USE_JSON,
+	/* DFU images, the CA depends on the host */
+	TMO_TLS_USE_DFU,
+	/* 'tmo certs dld' */
+	TMO_TLS_USE_CERTS,
+	TMO_TLS_USE_COUNT
+};
+
+/**
+ * @brief Set or clear the CA loaded with 'tmo certs load'
+ *
+ * The buffer is referenced, not copied, and must stay valid until the CA
+ * is replaced or cleared with a NULL buffer.
+ */
+int tmo_tls_creds_set_user_ca(const uint8_t *buf, size_t len);
+
+/**
+ * @brief Fill in the sec tags of the registered CAs a connection trusts
+ *
+ * The user CA comes first when one is loaded, so a server using it is
+ * matched first. Only registered tags are listed, TLS_SEC_TAG_LIST fails
+ * on a tag with no credential.
+ *
+ * @param use What the connection is for
+ * @param host Server name, picks the CA of a DFU download
+ * @return Number of tags written
+ */
+int tmo_tls_creds_ca_tags(enum tmo_tls_use use, const char *host, sec_tag_t *tags, int max);
+
+/**
+ * @brief Set TLS_SEC_TAG_LIST on a socket to the CAs of its use
+ */
+int tmo_tls_creds_set_ca_list(int sock, enum tmo_tls_use use, const char *host);
+
+int cmd_tls_creds(const struct shell *shell, size_t argc, char **argv);
+
+#endif
@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * UDP packet rate test for the shell UDP/DTLS sockets. The sender paces
+ * sequence numbered, timestamped datagrams at a target rate, the receiver
+ * reports loss, duplicates, reordering and RFC 3550 interarrival jitter.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "tmo_shell.h"
+#include "tmo_udp_burst.h"
+#if CONFIG_TMO_SOCK_RX
+#include "tmo_sock_rx.h"
+#endif
+
+#define UDP_BURST_MAGIC	  0x544d4f42 /* "TMOB" */
+#define UDP_BURST_END_CNT 3
+
+struct udp_burst_hdr {
+	uint32_t magic;
+	uint32_t seq;
+	uint32_t sec;
+	uint32_t usec;
+};
+
+static uint8_t burst_buf[UDP_BURST_MAX_SIZE];
+
+static inline bool window_test(const struct udp_burst_stats *st, uint32_t seq)
+{
+	uint32_t bit = seq % UDP_BURST_WINDOW;
+
+	return st->window[bit / 32] & BIT(bit % 32);
+}
+
+static inline void window_set(struct udp_burst_stats *st, uint32_t seq, bool val)
+{
+	uint32_t bit = seq % UDP_BURST_WINDOW;
+
+	if (val) {
+		st->window[bit / 32] |= BIT(bit % 32);
+	} else {
+		st->window[bit / 32] &= ~BIT(bit % 32);
+	}
+}
+
+void udp_burst_stats_init(struct udp_burst_stats *st)
+{
+	memset(st, 0, sizeof(*st));
+}
+
+void udp_burst_stats_add(struct udp_burst_stats *st, uint32_t seq, int64_t tx_us, int64_t rx_us,
+			 uint32_t len)
+{
+	int64_t transit = rx_us - tx_us;
+
+	if (seq >= st->next_seq) {
+		/* Slide the window forward, clearing the slots of the skipped numbers */
+		if (seq - st->next_seq >= UDP_BURST_WINDOW) {
+			memset(st->window, 0, sizeof(st->window));
+		} else {
+			for (uint32_t s = st->next_seq; s < seq; s++) {
+				window_set(st, s, false);
+			}
+		}
+		st->next_seq = seq + 1;
+	} else if (st->next_seq - seq <= UDP_BURST_WINDOW) {
+		if (window_test(st, seq)) {
+			st->duplicates++;
+			return;
+		}
+		st->reordered++;
+	} else {
+		/*
+		 * Too old to tell a duplicate from a very late arrival. Its window
+		 * bit now belongs to a newer number, so leave it alone.
+		 */
+		st->late++;
+		st->received++;
+		st->bytes += len;
+		return;
+	}
+	window_set(st, seq, true);
+
+	/* RFC 3550 A.8: J += (|D| - J) / 16, kept scaled by 16 */
+	if (st->received) {
+		int64_t d = transit - st->prev_transit;
+
+		if (d < 0) {
+			d = -d;
+		}
+		st->jitter_x16 += (uint32_t)d - ((st->jitter_x16 + 8) >> 4);
+	}
+	st->prev_transit = transit;
+	st->received++;
+	st->bytes += len;
+}
+
+void udp_burst_stats_finish(struct udp_burst_stats *st)
+{
+	uint32_t expected = st->sent ? st->sent : st->next_seq;
+
+	st->lost = expected > st->received ? expected - st->received : 0;
+}
+
+static int burst_sock(const struct shell *shell, const char *arg)
+{
+	struct sock_rec_s *rec;
+	uint32_t sd;
+
+	if (tmo_parse_uint(shell, arg, &sd)) {
+		return -EINVAL;
+	}
+	rec = tmo_sock_find(sd);
+	if (rec == NULL) {
+		shell_error(shell, "Socket %d not found", sd);
+		return -EINVAL;
+	}
+	if (!(rec->flags & (BIT(sock_udp) | BIT(sock_dtls)))) {
+		shell_error(shell, "Socket %d is not a UDP socket", sd);
+		return -EINVAL;
+	}
+	return sd;
+}
+
+static inline int64_t now_us(void)
+{
+	return k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+int udp_burst_tx(int sd, uint32_t seq, uint32_t size, uint32_t count)
+{
+	struct udp_burst_hdr *hdr = (struct udp_burst_hdr *)burst_buf;
+	int64_t t = now_us();
+
+	hdr->magic = htonl(UDP_BURST_MAGIC);
+	hdr->seq = htonl(seq);
+	if (seq == UDP_BURST_END_SEQ) {
+		hdr->sec = htonl(count);
+		size = sizeof(*hdr);
+	} else {
+		hdr->sec = htonl(t / USEC_PER_SEC);
+		hdr->usec = htonl(t % USEC_PER_SEC);
+		size = CLAMP(size, sizeof(*hdr), sizeof(burst_buf));
+	}
+	return zsock_send(sd, burst_buf, size, 0) < 0 ? -errno : 0;
+}
+
+int udp_burst_rx(int sd, int timeout_ms, struct udp_burst_stats *st)
+{
+	struct udp_burst_hdr *hdr = (struct udp_burst_hdr *)burst_buf;
+	struct zsock_pollfd pfd = {
+		.fd = sd,
+		.events = ZSOCK_POLLIN,
+	};
+
+	while (1) {
+		int ret = zsock_poll(&pfd, 1, st->first_us ? UDP_BURST_IDLE_MS : timeout_ms);
+		int64_t rx;
+
+		if (ret < 0) {
+			return -errno;
+		}
+		if (ret == 0) {
+			break;
+		}
+		ret = zsock_recv(sd, burst_buf, sizeof(burst_buf), 0);
+		rx = now_us();
+		if (ret < 0) {
+			/* A receive timeout set on the socket ends the wait like the poll one */
+			if (errno == EAGAIN || errno == ETIMEDOUT) {
+				break;
+			}
+			return -errno;
+		}
+		if (ret < (int)sizeof(*hdr) || ntohl(hdr->magic) != UDP_BURST_MAGIC) {
+			st->ignored++;
+			continue;
+		}
+		if (ntohl(hdr->seq) == UDP_BURST_END_SEQ) {
+			st->sent = ntohl(hdr->sec);
+			break;
+		}
+		if (!st->first_us) {
+			st->first_us = rx;
+		}
+		st->last_us = rx;
+		udp_burst_stats_add(st, ntohl(hdr->seq),
+				    (int64_t)ntohl(hdr->sec) * USEC_PER_SEC + ntohl(hdr->usec), rx,
+				    ret);
+	}
+	return st->first_us ? 0 : -ETIMEDOUT;
+}
+
+int udp_burst_send(const struct shell *shell, size_t argc, char **argv)
+{
+	uint32_t count, size, pps;
+	uint32_t sent = 0, errors = 0;
+	int64_t start, next;
+	uint32_t gap_us;
+	int sd;
+
+	if (argc < 5) {
+		shell_error(shell, "Missing required arguments");
+		shell_print(shell, "Usage: tmo udp burst <socket> <count> <size> <packets/s>");
+		return -EINVAL;
+	}
+	sd = burst_sock(shell, argv[1]);
+	if (sd < 0 || tmo_parse_uint(shell, argv[2], &count) || tmo_parse_uint(shell, argv[3], &size) ||
+	    tmo_parse_uint(shell, argv[4], &pps)) {
+		return -EINVAL;
+	}
+	size = CLAMP(size, sizeof(struct udp_burst_hdr), sizeof(burst_buf));
+	pps = MAX(pps, 1);
+	gap_us = USEC_PER_SEC / pps;
+
+	gen_payload(burst_buf, size);
+	shell_print(shell, "Sending %u datagrams of %u bytes at %u/s", count, size, pps);
+
+	start = next = now_us();
+	for (uint32_t seq = 0; seq < count; seq++) {
+		int64_t t = now_us();
+
+		/* Absolute schedule so sleep overshoot does not accumulate */
+		if (next > t) {
+			k_usleep(next - t);
+			t = now_us();
+		}
+		next += gap_us;
+		if (udp_burst_tx(sd, seq, size, count)) {
+			errors++;
+		} else {
+			sent++;
+		}
+	}
+
+	for (int i = 0; i < UDP_BURST_END_CNT; i++) {
+		udp_burst_tx(sd, UDP_BURST_END_SEQ, 0, count);
+	}
+
+	int64_t elapsed = now_us() - start;
+
+	shell_print(shell, "Sent %u, send errors %u, in %lld ms (%u/s achieved)", sent, errors,
+		    elapsed / 1000,
+		    elapsed > 0 ? (uint32_t)((uint64_t)sent * USEC_PER_SEC / elapsed) : 0);
+	return errors ? -EIO : 0;
+}
+
+int udp_burst_recv(const struct shell *shell, size_t argc, char **argv)
+{
+	struct udp_burst_stats st;
+	uint32_t timeout_s = 10;
+	int sd;
+	int ret;
+
+	if (argc < 2) {
+		shell_error(shell, "Missing required arguments");
+		shell_print(shell, "Usage: tmo udp burstrx <socket> [wait time (seconds)]");
+		return -EINVAL;
+	}
+	sd = burst_sock(shell, argv[1]);
+	if (sd < 0 || (argc > 2 && tmo_parse_uint(shell, argv[2], &timeout_s))) {
+		return -EINVAL;
+	}
+
+	udp_burst_stats_init(&st);
+	shell_print(shell, "Waiting up to %u s for a burst", timeout_s);
+#if CONFIG_TMO_SOCK_RX
+	tmo_sock_rx_claim(sd, true);
+#endif
+
+	ret = udp_burst_rx(sd, timeout_s * MSEC_PER_SEC, &st);
+
+#if CONFIG_TMO_SOCK_RX
+	tmo_sock_rx_release(sd);
+#endif
+	udp_burst_stats_finish(&st);
+	if (ret == -ETIMEDOUT) {
+		shell_error(shell, "No burst received");
+		return ret;
+	}
+	if (ret < 0) {
+		shell_error(shell, "Receive failed, errno = %d", -ret);
+		return ret;
+	}
+	uint32_t expected = st.received + st.lost;
+
+	shell_print(shell, "received %u/%u, lost %u (%u.%u%%), duplicates %u, reordered %u, late %u",
+		    st.received, expected, st.lost, expected ? st.lost * 100 / expected : 0,
+		    expected ? (st.lost * 1000 / expected) % 10 : 0, st.duplicates, st.reordered,
+		    st.late);
+	shell_print(shell, "jitter %u us, %u bytes in %lld ms (%u kbit/s)%s", st.jitter_x16 >> 4,
+		    st.bytes, (st.last_us - st.first_us) / 1000,
+		    st.last_us > st.first_us ?
+			    (uint32_t)((uint64_t)st.bytes * 8 * 1000 / (st.last_us - st.first_us)) : 0,
+		    st.sent ? "" : ", end marker lost");
+	if (st.ignored) {
+		shell_warn(shell, "%u foreign datagrams ignored", st.ignored);
+	}
+	return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TMO_UDP_BURST_H
+#define TMO_UDP_BURST_H
+
+#include <stdint.h>
+#include <zephyr/shell/shell.h>
+
+#define UDP_BURST_END_SEQ  0xffffffff
+#define UDP_BURST_IDLE_MS  2000
+#define UDP_BURST_MAX_SIZE 1472
+
+/* Width of the duplicate detection window, in datagrams */
+#define UDP_BURST_WINDOW 256
+
+struct udp_burst_stats {
+	uint32_t received;
+	uint32_t bytes;
+	uint32_t lost;
+	uint32_t duplicates;
+	uint32_t reordered;
+	/* Older than the window; received, but neither checked nor used for jitter */
+	uint32_t late;
+	/* Highest sequence number seen plus one */
+	uint32_t next_seq;
+	/* Datagram count announced by the sender's end marker, 0 if not seen */
+	uint32_t sent;
+	/* RFC 3550 interarrival jitter in us, scaled by 16 */
+	uint32_t jitter_x16;
+	int64_t prev_transit;
+	uint32_t window[UDP_BURST_WINDOW / 32];
+	/* Datagrams without the burst header */
+	uint32_t ignored;
+	/* Local receive time of the first and last burst datagram, us */
+	int64_t first_us;
+	int64_t last_us;
+};
+
+void udp_burst_stats_init(struct udp_burst_stats *st);
+
+/**
+ * @brief Accounts one received datagram
+ *
+ * @param st The stats
+ * @param seq Sequence number from the datagram
+ * @param tx_us Sender timestamp from the datagram
+ * @param rx_us Local receive timestamp
+ * @param len Datagram length
+ */
+void udp_burst_stats_add(struct udp_burst_stats *st, uint32_t seq, int64_t tx_us, int64_t rx_us,
+			 uint32_t len);
+
+/**
+ * @brief Computes the final loss count once the burst is over
+ */
+void udp_burst_stats_finish(struct udp_burst_stats *st);
+
+/**
+ * @brief Sends one burst datagram, or the end marker if seq is UDP_BURST_END_SEQ
+ *
+ * @param sd A connected UDP socket
+ * @param seq Sequence number
+ * @param size Datagram size, clamped to the header and UDP_BURST_MAX_SIZE
+ * @param count Datagrams in the burst, only sent in the end marker
+ * @return int 0 on success, -errno on failure
+ */
+int udp_burst_tx(int sd, uint32_t seq, uint32_t size, uint32_t count);
+
+/**
+ * @brief Receives a burst until its end marker, or until nothing arrives for
+ * timeout_ms before the first datagram or UDP_BURST_IDLE_MS after it
+ *
+ * @param sd A bound UDP socket
+ * @param timeout_ms How long to wait for the first datagram
+ * @param st Initialised stats, updated with what arrived
+ * @return int 0 on success, -ETIMEDOUT if no burst arrived, -errno on a receive error
+ */
+int udp_burst_rx(int sd, int timeout_ms, struct udp_burst_stats *st);
+
+int udp_burst_send(const struct shell *shell, size_t argc, char **argv);
+int udp_burst_recv(const struct shell *shell, size_t argc, char **argv);
+
+#endif
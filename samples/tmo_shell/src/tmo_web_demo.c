@@ -23,6 +23,10 @@
 #include "tmo_http_request.h"
 #include "tmo_shell.h"
 #include "tmo_battery_ctrl.h"
+#include "tmo_cbor.h"
+#include "tmo_json_writer.h"
+#include "tmo_tlm_queue.h"
+#include "tmo_modem.h"
 
 static struct web_demo_settings_t web_demo_settings = {false, 0, 2, TRANSMIT_INTERVAL_SECS_WEB};
 #define MAX_BASE_URL_SIZE  100
@@ -52,6 +56,9 @@ int get_json_iface_type()
 bool set_transmit_json_flag( bool user_transmit_setting)
 {
 	web_demo_settings.transmit_flag = user_transmit_setting;
+	if (!user_transmit_setting) {
+		tmo_http_json_close();
+	}
 	return web_demo_settings.transmit_flag;
 }
 
@@ -63,12 +70,14 @@ void set_transmit_interval(int secs)
 int set_json_iface_type (int iface_type)
 {
 	web_demo_settings.iface_type = iface_type;
+	tmo_http_json_close();
 	return web_demo_settings.iface_type;
 }
 
 int set_json_base_url(const char *base_url)
 {
 	snprintf(base_url_s, sizeof(base_url_s), "%s", base_url);
+	tmo_http_json_close();
 	return 0;
 }
 
@@ -84,6 +93,7 @@ int set_json_path(const char *path)
 	} else {
 		snprintf(path_s, sizeof(path_s), "%s/", path);
 	}
+	tmo_http_json_close();
 	return 0;
 }
 
@@ -108,41 +118,14 @@ int get_web_demo_settings(struct web_demo_settings_t *ws)
 
 int get_cell_strength(int *val)
 {
-	// What is the idx value to use - find the define and replace the hard-code
-	int ret = 0;
-	struct net_if *iface = net_if_get_by_index(1);
-	if (iface == NULL) {
-		return -EINVAL;
-	}
-	if (!strstr(iface->if_dev->dev->name, "murata")) {
-		return -EINVAL;
-	}
-	int sd = zsock_socket_ext(AF_INET, SOCK_STREAM, IPPROTO_TCP, iface);
-	if (sd == -1) {
-		return -ENOENT;
-	}
+	int64_t age_ms;
+	/* Served from the modem status cache, see tmo_modem.c */
+	int ret = tmo_modem_get_signal(val, &age_ms);
 
-	char cmd_buf[20];
-	strcpy(cmd_buf, "SSI");
-	strupper(cmd_buf);
-	int res = fcntl(sd, GET_ATCMD_RESP, cmd_buf);
-	if (res < 0) {
+	/* A reading past its maximum age is not reported as current */
+	if (ret == 0 && age_ms > CONFIG_TMO_MODEM_STATUS_MAX_AGE_SECS * MSEC_PER_SEC) {
 		ret = -EAGAIN;
-	} else if (cmd_buf[0] == 0) {
-		ret = -EAGAIN;
-	}
-
-	int stat = zsock_close(sd);
-	if (stat < 0) {
-		// Close failed;
-		return stat;
-	}
-
-	int sig_strength = 0;
-	if (cmd_buf[0] != '\0') {
-		sig_strength = atoi(cmd_buf);
 	}
-	*val = sig_strength;
 	return ret;
 }
 
@@ -159,150 +142,947 @@ int get_gnss_location_info(double* latitude, double* longitude, double* alt, dou
 	return 0;
 }
 
-int  create_json()
+void web_demo_sample_collect(struct web_demo_sample *s)
 {
-	int val;
-	double lat, lon, alt, hdop;
-	int ret_val;
-	struct sensor_value sensor_value_arr[3];
-	int buffer_size = MAX_PAYLOAD_BUFFER_SIZE;
-	memset(json_payload, 0, MAX_PAYLOAD_BUFFER_SIZE);
+	memset(s, 0, sizeof(*s));
+	s->timestamp = k_uptime_get();
 
-	// test blank payload
-	// json_payload[0] = '\0';
-	// return strlen(json_payload);
+	s->accel_valid = read_accelerometer(s->accel) == 0;
 
-	// test simple payload
-	// snprintf(json_payload, sizeof(json_payload), "{ \"x\":\"hello\" }");
-	// return strlen(json_payload);
+	s->bat_state = battery_state_not_attached;
+	if (battery_attached != 0) {
+		s->millivolts = read_battery_voltage();
+		millivolts_to_percent(s->millivolts, &s->percent);
+		if (is_battery_charging()) {
+			s->bat_state = battery_state_charging;
+		} else {
+			s->bat_state = battery_state_not_charging;
+		}
+	}
 
-	// Initial bracket
-	int total_bytes_written = ret_val = snprintf(json_payload, buffer_size, "{\n");
-	int num_bytes_avail_buffer = buffer_size - total_bytes_written;
-
-	if (ret_val >= 0 && total_bytes_written < buffer_size) {
-		read_accelerometer(sensor_value_arr);
-		double val0 = sensor_value_to_double(sensor_value_arr);
-		double val1 = sensor_value_to_double(&sensor_value_arr[1]);
-		double val2 = sensor_value_to_double(&sensor_value_arr[2]);
-		ret_val = snprintf(json_payload+total_bytes_written, num_bytes_avail_buffer,
-				"\"accelerometer\":{\n\"x\":%.2lf,\n\"y\":%.2lf,\n\"z\":%.2lf\n},\n",
-				val0, val1, val2);
-	} else {
-		return ret_val;
-	}
-
-	num_bytes_avail_buffer -= ret_val;
-	total_bytes_written += ret_val;
-
-	if (ret_val >= 0 && total_bytes_written < buffer_size) {
-		uint8_t percent = 0;
-		uint32_t millivolts = 0;
-		enum battery_state e_bat_state = battery_state_not_attached;
-		if (battery_attached !=0) {
-			millivolts = read_battery_voltage();
-			millivolts_to_percent(millivolts, &percent);
-			if (is_battery_charging()) {
-				e_bat_state = battery_state_charging;
-			} else {
-				e_bat_state = battery_state_not_charging;
-			}
+	s->cell_valid = get_cell_strength(&s->cell_dbm) == 0;
+	s->temp_valid = fetch_temperature(&s->temp);
+	s->light_valid = fetch_light(&s->light) && fetch_ir(&s->ir);
+#if CONFIG_LPS22HH
+	s->press_valid = fetch_pressure(&s->press);
+#endif
+	get_gnss_location_info(&s->lat, &s->lon, &s->alt, &s->hdop);
+	s->fields = WEB_DEMO_FIELDS_ALL;
+}
+
+static int count_sink(void *ctx, const char *data, size_t len)
+{
+	return 0;
+}
+
+/* Whether a field group goes into the encoded sample */
+static bool sample_has(const struct web_demo_sample *s, enum web_demo_field f)
+{
+	if (!(s->fields & BIT(f))) {
+		return false;
+	}
+	switch (f) {
+	case WEB_DEMO_FIELD_TEMP:
+		return s->temp_valid;
+	case WEB_DEMO_FIELD_LIGHT:
+		return s->light_valid;
+	case WEB_DEMO_FIELD_PRESS:
+		return s->press_valid;
+	default:
+		return true;
+	}
+}
+
+static int64_t dbl_mantissa(double v, int digits)
+{
+	for (int i = 0; i < digits; i++) {
+		v *= 10;
+	}
+	return (int64_t)(v < 0 ? v - 0.5 : v + 0.5);
+}
+
+void web_demo_sample_write_json(struct tmo_json_writer *w, const struct web_demo_sample *s,
+		bool with_ts)
+{
+	tmo_json_obj_begin(w, NULL);
+
+	if (with_ts) {
+		tmo_json_int(w, "ts", s->timestamp);
+	}
+
+	if (sample_has(s, WEB_DEMO_FIELD_ACCEL)) {
+		tmo_json_obj_begin(w, "accelerometer");
+		tmo_json_sensor(w, "x", &s->accel[0], 2);
+		tmo_json_sensor(w, "y", &s->accel[1], 2);
+		tmo_json_sensor(w, "z", &s->accel[2], 2);
+		tmo_json_obj_end(w);
+	}
+
+	if (sample_has(s, WEB_DEMO_FIELD_BATTERY)) {
+		tmo_json_obj_begin(w, "battery");
+		tmo_json_fixed(w, "voltage", s->millivolts, 3);
+		tmo_json_int(w, "percent", s->percent);
+		tmo_json_str(w, "state", battery_state_string[s->bat_state]);
+		tmo_json_obj_end(w);
+	}
+
+	if (sample_has(s, WEB_DEMO_FIELD_CELL)) {
+		tmo_json_obj_begin(w, "cellSignalStrength");
+		if (s->cell_valid) {
+			tmo_json_int(w, "dbm", s->cell_dbm);
 		} else {
-			e_bat_state = battery_state_not_attached;
+			tmo_json_null(w, "dbm");
 		}
-		ret_val = snprintf(json_payload+total_bytes_written, num_bytes_avail_buffer,
-				"\"battery\":{\n\"voltage\":%d.%03d,\n\"percent\":%d,\n\"state\":\"%s\"\n},\n",
-				millivolts/1000, millivolts%1000, percent,
-				battery_state_string[e_bat_state]);
+		tmo_json_obj_end(w);
+	}
+
+	if (sample_has(s, WEB_DEMO_FIELD_TEMP)) {
+		tmo_json_obj_begin(w, "temperature");
+		tmo_json_sensor(w, "temperatureCelsius", &s->temp, 1);
+		tmo_json_obj_end(w);
+	}
+
+	if (sample_has(s, WEB_DEMO_FIELD_LIGHT)) {
+		tmo_json_obj_begin(w, "ambientLight");
+		tmo_json_sensor(w, "visibleLux", &s->light, 2);
+		tmo_json_sensor(w, "irLux", &s->ir, 2);
+		tmo_json_obj_end(w);
+	}
+
+	if (sample_has(s, WEB_DEMO_FIELD_PRESS)) {
+		tmo_json_obj_begin(w, "pressure");
+		tmo_json_sensor(w, "kPa", &s->press, 2);
+		tmo_json_obj_end(w);
+	}
+
+	/* GNSS is the only double left; scale it once instead of printing it */
+	if (sample_has(s, WEB_DEMO_FIELD_MAP)) {
+		tmo_json_obj_begin(w, "map");
+		tmo_json_fixed(w, "lat", dbl_mantissa(s->lat, 6), 6);
+		tmo_json_fixed(w, "lng", dbl_mantissa(s->lon, 6), 6);
+		tmo_json_fixed(w, "alt", dbl_mantissa(s->alt, 2), 2);
+		tmo_json_fixed(w, "hdop", dbl_mantissa(s->hdop, 2), 2);
+		tmo_json_obj_end(w);
+	}
+
+	tmo_json_obj_end(w);
+}
+
+int web_demo_sample_to_json(const struct web_demo_sample *s, char *buf, size_t len,
+		bool with_ts)
+{
+	struct tmo_json_writer w;
+
+	tmo_json_init(&w, buf, len, NULL, NULL);
+	web_demo_sample_write_json(&w, s, with_ts);
+	return tmo_json_finish(&w);
+}
+
+#if CONFIG_TMO_WEB_DEMO_JSON_LEGACY
+/* Original snprintf/%lf formatter, kept only as a baseline for 'tmo json bench' */
+static int sample_to_json_legacy(const struct web_demo_sample *s, char *buf, size_t len,
+		bool with_ts)
+{
+	int total_bytes_written = 0;
+	int ret_val;
+
+#define JSON_APPEND(...)							\
+	do {									\
+		ret_val = snprintf(buf + total_bytes_written,			\
+				len - total_bytes_written, __VA_ARGS__);	\
+		if (ret_val < 0 || total_bytes_written + ret_val >= len) {	\
+			return -ENOMEM;						\
+		}								\
+		total_bytes_written += ret_val;					\
+	} while (0)
+
+	// Initial bracket
+	JSON_APPEND("{\n");
+
+	if (with_ts) {
+		JSON_APPEND("\"ts\":%lld,\n", s->timestamp);
+	}
+
+	JSON_APPEND("\"accelerometer\":{\n\"x\":%.2lf,\n\"y\":%.2lf,\n\"z\":%.2lf\n},\n",
+			sensor_value_to_double(&s->accel[0]),
+			sensor_value_to_double(&s->accel[1]),
+			sensor_value_to_double(&s->accel[2]));
+
+	JSON_APPEND("\"battery\":{\n\"voltage\":%d.%03d,\n\"percent\":%d,\n\"state\":\"%s\"\n},\n",
+			s->millivolts/1000, s->millivolts%1000, s->percent,
+			battery_state_string[s->bat_state]);
+
+	if (s->cell_valid) {
+		JSON_APPEND("\"cellSignalStrength\":{\n\"dbm\":%d\n},\n", s->cell_dbm);
 	} else {
-		return ret_val;
+		JSON_APPEND("\"cellSignalStrength\":{\n\"dbm\":null\n},\n");
 	}
-	num_bytes_avail_buffer -= ret_val;
-	total_bytes_written += ret_val;
 
-	if (ret_val >= 0 && total_bytes_written < buffer_size) {
-		if (get_cell_strength(&val) == 0) {
-			ret_val = snprintf(json_payload+total_bytes_written, num_bytes_avail_buffer,
-				"\"cellSignalStrength\":{\n\"dbm\":%d\n},\n", val);
+	if (s->temp_valid) {
+		JSON_APPEND("\"temperature\":{\n\"temperatureCelsius\":%.1lf\n},\n",
+				sensor_value_to_double(&s->temp));
+	}
+
+	if (s->light_valid) {
+		JSON_APPEND("\"ambientLight\":{\n\"visibleLux\":%.2lf,\n\"irLux\":%.2lf\n},\n",
+				sensor_value_to_double(&s->light),
+				sensor_value_to_double(&s->ir));
+	}
+
+	if (s->press_valid) {
+		JSON_APPEND("\"pressure\":{\n\"kPa\":%.2lf\n},\n",
+				sensor_value_to_double(&s->press));
+	}
+
+	JSON_APPEND("\"map\":{\n\"lat\":%.6lf,\n\"lng\":%.6lf,\n\"alt\":%.2lf,\n\"hdop\":%.2lf\n}\n",
+			s->lat, s->lon, s->alt, s->hdop);
+
+	// Final bracket
+	JSON_APPEND("}\n");
+#undef JSON_APPEND
+
+	return total_bytes_written;
+}
+#endif
+
+int web_demo_sample_to_cbor(const struct web_demo_sample *s, uint8_t *buf, size_t len,
+		bool with_ts)
+{
+	struct tmo_cbor c;
+	int pairs = with_ts;
+
+	for (int f = 0; f < WEB_DEMO_FIELD_COUNT; f++) {
+		pairs += sample_has(s, f);
+	}
+
+	tmo_cbor_init(&c, buf, len);
+	tmo_cbor_map(&c, pairs);
+
+	if (with_ts) {
+		tmo_cbor_text(&c, "ts");
+		tmo_cbor_int(&c, s->timestamp);
+	}
+
+	if (sample_has(s, WEB_DEMO_FIELD_ACCEL)) {
+		tmo_cbor_text(&c, "accelerometer");
+		tmo_cbor_map(&c, 3);
+		tmo_cbor_text(&c, "x");
+		tmo_cbor_decimal(&c, tmo_sensor_value_to_fixed(&s->accel[0], 2), -2);
+		tmo_cbor_text(&c, "y");
+		tmo_cbor_decimal(&c, tmo_sensor_value_to_fixed(&s->accel[1], 2), -2);
+		tmo_cbor_text(&c, "z");
+		tmo_cbor_decimal(&c, tmo_sensor_value_to_fixed(&s->accel[2], 2), -2);
+	}
+
+	if (sample_has(s, WEB_DEMO_FIELD_BATTERY)) {
+		tmo_cbor_text(&c, "battery");
+		tmo_cbor_map(&c, 3);
+		tmo_cbor_text(&c, "voltage");
+		tmo_cbor_decimal(&c, s->millivolts, -3);
+		tmo_cbor_text(&c, "percent");
+		tmo_cbor_uint(&c, s->percent);
+		tmo_cbor_text(&c, "state");
+		tmo_cbor_text(&c, battery_state_string[s->bat_state]);
+	}
+
+	if (sample_has(s, WEB_DEMO_FIELD_CELL)) {
+		tmo_cbor_text(&c, "cellSignalStrength");
+		tmo_cbor_map(&c, 1);
+		tmo_cbor_text(&c, "dbm");
+		if (s->cell_valid) {
+			tmo_cbor_int(&c, s->cell_dbm);
 		} else {
-			ret_val = snprintf(json_payload+total_bytes_written, num_bytes_avail_buffer,
-				"\"cellSignalStrength\":{\n\"dbm\":null\n},\n");
+			tmo_cbor_null(&c);
 		}
-	} else {
-		return ret_val;
 	}
-	num_bytes_avail_buffer -= ret_val;
-	total_bytes_written += ret_val;
 
-	if (ret_val >= 0 && total_bytes_written < buffer_size) {
-		if (fetch_temperature((struct sensor_value*) &sensor_value_arr[0])) {
-			double val = sensor_value_to_double(sensor_value_arr);
-			ret_val =  snprintf(json_payload+total_bytes_written, num_bytes_avail_buffer,
-					"\"temperature\":{\n\"temperatureCelsius\":%.1lf\n},\n", val);
+	if (sample_has(s, WEB_DEMO_FIELD_TEMP)) {
+		tmo_cbor_text(&c, "temperature");
+		tmo_cbor_map(&c, 1);
+		tmo_cbor_text(&c, "temperatureCelsius");
+		tmo_cbor_decimal(&c, tmo_sensor_value_to_fixed(&s->temp, 1), -1);
+	}
+
+	if (sample_has(s, WEB_DEMO_FIELD_LIGHT)) {
+		tmo_cbor_text(&c, "ambientLight");
+		tmo_cbor_map(&c, 2);
+		tmo_cbor_text(&c, "visibleLux");
+		tmo_cbor_decimal(&c, tmo_sensor_value_to_fixed(&s->light, 2), -2);
+		tmo_cbor_text(&c, "irLux");
+		tmo_cbor_decimal(&c, tmo_sensor_value_to_fixed(&s->ir, 2), -2);
+	}
+
+	if (sample_has(s, WEB_DEMO_FIELD_PRESS)) {
+		tmo_cbor_text(&c, "pressure");
+		tmo_cbor_map(&c, 1);
+		tmo_cbor_text(&c, "kPa");
+		tmo_cbor_decimal(&c, tmo_sensor_value_to_fixed(&s->press, 2), -2);
+	}
+
+	if (sample_has(s, WEB_DEMO_FIELD_MAP)) {
+		tmo_cbor_text(&c, "map");
+		tmo_cbor_map(&c, 4);
+		tmo_cbor_text(&c, "lat");
+		tmo_cbor_decimal(&c, dbl_mantissa(s->lat, 6), -6);
+		tmo_cbor_text(&c, "lng");
+		tmo_cbor_decimal(&c, dbl_mantissa(s->lon, 6), -6);
+		tmo_cbor_text(&c, "alt");
+		tmo_cbor_decimal(&c, dbl_mantissa(s->alt, 2), -2);
+		tmo_cbor_text(&c, "hdop");
+		tmo_cbor_decimal(&c, dbl_mantissa(s->hdop, 2), -2);
+	}
+
+	return tmo_cbor_finish(&c);
+}
+
+/*
+ * Payload format is remembered per endpoint (base URL + path), so switching
+ * between a CBOR-capable and a JSON-only server doesn't need reconfiguring.
+ */
+static struct {
+	uint32_t hash;
+	enum tmo_http_payload_fmt fmt;
+} endpoint_fmt[CONFIG_TMO_WEB_DEMO_FORMAT_ENDPOINTS];
+static int endpoint_fmt_next;
+static uint32_t cbor_rejected;
+
+static uint32_t endpoint_hash(void)
+{
+	uint32_t h = 5381;
+
+	for (const char *p = base_url_s; *p; p++) {
+		h = h * 33 + *p;
+	}
+	for (const char *p = path_s; *p; p++) {
+		h = h * 33 + *p;
+	}
+	return h;
+}
+
+enum tmo_http_payload_fmt get_json_format(void)
+{
+	uint32_t h = endpoint_hash();
+
+	for (int i = 0; i < ARRAY_SIZE(endpoint_fmt); i++) {
+		if (endpoint_fmt[i].hash == h) {
+			return endpoint_fmt[i].fmt;
 		}
+	}
+	return TMO_HTTP_FMT_JSON;
+}
+
+void set_json_format(enum tmo_http_payload_fmt fmt)
+{
+	uint32_t h = endpoint_hash();
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(endpoint_fmt); i++) {
+		if (endpoint_fmt[i].hash == h) {
+			break;
+		}
+	}
+	if (i == ARRAY_SIZE(endpoint_fmt)) {
+		i = endpoint_fmt_next;
+		endpoint_fmt_next = (endpoint_fmt_next + 1) % ARRAY_SIZE(endpoint_fmt);
+		endpoint_fmt[i].hash = h;
+	}
+	endpoint_fmt[i].fmt = fmt;
+}
+
+uint32_t get_json_cbor_rejected(void)
+{
+	return cbor_rejected;
+}
+
+int  create_json()
+{
+	struct web_demo_sample sample;
+	int total_bytes_written;
+
+	memset(json_payload, 0, MAX_PAYLOAD_BUFFER_SIZE);
+	web_demo_sample_collect(&sample);
+	total_bytes_written = web_demo_sample_to_json(&sample, json_payload,
+			MAX_PAYLOAD_BUFFER_SIZE, false);
+
+#ifdef CONFIG_DEBUG_JSON_GENERATION
+	printf("\n total_bytes_written %d ", total_bytes_written);
+	printf("\n%s\n", json_payload);
+#endif
+	return total_bytes_written;
+}
+
+char* get_json_payload_pointer()
+{
+	return json_payload;
+}
+
+/*
+ * Samples are queued here and uploaded as a JSON array once batch_size of them
+ * are waiting (or flush_interval has passed), so a battery unit only wakes the
+ * radio on every Nth transmit interval.
+ */
+static struct web_demo_sample sample_ring[CONFIG_TMO_WEB_DEMO_RING_SIZE];
+static int ring_head;
+static int ring_count;
+static char batch_payload[CONFIG_TMO_WEB_DEMO_BATCH_BUF_SIZE];
+static int batch_size = CONFIG_TMO_WEB_DEMO_BATCH_SIZE;
+static int flush_interval = CONFIG_TMO_WEB_DEMO_FLUSH_INTERVAL_SECS;
+static int64_t last_flush;
+static struct web_demo_batch_stats batch_stats;
+
+#if CONFIG_TMO_TLM_QUEUE
+static int drain_rate = CONFIG_TMO_TLM_QUEUE_DRAIN_BATCHES;
+
+int web_demo_queue_init(void)
+{
+	return tmo_tlm_queue_init(sizeof(struct web_demo_sample));
+}
+
+/* Samples that couldn't be sent are kept in flash until the link is back */
+static void sample_to_queue(const struct web_demo_sample *s)
+{
+	if (tmo_tlm_queue_push(s) == 0) {
+		batch_stats.spilled++;
 	} else {
-		return ret_val;
-	}
-	num_bytes_avail_buffer -=  ret_val;
-	total_bytes_written += ret_val;
-
-	if (ret_val >= 0 && total_bytes_written < buffer_size) {
-		if ((fetch_light((struct sensor_value*) &sensor_value_arr[0])) &&
-				(fetch_ir((struct sensor_value*) &sensor_value_arr[1]))) {
-			double val0 = sensor_value_to_double(sensor_value_arr);
-			double val1 = sensor_value_to_double(&sensor_value_arr[1]);
-			ret_val =  snprintf(json_payload+total_bytes_written, num_bytes_avail_buffer,
-					"\"ambientLight\":{\n\"visibleLux\":%.2lf,\n\"irLux\":%.2lf\n},\n",
-					val0, val1);
+		batch_stats.dropped++;
+	}
+}
+#endif
+
+static void ring_push(const struct web_demo_sample *s)
+{
+	if (ring_count == CONFIG_TMO_WEB_DEMO_RING_SIZE) {
+#if CONFIG_TMO_TLM_QUEUE
+		sample_to_queue(&sample_ring[ring_head]);
+#else
+		batch_stats.dropped++;
+#endif
+		ring_head = (ring_head + 1) % CONFIG_TMO_WEB_DEMO_RING_SIZE;
+		ring_count--;
+	}
+	sample_ring[(ring_head + ring_count) % CONFIG_TMO_WEB_DEMO_RING_SIZE] = *s;
+	ring_count++;
+}
+
+static void ring_consume(int cnt)
+{
+	ring_head = (ring_head + cnt) % CONFIG_TMO_WEB_DEMO_RING_SIZE;
+	ring_count -= cnt;
+}
+
+#if CONFIG_TMO_TLM_QUEUE
+static void ring_to_queue(void)
+{
+	while (ring_count > 0) {
+		sample_to_queue(&sample_ring[ring_head]);
+		ring_consume(1);
+	}
+}
+#endif
+
+/**
+ * @brief Encodes up to max samples as one CBOR payload. A single sample keeps
+ * the original object format, more than one are sent as an array.
+ *
+ * @return int The number of samples encoded, -err on failure
+ */
+static int batch_encode_cbor(const struct web_demo_sample *samples, int first, int ring_len,
+		int max, bool with_ts, int *payload_len)
+{
+	uint8_t *buf = (uint8_t *)batch_payload;
+	int written = 0;
+	int cnt = 0;
+	int ret;
+
+	if (max == 1) {
+		ret = web_demo_sample_to_cbor(&samples[first], buf, sizeof(batch_payload),
+				with_ts);
+		if (ret < 0) {
+			return ret;
 		}
+		*payload_len = ret;
+		return 1;
+	}
+
+	/* Indefinite-length array, closed by a break byte */
+	buf[written++] = 0x9f;
+	while (cnt < max) {
+		const struct web_demo_sample *s = &samples[(first + cnt) % ring_len];
+
+		/* Leave room for the break byte */
+		ret = web_demo_sample_to_cbor(s, buf + written,
+				sizeof(batch_payload) - written - 1, true);
+		if (ret < 0) {
+			break;
+		}
+		written += ret;
+		cnt++;
+	}
+	if (cnt == 0) {
+		return -ENOMEM;
+	}
+	buf[written++] = 0xff;
+	*payload_len = written;
+	return cnt;
+}
+
+struct batch_src {
+	const struct web_demo_sample *samples;
+	int first;
+	int ring_len;
+	int cnt;
+	bool with_ts;
+	size_t bytes;
+};
+
+/* Streams a batch as JSON, leaving the samples in place in case of a retry */
+static int batch_write_json(struct tmo_json_writer *w, void *arg)
+{
+	struct batch_src *src = arg;
+
+	if (src->cnt == 1) {
+		web_demo_sample_write_json(w, &src->samples[src->first], src->with_ts);
 	} else {
-		return ret_val;
+		tmo_json_arr_begin(w, NULL);
+		for (int i = 0; i < src->cnt; i++) {
+			web_demo_sample_write_json(w,
+					&src->samples[(src->first + i) % src->ring_len], true);
+		}
+		tmo_json_arr_end(w);
 	}
-	num_bytes_avail_buffer -=  ret_val;
-	total_bytes_written += ret_val;
+	src->bytes = w->total;
+	return w->err;
+}
 
-#if CONFIG_LPS22HH
-	if (ret_val >= 0 && total_bytes_written < buffer_size) {
-		if (fetch_pressure((struct sensor_value*) &sensor_value_arr[0])) {
-			double val = sensor_value_to_double(sensor_value_arr);
-			ret_val =  snprintf(json_payload+total_bytes_written, num_bytes_avail_buffer,
-					"\"pressure\":{\n\"kPa\":%.2lf\n},\n", val);
+/**
+ * @brief Posts up to max samples in the endpoint's format. Samples are
+ * timestamped when sent as an array or when with_ts is set.
+ *
+ * @return int The number of samples posted, -EAGAIN if the batch should be
+ * re-sent in another format, -err on failure
+ */
+static int batch_post(const struct web_demo_sample *samples, int first, int ring_len, int max,
+		bool with_ts)
+{
+	enum tmo_http_payload_fmt fmt = get_json_format();
+	struct batch_src src = {samples, first, ring_len, max, with_ts, 0};
+	int cnt = max;
+	int len = 0;
+	int ret;
+
+	if (fmt == TMO_HTTP_FMT_CBOR) {
+		cnt = batch_encode_cbor(samples, first, ring_len, max, with_ts, &len);
+		if (cnt < 0) {
+			return cnt;
 		}
+	}
+
+	increment_number_http_requests();
+	if (fmt == TMO_HTTP_FMT_CBOR) {
+		ret = tmo_http_json_post(batch_payload, len, fmt);
 	} else {
-		return ret_val;
+		ret = tmo_http_json_post_stream(batch_write_json, &src);
+		len = src.bytes;
 	}
-	num_bytes_avail_buffer -=  ret_val;
-	total_bytes_written += ret_val;
+	if (ret >= 200 && ret < 300) {
+		batch_stats.posts++;
+		batch_stats.bytes += len;
+		return cnt;
+	}
+	if (ret == 415 && fmt == TMO_HTTP_FMT_CBOR) {
+		/* Unsupported Media Type: fall back to JSON for this endpoint */
+		printf("Endpoint rejected CBOR, switching to JSON\n");
+		cbor_rejected++;
+		set_json_format(TMO_HTTP_FMT_JSON);
+		return -EAGAIN;
+	}
+	return ret < 0 ? ret : -EIO;
+}
+
+static void web_demo_flush(void)
+{
+	int cnt;
+
+#if CONFIG_TMO_TLM_QUEUE
+	/*
+	 * Backlog from earlier outages goes first, but only drain_rate batches
+	 * per flush so a long backlog doesn't hog the link. Stored samples are
+	 * always timestamped since they're sent late.
+	 */
+	for (int i = 0; i < drain_rate && tmo_tlm_queue_count() > 0; i++) {
+		static struct web_demo_sample stored[CONFIG_TMO_WEB_DEMO_BATCH_SIZE_MAX];
+
+		cnt = tmo_tlm_queue_peek(stored, MIN(batch_size, ARRAY_SIZE(stored)));
+		if (cnt <= 0) {
+			break;
+		}
+		cnt = batch_post(stored, 0, cnt, cnt, true);
+		if (cnt == -EAGAIN) {
+			i--;
+			continue;
+		} else if (cnt == -ENOMEM) {
+			tmo_tlm_queue_pop(1);
+			batch_stats.dropped++;
+			continue;
+		} else if (cnt < 0) {
+			ring_to_queue();
+			return;
+		}
+		tmo_tlm_queue_pop(cnt);
+	}
+#endif
+	while (ring_count > 0) {
+		cnt = batch_post(sample_ring, ring_head, CONFIG_TMO_WEB_DEMO_RING_SIZE,
+				MIN(ring_count, batch_size), false);
+		if (cnt == -ENOMEM) {
+			/* A sample that can't be encoded would block the ring forever */
+			ring_consume(1);
+			batch_stats.dropped++;
+			continue;
+		} else if (cnt == -EAGAIN) {
+			continue;
+		} else if (cnt < 0) {
+#if CONFIG_TMO_TLM_QUEUE
+			ring_to_queue();
 #endif
+			return;
+		}
+		ring_consume(cnt);
+	}
+	last_flush = k_uptime_get();
+}
 
-	if (ret_val >= 0 && total_bytes_written < buffer_size) {
-		get_gnss_location_info(&lat, &lon, &alt, &hdop);
-		ret_val = snprintf(json_payload+total_bytes_written, num_bytes_avail_buffer,
-				"\"map\":{\n\"lat\":%.6lf,\n\"lng\":%.6lf,\n\"alt\":%.2lf,\n\"hdop\":%.2lf\n}\n", lat, lon, alt, hdop);
-	} else {
-		return ret_val;
+int set_batch_size(int n)
+{
+	if (n < 1 || n > CONFIG_TMO_WEB_DEMO_BATCH_SIZE_MAX) {
+		return -EINVAL;
+	}
+	batch_size = n;
+	return 0;
+}
+
+int get_batch_size(void)
+{
+	return batch_size;
+}
+
+void set_flush_interval(int secs)
+{
+	flush_interval = secs;
+}
+
+int get_flush_interval(void)
+{
+	return flush_interval;
+}
+
+#if CONFIG_TMO_TLM_QUEUE
+void set_drain_rate(int batches)
+{
+	drain_rate = batches;
+}
+
+int get_drain_rate(void)
+{
+	return drain_rate;
+}
+#endif
+
+void get_web_demo_batch_stats(struct web_demo_batch_stats *stats)
+{
+	memcpy(stats, &batch_stats, sizeof(batch_stats));
+	stats->queued = ring_count;
+#if CONFIG_TMO_TLM_QUEUE
+	stats->queued += tmo_tlm_queue_count();
+#endif
+	stats->elapsed_ms = k_uptime_get() - batch_stats.since;
+}
+
+void reset_web_demo_batch_stats(void)
+{
+	memset(&batch_stats, 0, sizeof(batch_stats));
+	batch_stats.since = k_uptime_get();
+}
+
+/*
+ * Deadband reporting: a field group is only sent when one of its values moved
+ * past its absolute or relative threshold since it was last reported, or
+ * when the heartbeat forces a full report. Thresholds are in micro-units of
+ * the reported value (m/s^2, V, dBm, C, lux, kPa, degrees). Map altitude
+ * is in metres, whose GNSS noise has nothing to do with that of the
+ * coordinates, so the map field carries its own altitude threshold.
+ */
+static const char * const field_names[WEB_DEMO_FIELD_COUNT] = {
+	"accel", "battery", "cell", "temp", "light", "pressure", "map",
+};
+static struct web_demo_deadband deadbands[WEB_DEMO_FIELD_COUNT] = {
+	[WEB_DEMO_FIELD_ACCEL]   = {500000, 0},
+	[WEB_DEMO_FIELD_BATTERY] = {50000, 0},
+	[WEB_DEMO_FIELD_CELL]    = {3000000, 0},
+	[WEB_DEMO_FIELD_TEMP]    = {500000, 0},
+	[WEB_DEMO_FIELD_LIGHT]   = {10000000, 10},
+	[WEB_DEMO_FIELD_PRESS]   = {100000, 0},
+	[WEB_DEMO_FIELD_MAP]     = {100, 0, CONFIG_TMO_WEB_DEMO_ALT_DEADBAND_CM * 10000LL},
+};
+#define MAP_ALT 2
+
+static bool deadband_enabled = IS_ENABLED(CONFIG_TMO_WEB_DEMO_DEADBAND);
+static bool deadband_skip = IS_ENABLED(CONFIG_TMO_WEB_DEMO_DEADBAND_SKIP);
+static int heartbeat_secs = CONFIG_TMO_WEB_DEMO_HEARTBEAT_SECS;
+static int64_t last_full_report;
+static int64_t reported[WEB_DEMO_FIELD_COUNT][3];
+static bool reported_valid[WEB_DEMO_FIELD_COUNT];
+static uint8_t reported_bat_state;
+
+static int64_t sv_micro(const struct sensor_value *v)
+{
+	return (int64_t)v->val1 * 1000000 + v->val2;
+}
+
+/* Values of a field group in micro-units, returns how many */
+static int field_values(const struct web_demo_sample *s, enum web_demo_field f,
+		int64_t *v, bool *valid)
+{
+	*valid = true;
+	switch (f) {
+	case WEB_DEMO_FIELD_ACCEL:
+		*valid = s->accel_valid;
+		v[0] = sv_micro(&s->accel[0]);
+		v[1] = sv_micro(&s->accel[1]);
+		v[2] = sv_micro(&s->accel[2]);
+		return 3;
+	case WEB_DEMO_FIELD_BATTERY:
+		v[0] = (int64_t)s->millivolts * 1000;
+		return 1;
+	case WEB_DEMO_FIELD_CELL:
+		*valid = s->cell_valid;
+		v[0] = (int64_t)s->cell_dbm * 1000000;
+		return 1;
+	case WEB_DEMO_FIELD_TEMP:
+		*valid = s->temp_valid;
+		v[0] = sv_micro(&s->temp);
+		return 1;
+	case WEB_DEMO_FIELD_LIGHT:
+		*valid = s->light_valid;
+		v[0] = sv_micro(&s->light);
+		v[1] = sv_micro(&s->ir);
+		return 2;
+	case WEB_DEMO_FIELD_PRESS:
+		*valid = s->press_valid;
+		v[0] = sv_micro(&s->press);
+		return 1;
+	case WEB_DEMO_FIELD_MAP:
+		v[0] = dbl_mantissa(s->lat, 6);
+		v[1] = dbl_mantissa(s->lon, 6);
+		v[MAP_ALT] = dbl_mantissa(s->alt, 6);
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+static bool field_changed(const struct web_demo_sample *s, enum web_demo_field f)
+{
+	const struct web_demo_deadband *db = &deadbands[f];
+	int64_t v[3];
+	bool valid;
+	int n = field_values(s, f, v, &valid);
+
+	if (valid != reported_valid[f]) {
+		return true;
 	}
-	num_bytes_avail_buffer -=  ret_val;
-	total_bytes_written += ret_val;
+	if (f == WEB_DEMO_FIELD_BATTERY && s->bat_state != reported_bat_state) {
+		return true;
+	}
+	for (int i = 0; i < n; i++) {
+		int64_t delta = v[i] - reported[f][i];
+		int64_t ref = reported[f][i];
+		bool alt = f == WEB_DEMO_FIELD_MAP && i == MAP_ALT;
 
-	if (ret_val >= 0 && total_bytes_written < buffer_size) {
-		// Final bracket
-		ret_val = snprintf(json_payload+total_bytes_written, num_bytes_avail_buffer, "}\n");
+		delta = delta < 0 ? -delta : delta;
+		ref = ref < 0 ? -ref : ref;
+		if (delta > (alt ? db->alt : db->abs)) {
+			return true;
+		}
+		if (db->rel_pct && delta * 100 > ref * db->rel_pct) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void field_remember(const struct web_demo_sample *s, enum web_demo_field f)
+{
+	field_values(s, f, reported[f], &reported_valid[f]);
+	if (f == WEB_DEMO_FIELD_BATTERY) {
+		reported_bat_state = s->bat_state;
+	}
+}
+
+/* Encoded size of a sample in the endpoint's format, without writing it */
+static int sample_size(const struct web_demo_sample *s)
+{
+	if (get_json_format() == TMO_HTTP_FMT_CBOR) {
+		return web_demo_sample_to_cbor(s, NULL, 0, batch_size > 1);
 	} else {
-		return ret_val;
+		struct tmo_json_writer w;
+		char scratch[32];
+
+		tmo_json_init(&w, scratch, sizeof(scratch), count_sink, NULL);
+		web_demo_sample_write_json(&w, s, batch_size > 1);
+		return tmo_json_finish(&w);
+	}
+}
+
+/**
+ * @brief Narrows the sample to the field groups that need reporting
+ *
+ * @return true if the sample should still be queued
+ */
+static bool deadband_filter(struct web_demo_sample *s)
+{
+	uint8_t changed = 0;
+	bool full;
+	int full_size;
+
+	if (!deadband_enabled) {
+		return true;
 	}
-	total_bytes_written += ret_val;
 
-#ifdef CONFIG_DEBUG_JSON_GENERATION
-	printf("\n total_bytes_written %d ", total_bytes_written);
-	printf("\n%s\n", json_payload);
-#endif
-	return total_bytes_written;
+	full = last_full_report == 0 || (heartbeat_secs > 0 &&
+			s->timestamp - last_full_report >= heartbeat_secs * MSEC_PER_SEC);
+	for (int f = 0; f < WEB_DEMO_FIELD_COUNT; f++) {
+		if (full || field_changed(s, f)) {
+			changed |= BIT(f);
+			field_remember(s, f);
+		}
+	}
+	if (full) {
+		last_full_report = s->timestamp;
+		return true;
+	}
+
+	full_size = sample_size(s);
+	if (!changed && deadband_skip) {
+		batch_stats.suppressed++;
+		batch_stats.suppressed_bytes += MAX(full_size, 0);
+		return false;
+	}
+	s->fields = changed;
+	batch_stats.suppressed_bytes += MAX(full_size - sample_size(s), 0);
+	return true;
 }
 
-char* get_json_payload_pointer()
+const char *web_demo_field_name(enum web_demo_field f)
 {
-	return json_payload;
+	return f < WEB_DEMO_FIELD_COUNT ? field_names[f] : NULL;
+}
+
+int web_demo_field_by_name(const char *name)
+{
+	for (int f = 0; f < WEB_DEMO_FIELD_COUNT; f++) {
+		if (!strcmp(name, field_names[f])) {
+			return f;
+		}
+	}
+	return -EINVAL;
+}
+
+int set_deadband(enum web_demo_field f, int64_t abs, uint8_t rel_pct)
+{
+	if (f >= WEB_DEMO_FIELD_COUNT || abs < 0) {
+		return -EINVAL;
+	}
+	deadbands[f].abs = abs;
+	deadbands[f].rel_pct = rel_pct;
+	return 0;
+}
+
+int set_deadband_alt(int64_t abs)
+{
+	if (abs < 0) {
+		return -EINVAL;
+	}
+	deadbands[WEB_DEMO_FIELD_MAP].alt = abs;
+	return 0;
+}
+
+int get_deadband(enum web_demo_field f, struct web_demo_deadband *db)
+{
+	if (f >= WEB_DEMO_FIELD_COUNT) {
+		return -EINVAL;
+	}
+	*db = deadbands[f];
+	return 0;
+}
+
+void set_deadband_mode(bool enable, bool skip)
+{
+	deadband_enabled = enable;
+	deadband_skip = skip;
+	/* Start again from a full report */
+	last_full_report = 0;
+}
+
+bool get_deadband_mode(bool *skip)
+{
+	*skip = deadband_skip;
+	return deadband_enabled;
+}
+
+void set_heartbeat_interval(int secs)
+{
+	heartbeat_secs = secs;
+}
+
+int get_heartbeat_interval(void)
+{
+	return heartbeat_secs;
+}
+
+int web_demo_encode_bench(int iterations, struct web_demo_bench *res)
+{
+	static char bench_buf[MAX_PAYLOAD_BUFFER_SIZE];
+	struct web_demo_sample sample;
+	uint32_t start;
+	uint64_t cycles;
+
+	if (iterations <= 0) {
+		return -EINVAL;
+	}
+	web_demo_sample_collect(&sample);
+	memset(res, 0, sizeof(*res));
+
+	cycles = 0;
+	for (int i = 0; i < iterations; i++) {
+		start = k_cycle_get_32();
+		res->json_len = web_demo_sample_to_json(&sample, bench_buf,
+				sizeof(bench_buf), false);
+		cycles += k_cycle_get_32() - start;
+	}
+	res->json_us = k_cyc_to_us_floor64(cycles) / iterations;
+
+#if CONFIG_TMO_WEB_DEMO_JSON_LEGACY
+	cycles = 0;
+	for (int i = 0; i < iterations; i++) {
+		start = k_cycle_get_32();
+		res->legacy_len = sample_to_json_legacy(&sample, bench_buf,
+				sizeof(bench_buf), false);
+		cycles += k_cycle_get_32() - start;
+	}
+	res->legacy_us = k_cyc_to_us_floor64(cycles) / iterations;
+#endif
+
+	cycles = 0;
+	for (int i = 0; i < iterations; i++) {
+		start = k_cycle_get_32();
+		res->cbor_len = web_demo_sample_to_cbor(&sample, (uint8_t *)bench_buf,
+				sizeof(bench_buf), false);
+		cycles += k_cycle_get_32() - start;
+	}
+	res->cbor_us = k_cyc_to_us_floor64(cycles) / iterations;
+
+	return 0;
 }
 
 static void tmo_web_demo_notif_thread(void *a, void *b, void *c)
@@ -311,16 +1091,36 @@ static void tmo_web_demo_notif_thread(void *a, void *b, void *c)
 	ARG_UNUSED(b);
 	ARG_UNUSED(c);
 	k_sleep(K_SECONDS(TRANSMIT_INTERVAL_SECS_WEB));
+	last_flush = batch_stats.since = k_uptime_get();
 
 	while (1) {
 		k_sleep(K_SECONDS(web_demo_settings.transmit_interval));
 		uint8_t charging = 0;
 		uint8_t vbus = 0;
 		if (get_transmit_flag()) {
+			struct web_demo_sample sample;
+			int64_t since_flush;
+			int next_post;
+
 			get_battery_charging_status(&charging, &vbus, &battery_attached, &fault);
-			create_json();
-			increment_number_http_requests();
-			tmo_http_json();
+			web_demo_sample_collect(&sample);
+			batch_stats.samples++;
+			if (deadband_filter(&sample)) {
+				ring_push(&sample);
+			}
+
+			since_flush = k_uptime_get() - last_flush;
+			if (ring_count >= batch_size || (flush_interval > 0 &&
+					since_flush >= flush_interval * MSEC_PER_SEC)) {
+				web_demo_flush();
+			}
+
+			/* Roughly how long the radio stays idle before the next upload */
+			next_post = (batch_size - ring_count) * web_demo_settings.transmit_interval;
+			if (flush_interval > 0) {
+				next_post = MIN(next_post, flush_interval);
+			}
+			tmo_http_json_sleep_hint(MAX(next_post, web_demo_settings.transmit_interval));
 		}
 	}
 }
@@ -7,6 +7,10 @@
 #ifndef TMO_WEB_DEMO_H
 #define TMO_WEB_DEMO_H
 
+#include <zephyr/drivers/sensor.h>
+
+#include "tmo_http_request.h"
+
 #define TRANSMIT_INTERVAL_SECS_WEB   10
 #define MAX_PAYLOAD_BUFFER_SIZE      400
 
@@ -25,6 +29,72 @@ enum battery_state {
 	battery_state_attached
 };
 
+/* Field groups of a telemetry sample, in payload order */
+enum web_demo_field {
+	WEB_DEMO_FIELD_ACCEL,
+	WEB_DEMO_FIELD_BATTERY,
+	WEB_DEMO_FIELD_CELL,
+	WEB_DEMO_FIELD_TEMP,
+	WEB_DEMO_FIELD_LIGHT,
+	WEB_DEMO_FIELD_PRESS,
+	WEB_DEMO_FIELD_MAP,
+	WEB_DEMO_FIELD_COUNT
+};
+
+#define WEB_DEMO_FIELDS_ALL ((1 << WEB_DEMO_FIELD_COUNT) - 1)
+
+/* Thresholds in micro-units of the reported value, e.g. 500000 = 0.5 C */
+struct web_demo_deadband {
+	int64_t abs;
+	uint8_t rel_pct;
+	/* Map only: altitude threshold in micro-metres, abs applies to lat/lon */
+	int64_t alt;
+};
+
+/* One telemetry reading, kept in binary form until it is uploaded */
+struct web_demo_sample {
+	int64_t timestamp;
+	struct sensor_value accel[3];
+	struct sensor_value temp;
+	struct sensor_value light;
+	struct sensor_value ir;
+	struct sensor_value press;
+	double lat, lon, alt, hdop;
+	uint32_t millivolts;
+	int cell_dbm;
+	uint8_t percent;
+	uint8_t bat_state;
+	bool accel_valid;
+	bool cell_valid;
+	bool temp_valid;
+	bool light_valid;
+	bool press_valid;
+	/* Bitmask of web_demo_field groups to encode */
+	uint8_t fields;
+};
+
+struct web_demo_bench {
+	int json_len;
+	int cbor_len;
+	int legacy_len;
+	uint32_t json_us;
+	uint32_t cbor_us;
+	uint32_t legacy_us;
+};
+
+struct web_demo_batch_stats {
+	uint32_t samples;
+	uint32_t posts;
+	uint32_t bytes;
+	uint32_t dropped;
+	uint32_t spilled;
+	uint32_t queued;
+	uint32_t suppressed;
+	uint32_t suppressed_bytes;
+	int64_t since;
+	int64_t elapsed_ms;
+};
+
 bool get_transmit_flag();
 bool set_transmit_json_flag( bool user_transmit_setting);
 void set_transmit_interval(int secs);
@@ -40,6 +110,36 @@ char *get_json_path();
 int get_cell_strength(int *val);
 
 int  create_json();
+void web_demo_sample_collect(struct web_demo_sample *s);
+int web_demo_sample_to_json(const struct web_demo_sample *s, char *buf, size_t len,
+		bool with_ts);
+void web_demo_sample_write_json(struct tmo_json_writer *w, const struct web_demo_sample *s,
+		bool with_ts);
+int web_demo_sample_to_cbor(const struct web_demo_sample *s, uint8_t *buf, size_t len,
+		bool with_ts);
+enum tmo_http_payload_fmt get_json_format(void);
+void set_json_format(enum tmo_http_payload_fmt fmt);
+uint32_t get_json_cbor_rejected(void);
+int web_demo_encode_bench(int iterations, struct web_demo_bench *res);
+const char *web_demo_field_name(enum web_demo_field f);
+int web_demo_field_by_name(const char *name);
+int set_deadband(enum web_demo_field f, int64_t abs, uint8_t rel_pct);
+int get_deadband(enum web_demo_field f, struct web_demo_deadband *db);
+int set_deadband_alt(int64_t abs);
+void set_deadband_mode(bool enable, bool skip);
+bool get_deadband_mode(bool *skip);
+void set_heartbeat_interval(int secs);
+int get_heartbeat_interval(void);
+int set_batch_size(int n);
+int get_batch_size(void);
+void set_flush_interval(int secs);
+int get_flush_interval(void);
+/* Opens the flash telemetry queue, called once the file system is mounted */
+int web_demo_queue_init(void);
+void set_drain_rate(int batches);
+int get_drain_rate(void);
+void get_web_demo_batch_stats(struct web_demo_batch_stats *stats);
+void reset_web_demo_batch_stats(void);
 int read_accelerometer( SENSOR_VALUE_STRUCT *acc_sensor_arr);
 #ifdef CONFIG_DEBUG_TMO_WEB_DEMO
 #define printf_debug printf
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2023 T-Mobile USA, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/net/socket.h>
+
+#include "tmo_udp_burst.h"
+
+#define CHECK(cond, ...)                                                                           \
+	do {                                                                                       \
+		if (!(cond)) {                                                                     \
+			shell_error(shell, __VA_ARGS__);                                           \
+			rc = -1;                                                                   \
+		}                                                                                  \
+	} while (0)
+
+/* 0..6 sent; 4 and 6 lost, 2 late and duplicated */
+static const uint32_t arrivals[] = { 0, 1, 3, 2, 2, 5 };
+#define BURST_SENT 7
+
+/* Loopback receiver, the sender binds the next port */
+#define TEST_PORT 5201
+
+static int check_stats(const struct shell *shell, const char *name,
+		       const struct udp_burst_stats *st)
+{
+	int rc = 0;
+
+	CHECK(st->received == 5, "%s: received %u, expected 5", name, st->received);
+	CHECK(st->duplicates == 1, "%s: duplicates %u, expected 1", name, st->duplicates);
+	CHECK(st->reordered == 1, "%s: reordered %u, expected 1", name, st->reordered);
+	CHECK(st->lost == 2, "%s: lost %u, expected 2", name, st->lost);
+	CHECK(st->late == 0, "%s: late %u, expected 0", name, st->late);
+	CHECK(st->sent == BURST_SENT, "%s: end marker count %u, expected %u", name, st->sent,
+	      BURST_SENT);
+	return rc;
+}
+
+static int test_accounting(const struct shell *shell)
+{
+	struct udp_burst_stats st;
+	int rc = 0;
+
+	udp_burst_stats_init(&st);
+	for (int i = 0; i < ARRAY_SIZE(arrivals); i++) {
+		/* Constant transit time, no jitter */
+		udp_burst_stats_add(&st, arrivals[i], i * 1000, i * 1000 + 500, 100);
+	}
+	st.sent = BURST_SENT;
+	udp_burst_stats_finish(&st);
+	rc |= check_stats(shell, "accounting", &st);
+	CHECK(st.jitter_x16 == 0, "accounting: jitter %u, expected 0", st.jitter_x16 >> 4);
+	CHECK(st.bytes == 500, "accounting: bytes %u, expected 500", st.bytes);
+
+	/* RFC 3550: one 1600 us transit change moves J by 1600 / 16 */
+	udp_burst_stats_init(&st);
+	udp_burst_stats_add(&st, 0, 0, 1000, 100);
+	udp_burst_stats_add(&st, 1, 1000, 3600, 100);
+	CHECK((st.jitter_x16 >> 4) == 100, "jitter: %u us, expected 100", st.jitter_x16 >> 4);
+
+	/* A number older than the window is late, not a duplicate */
+	udp_burst_stats_init(&st);
+	udp_burst_stats_add(&st, UDP_BURST_WINDOW + 10, 0, 0, 100);
+	udp_burst_stats_add(&st, 0, 0, 0, 100);
+	CHECK(st.late == 1 && st.duplicates == 0, "window: late %u duplicates %u", st.late,
+	      st.duplicates);
+
+	return rc;
+}
+
+#if defined(CONFIG_NET_LOOPBACK)
+static int loopback_sock(uint16_t port)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+	};
+	int sd = zsock_socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+	if (sd < 0) {
+		return -errno;
+	}
+	zsock_inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+	if (zsock_bind(sd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		zsock_close(sd);
+		return -errno;
+	}
+	return sd;
+}
+
+static int test_loopback(const struct shell *shell)
+{
+	struct sockaddr_in peer = {
+		.sin_family = AF_INET,
+		.sin_port = htons(TEST_PORT),
+	};
+	struct udp_burst_stats st;
+	int tx, rx;
+	int rc = 0;
+	int ret;
+
+	rx = loopback_sock(TEST_PORT);
+	tx = loopback_sock(TEST_PORT + 1);
+	if (rx < 0 || tx < 0) {
+		shell_error(shell, "loopback: socket setup failed, %d %d", rx, tx);
+		rc = -1;
+		goto out;
+	}
+	zsock_inet_pton(AF_INET, "127.0.0.1", &peer.sin_addr);
+	if (zsock_connect(tx, (struct sockaddr *)&peer, sizeof(peer)) < 0) {
+		shell_error(shell, "loopback: connect failed, errno = %d", errno);
+		rc = -1;
+		goto out;
+	}
+
+	/* Everything is queued before receiving, loopback delivers in send order */
+	zsock_send(tx, "not a burst", sizeof("not a burst"), 0);
+	for (int i = 0; i < ARRAY_SIZE(arrivals); i++) {
+		udp_burst_tx(tx, arrivals[i], 100, 0);
+	}
+	udp_burst_tx(tx, UDP_BURST_END_SEQ, 0, BURST_SENT);
+
+	udp_burst_stats_init(&st);
+	ret = udp_burst_rx(rx, 1000, &st);
+	udp_burst_stats_finish(&st);
+	CHECK(ret == 0, "loopback: receive returned %d", ret);
+	rc |= check_stats(shell, "loopback", &st);
+	CHECK(st.ignored == 1, "loopback: ignored %u, expected 1", st.ignored);
+
+	/* Nothing more arrives: a timeout, not an error and not a foreign datagram */
+	udp_burst_stats_init(&st);
+	ret = udp_burst_rx(rx, 100, &st);
+	CHECK(ret == -ETIMEDOUT && st.ignored == 0, "idle: returned %d, ignored %u", ret,
+	      st.ignored);
+
+out:
+	if (rx >= 0) {
+		zsock_close(rx);
+	}
+	if (tx >= 0) {
+		zsock_close(tx);
+	}
+	return rc;
+}
+#endif
+
+int udp_burst_test(const struct shell *shell, size_t argc, char **argv)
+{
+	int rc = 0;
+	int ret;
+
+	ret = test_accounting(shell);
+	shell_print(shell, "udp burst accounting: %s", ret ? "FAILED" : "passed");
+	rc |= ret;
+#if defined(CONFIG_NET_LOOPBACK)
+	ret = test_loopback(shell);
+	shell_print(shell, "udp burst loopback: %s", ret ? "FAILED" : "passed");
+	rc |= ret;
+#else
+	shell_print(shell, "udp burst loopback: skipped, needs CONFIG_NET_LOOPBACK");
+#endif
+	return rc;
+}